@@ -0,0 +1,667 @@
+// Local VTN load generator: a fleet of VENs' event and report traffic, without openleadr-rs or any other service
+//
+// Build from the repository root:
+//   gcc -O2 -Wall -I. -Ibenchmarks/modbus_emulator -o vtn_loadgen VTN-server/vtn_loadgen.c demand_response.c tariff.c baseline.c load_forecast.c inverter.c battery_model.c spsc_queue.c benchmarks/modbus_emulator/modbus_emulator.c -lpthread -lm
+//
+// Fleet engine (default): every VEN has its own DemandResponseStrategy and a pack in one BatteryFleetModel. A VTN thread
+// sends events and report requests over an SpscQueue to an engine thread. The engine prices each event with
+// calculate_fast_dr_bid, caps each bid at what the pack's equivalent circuit can deliver at the bid power
+// (battery_fleet_deliverable_energy), dispatches the packs that bid and steps the fleet every second:
+//   ./vtn_loadgen --vens 5000 --rate 500 --ramp
+//
+// Gateway: the VTN drives one Linux gateway built against the Modbus emulator (see benchmarks/dispatch_latency_bench.c
+// for the gateway_bench build line), with a utility API stand-in on port 18080 pricing fast DR high enough to dispatch.
+// Each event is a VEN writing 0x220 over the emulated RS-485 bus and sending the wakeup datagram. Each 0x220 write
+// carries a new sequence number, so the harness can tell which read picked each event up. Events overwritten before
+// any read (coalesced) count as picked up by the read that saw the newer value, since the gateway acts on the latest
+// status:
+//   ./vtn_loadgen --gateway ./gateway_bench --rate 2 --ramp
+//
+// Events are a Poisson process at --rate. Each targets --fanout consecutive VENs from a random one, at OpenADR SIMPLE
+// signal level 1, 2 or 3. Every VEN reports telemetry every --report-interval seconds, as openadr_ven-client.py does
+// (fleet engine only). Latency counts from when the VTN meant to send a message, so a generator that falls behind
+// shows up in it. With --ramp the event rate doubles after each step until drops or p99 latency above --slo-ms show
+// where the target stops keeping up.
+
+#include "demand_response.h"
+#include "battery_model.h"
+#include "spsc_queue.h"
+#include "modbus.h"
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <sys/wait.h>
+
+#define VTN_QUEUE_CAPACITY 65536        // Messages in flight between the VTN and the engine
+#define VTN_MAX_STEPS 24                // Ramp steps before giving up on finding a limit
+#define VTN_SPIN_US 200                 // The VTN sleeps instead of spinning when the next message is further away
+#define VTN_FLEET_STEP_US 1000000       // Fleet model step
+#define VTN_DELIVERABLE_STEP_S 60.0     // Step of the per-bid deliverable energy simulation
+#define VTN_IDLE_US 50                  // Engine nap when the queue is empty, so it never starves the VTN of a core
+#define VTN_AMBIENT_C 25.0f
+#define VTN_DRAIN_US 3000000            // Time after a gateway step for outstanding events to be read
+#define VTN_DEFAULT_VEN_SOCKET "/tmp/opencbp-bench-ven.sock"  // The gateway_bench build's -DVEN_SOCKET_PATH
+#define VTN_API_PORT 18080                                    // The gateway_bench build's -DUTILITY_API_URL
+
+// Log-linear latency histogram: 16 buckets per power of two of microseconds, within about 6%
+#define LATENCY_SUB_BITS 4
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS) << LATENCY_SUB_BITS)
+
+typedef enum {
+    VTN_EVENT,                      // oadrDistributeEvent to fanout VENs
+    VTN_REPORT                      // oadrUpdateReport from one VEN
+} VtnMessageType;
+
+// One OpenADR exchange as the engine sees it
+typedef struct {
+    uint64_t due_us;                // When the VTN meant to send it (CLOCK_MONOTONIC)
+    uint32_t ven;                   // Target VEN; events cover fanout VENs from here
+    uint16_t type;                  // VtnMessageType
+    uint16_t signal;                // SIMPLE signal level 1-3
+    float price;                    // Event price ($/kWh)
+    float duration_s;               // Event duration
+} VtnMessage;
+
+typedef struct {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    uint64_t max_us;
+} LatencyHistogram;
+
+// Outcome of one ramp step
+typedef struct {
+    double rate;                    // Offered events per second
+    uint64_t events;                // Events sent
+    uint64_t reports;               // Reports sent
+    uint64_t handled;               // Messages the engine finished (fleet) or events the gateway picked up (gateway)
+    uint64_t dropped;               // Messages rejected by a full queue (fleet)
+    uint64_t coalesced;             // Events overwritten before any gateway read (gateway)
+    uint64_t dispatched;            // Packs dispatched (fleet) or 0x210 writes (gateway)
+    double seconds;
+    LatencyHistogram latency;
+} StepResult;
+
+// Command line settings
+static int numVens = 5000;
+static double eventRate = 100.0;
+static int fanout = 1;
+static double reportInterval = 5.0;
+static double stepSeconds = 5.0;
+static double sloMs = 250.0;
+static bool ramp = false;
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+static const char *gatewayBinary = NULL;
+static const char *venSocketPath = VTN_DEFAULT_VEN_SOCKET;
+
+static uint64_t _now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static void _sleep_until_us(uint64_t when) {
+    struct timespec until = {(time_t)(when / 1000000), (long)(when % 1000000) * 1000};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0) {
+    }
+}
+
+// xorshift64*, so runs repeat for a given --seed
+static uint64_t _random(void) {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 0x2545F4914F6CDD1DULL;
+}
+
+static double _uniform(void) {
+    return (double)(_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Exponential inter-arrival gap for a Poisson process at rate per second (µs)
+static uint64_t _gap_us(double rate) {
+    return (uint64_t)(-log(1.0 - _uniform()) / rate * 1e6) + 1;
+}
+
+// Draw an event: level 1 (60%), 2 (30%) or 3 (10%); price ($1, $2, $4/kWh) and duration grow with the level, 5 to 60 min
+static void _draw_event(VtnMessage *message, uint64_t due_us) {
+    double draw = _uniform();
+    message->type = VTN_EVENT;
+    message->due_us = due_us;
+    message->ven = (uint32_t)(_random() % (uint64_t)numVens);
+    message->signal = (draw < 0.6) ? 1 : (draw < 0.9) ? 2 : 3;
+    message->price = 1.0f * (float)(1 << (message->signal - 1));
+    message->duration_s = (float)fmin(fmax(-log(1.0 - _uniform()) * 900.0 * message->signal, 300.0), 3600.0);
+}
+
+static void _draw_report(VtnMessage *message, uint64_t due_us) {
+    memset(message, 0, sizeof(*message));
+    message->type = VTN_REPORT;
+    message->due_us = due_us;
+    message->ven = (uint32_t)(_random() % (uint64_t)numVens);
+}
+
+static int _latency_bucket(uint64_t us) {
+    if (us < (1u << LATENCY_SUB_BITS)) {
+        return (int)us;
+    }
+    int shift = 63 - __builtin_clzll(us) - LATENCY_SUB_BITS;
+    return ((shift + 1) << LATENCY_SUB_BITS) + (int)((us >> shift) & ((1u << LATENCY_SUB_BITS) - 1));
+}
+
+// Lower edge of a bucket (µs)
+static uint64_t _latency_value(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS)) {
+        return (uint64_t)bucket;
+    }
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    return ((uint64_t)(bucket & ((1 << LATENCY_SUB_BITS) - 1)) | (1u << LATENCY_SUB_BITS)) << shift;
+}
+
+static void _latency_record(LatencyHistogram *histogram, uint64_t us) {
+    histogram->counts[_latency_bucket(us)]++;
+    histogram->total++;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+static double _latency_percentile_ms(const LatencyHistogram *histogram, double fraction) {
+    uint64_t rank = (uint64_t)ceil(fraction * (double)histogram->total);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank && seen > 0) {
+            return _latency_value(bucket) / 1000.0;
+        }
+    }
+    return histogram->max_us / 1000.0;
+}
+
+// Fleet engine: one strategy and pack per VEN, fed by the VTN thread
+typedef struct {
+    DemandResponseStrategy *strategies; // Aligned hot cores, one per VEN
+    BatteryFleetModel packs;
+    float *power_request_kw;        // Dispatch per pack, zeroed when its event ends
+    uint64_t *event_end_us;
+    SpscQueue queue;
+    _Atomic bool generating;        // Cleared by the VTN thread after its last message
+    StepResult *result;
+} FleetEngine;
+
+static int _fleet_init(FleetEngine *engine) {
+    BatteryPackParams params;
+    battery_pack_default_params(&params);
+    double capacity_kwh = params.capacity_ah * params.series_cells * 3.2 / 1000.0;
+
+    size_t bytes = ((size_t)numVens * sizeof(DemandResponseStrategy) + DR_CACHE_LINE_SIZE - 1) /
+                   DR_CACHE_LINE_SIZE * DR_CACHE_LINE_SIZE;
+    engine->strategies = (DemandResponseStrategy*)aligned_alloc(DR_CACHE_LINE_SIZE, bytes);
+    engine->power_request_kw = (float*)calloc((size_t)numVens, sizeof(float));
+    engine->event_end_us = (uint64_t*)calloc((size_t)numVens, sizeof(uint64_t));
+    if (engine->strategies == NULL || engine->power_request_kw == NULL || engine->event_end_us == NULL ||
+        battery_fleet_init(&engine->packs, numVens, &params, 0.8, VTN_AMBIENT_C) != 0 ||
+        spsc_queue_init(&engine->queue, VTN_QUEUE_CAPACITY, sizeof(VtnMessage)) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < numVens; i++) {
+        if (DemandResponseStrategy_init(&engine->strategies[i], capacity_kwh, 0.95) != 0) {
+            while (i-- > 0) {
+                DemandResponseStrategy_free(&engine->strategies[i]);
+            }
+            return -1;
+        }
+        engine->strategies[i].current_soc = 0.8;
+    }
+    return 0;
+}
+
+static void _fleet_free(FleetEngine *engine) {
+    for (int i = 0; i < numVens; i++) {
+        DemandResponseStrategy_free(&engine->strategies[i]);
+    }
+    free(engine->strategies);
+    free(engine->power_request_kw);
+    free(engine->event_end_us);
+    battery_fleet_free(&engine->packs);
+    spsc_queue_free(&engine->queue);
+}
+
+// Bid every targeted VEN into the event and dispatch the ones with capacity, as FastDRDispatchJob does
+static void _fleet_event(FleetEngine *engine, const VtnMessage *message, uint64_t now) {
+    double hours = message->duration_s / 3600.0;
+    double grid_demand = 20000.0 + 10000.0 * message->signal;
+    time_t wall_time = time(NULL);
+    for (int k = 0; k < fanout; k++) {
+        int ven = (int)((message->ven + (uint32_t)k) % (uint32_t)numVens);
+        double bid_capacity = 0.0;
+        double bid_price = 0.0;
+        calculate_fast_dr_bid(&engine->strategies[ven], message->price, grid_demand, hours, wall_time, &bid_capacity,
+                              &bid_price);
+
+        // The strategy sizes bids from SOC alone; voltage sag, the current limit and temperature decide what the
+        // pack can actually hold at that power for the whole event
+        if (bid_capacity > 0.0) {
+            bid_capacity = fmin(bid_capacity, battery_fleet_deliverable_energy(&engine->packs, ven, bid_capacity / hours,
+                                                                               hours, VTN_DELIVERABLE_STEP_S));
+        }
+        if (bid_capacity > 0.0) {
+            engine->power_request_kw[ven] = (float)(bid_capacity / hours);
+            engine->event_end_us[ven] = now + (uint64_t)(message->duration_s * 1e6);
+            engine->result->dispatched++;
+        }
+    }
+}
+
+// End finished events and advance every pack
+static void _fleet_step(FleetEngine *engine, uint64_t now, float dt) {
+    for (int i = 0; i < numVens; i++) {
+        if (engine->event_end_us[i] != 0 && engine->event_end_us[i] <= now) {
+            engine->power_request_kw[i] = 0.0f;
+            engine->event_end_us[i] = 0;
+        }
+    }
+    battery_fleet_step(&engine->packs, engine->power_request_kw, VTN_AMBIENT_C, dt);
+}
+
+static void *_fleet_engine(void *context) {
+    FleetEngine *engine = (FleetEngine*)context;
+    StepResult *result = engine->result;
+    uint64_t last_step = _now_us();
+    double reported_kw = 0.0;
+    VtnMessage message;
+
+    for (;;) {
+        uint64_t now = _now_us();
+        if (now - last_step >= VTN_FLEET_STEP_US) {
+            _fleet_step(engine, now, VTN_FLEET_STEP_US / 1e6f);
+            last_step += VTN_FLEET_STEP_US;
+        }
+
+        if (!spsc_queue_pop(&engine->queue, &message)) {
+            if (!atomic_load(&engine->generating) && spsc_queue_size(&engine->queue) == 0) {
+                break;
+            }
+            _sleep_until_us(now + VTN_IDLE_US);
+            continue;
+        }
+
+        if (message.type == VTN_EVENT) {
+            _fleet_event(engine, &message, now);
+        } else {
+            // A telemetry report: the VEN's latest SOC and power, as the VTN would ingest them
+            engine->strategies[message.ven].current_soc = engine->packs.soc[message.ven];
+            reported_kw += engine->packs.power_kw[message.ven];
+        }
+        _latency_record(&result->latency, _now_us() - message.due_us);
+        result->handled++;
+    }
+
+    // Keeps the report reads from being optimized away
+    if (reported_kw < -1e30) {
+        printf("%f\n", reported_kw);
+    }
+    return NULL;
+}
+
+// One fleet step at rate: the VTN runs on this thread, the engine on its own
+static void _run_fleet_step(FleetEngine *engine, double rate, StepResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->rate = rate;
+    engine->result = result;
+    uint32_t dropped_before = atomic_load(&engine->queue.dropped);
+    atomic_store(&engine->generating, true);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, _fleet_engine, engine);
+
+    double report_rate = (reportInterval > 0.0) ? numVens / reportInterval : 0.0;
+    uint64_t start = _now_us();
+    uint64_t end = start + (uint64_t)(stepSeconds * 1e6);
+    uint64_t next_event = start + _gap_us(rate);
+    uint64_t next_report = (report_rate > 0.0) ? start + _gap_us(report_rate) : UINT64_MAX;
+    VtnMessage message;
+
+    for (;;) {
+        uint64_t next = (next_event < next_report) ? next_event : next_report;
+        if (next >= end) {
+            break;
+        }
+        uint64_t now = _now_us();
+        if (next > now + VTN_SPIN_US) {
+            _sleep_until_us(next - VTN_SPIN_US);
+            continue;
+        }
+        if (next > now) {
+            continue;
+        }
+
+        // Open loop: send whatever is due, however far behind, and never wait for the engine
+        if (next_event <= next_report) {
+            _draw_event(&message, next_event);
+            result->events++;
+            next_event += _gap_us(rate);
+        } else {
+            _draw_report(&message, next_report);
+            result->reports++;
+            next_report += _gap_us(report_rate);
+        }
+        spsc_queue_push(&engine->queue, &message);
+    }
+
+    atomic_store(&engine->generating, false);
+    pthread_join(thread, NULL);
+    result->seconds = (_now_us() - start) / 1e6;
+    result->dropped = atomic_load(&engine->queue.dropped) - dropped_before;
+}
+
+// Market data making fast DR profitable every hour, so events end in 0x210 writes
+static const char marketData[] =
+    "{\"prices\":[3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0],"
+    "\"demand\":[900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900],"
+    "\"competitors\":1}";
+
+// Utility API stand-in: market data on GET /market_data, 200 for every bid
+static void *_api_server(void *context) {
+    int listener = *(int*)context;
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        char request[1024];
+        ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+        if (received > 0) {
+            request[received] = '\0';
+            const char *body = (strncmp(request, "GET /market_data", 16) == 0) ? marketData : "{}";
+            char response[2048];
+            int length = snprintf(response, sizeof(response),
+                                  "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                                  "Connection: close\r\n\r\n%s", strlen(body), body);
+            send(client, response, (size_t)length, MSG_NOSIGNAL);
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+// Gateway target: the VTN plays every VEN's 0x220 write and wakeup datagram
+typedef struct {
+    EmulatorBank *bank;
+    int sock;
+    int listener;                   // Utility API stand-in
+    struct sockaddr_un address;
+    uint64_t due_us[65536];         // When each 0x220 sequence number was due
+    uint16_t sequence;              // Last sequence written, 1 to 65535
+    _Atomic bool generating;
+    StepResult *result;
+} GatewayTarget;
+
+// Sequence numbers skip 0, which would end the event
+static uint16_t _next_sequence(uint16_t sequence) {
+    return (sequence == 65535) ? 1 : (uint16_t)(sequence + 1);
+}
+
+static uint64_t _sequence_distance(uint16_t from, uint16_t to) {
+    return (to >= from) ? (uint64_t)(to - from) : (uint64_t)(65535 - from + to);
+}
+
+// Watch the emulator for the gateway's 0x220 reads, crediting each new value to its event
+static void *_gateway_monitor(void *context) {
+    GatewayTarget *target = (GatewayTarget*)context;
+    StepResult *result = target->result;
+    uint16_t last = atomic_load(&target->bank->dr_seen);
+    uint64_t last_us = atomic_load(&target->bank->dr_seen_us);
+    uint32_t setpoints = atomic_load(&target->bank->setpoint_writes);
+    uint64_t drain_until = 0;
+
+    for (;;) {
+        uint16_t seen = atomic_load(&target->bank->dr_seen);
+        uint64_t seen_us = atomic_load(&target->bank->dr_seen_us);
+
+        // The emulator stores the value before its timestamp; wait for both
+        if (seen != last && seen != 0 && seen_us != last_us) {
+            uint64_t picked_up = _sequence_distance(last, seen);
+            uint16_t sequence = last;
+            do {
+                sequence = _next_sequence(sequence);
+                _latency_record(&result->latency, seen_us - target->due_us[sequence]);
+            } while (sequence != seen);
+            result->handled += picked_up;
+            result->coalesced += picked_up - 1;
+            last = seen;
+            last_us = seen_us;
+        }
+
+        if (!atomic_load(&target->generating)) {
+            if (drain_until == 0) {
+                drain_until = _now_us() + VTN_DRAIN_US;
+            }
+            if (last == target->sequence || _now_us() >= drain_until) {
+                break;
+            }
+        }
+        _sleep_until_us(_now_us() + 100);
+    }
+    result->dispatched = atomic_load(&target->bank->setpoint_writes) - setpoints;
+    return NULL;
+}
+
+static void _run_gateway_step(GatewayTarget *target, double rate, StepResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->rate = rate;
+    target->result = result;
+    atomic_store(&target->generating, true);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, _gateway_monitor, target);
+
+    uint64_t start = _now_us();
+    uint64_t end = start + (uint64_t)(stepSeconds * 1e6);
+    static const char wakeup[] = "dr_active=1";
+    for (uint64_t next = start + _gap_us(rate); next < end; next += _gap_us(rate)) {
+        _sleep_until_us(next);
+
+        // The write holds the bus for its frame time, so a burst queues here as it would behind a real VEN
+        uint16_t sequence = _next_sequence(target->sequence);
+        target->due_us[sequence] = next;
+        emulator_write(target->bank, 0x220, sequence);
+        target->sequence = sequence;
+        sendto(target->sock, wakeup, sizeof(wakeup) - 1, 0, (struct sockaddr*)&target->address,
+               sizeof(target->address));
+        result->events++;
+    }
+
+    atomic_store(&target->generating, false);
+    pthread_join(thread, NULL);
+    result->seconds = (_now_us() - start) / 1e6;
+}
+
+// Start the gateway against a fresh emulator bank; returns its pid, or -1
+static pid_t _start_gateway(GatewayTarget *target) {
+    const char *path = getenv("MODBUS_EMULATOR_PATH") ? getenv("MODBUS_EMULATOR_PATH") : EMULATOR_DEFAULT_PATH;
+    setenv("MODBUS_EMULATOR_PATH", path, 1);
+    target->bank = emulator_open(path, 1);
+    target->sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (target->bank == NULL || target->sock < 0) {
+        fprintf(stderr, "Unable to create the Modbus emulator at %s\n", path);
+        return -1;
+    }
+
+    // Gridlink registers: 80% SOC, 25°C, 1.5 kW site load, no DR event
+    atomic_store(&target->bank->registers[0x208], 80);
+    atomic_store(&target->bank->registers[0x209], 250);
+    atomic_store(&target->bank->registers[0x20A], 1500);
+
+    target->listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(target->listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in api;
+    memset(&api, 0, sizeof(api));
+    api.sin_family = AF_INET;
+    api.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    api.sin_port = htons(VTN_API_PORT);
+    if (bind(target->listener, (struct sockaddr*)&api, sizeof(api)) != 0 || listen(target->listener, 16) != 0) {
+        fprintf(stderr, "Unable to serve the utility API on port %d\n", VTN_API_PORT);
+        return -1;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, _api_server, &target->listener);
+
+    memset(&target->address, 0, sizeof(target->address));
+    target->address.sun_family = AF_UNIX;
+    strncpy(target->address.sun_path, venSocketPath, sizeof(target->address.sun_path) - 1);
+    unlink(venSocketPath);
+
+    pid_t gateway = fork();
+    if (gateway == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        execl(gatewayBinary, gatewayBinary, (char*)NULL);
+        _exit(127);
+    }
+
+    // Ready once the wakeup socket is bound
+    struct stat status;
+    for (int i = 0; i < 100 && stat(venSocketPath, &status) != 0; i++) {
+        _sleep_until_us(_now_us() + 100000);
+    }
+    if (stat(venSocketPath, &status) != 0) {
+        fprintf(stderr, "Gateway did not bind %s; is it built with -DVEN_SOCKET_PATH for it?\n", venSocketPath);
+        kill(gateway, SIGTERM);
+        waitpid(gateway, NULL, 0);
+        return -1;
+    }
+    _sleep_until_us(_now_us() + 2000000);
+    return gateway;
+}
+
+// A step keeps up if nothing was dropped and p99 latency is within the objective
+static bool _kept_up(const StepResult *result) {
+    return result->dropped == 0 && result->latency.total > 0 && result->handled == result->events + result->reports &&
+           _latency_percentile_ms(&result->latency, 0.99) <= sloMs;
+}
+
+static void _print_step(const StepResult *result) {
+    printf("%10.1f %10.1f %10.1f %8llu %9llu %10llu %8.2f %8.2f %9.2f  %s\n", result->rate,
+           result->events / result->seconds, result->handled / result->seconds,
+           (unsigned long long)result->dropped, (unsigned long long)result->coalesced,
+           (unsigned long long)result->dispatched, _latency_percentile_ms(&result->latency, 0.5),
+           _latency_percentile_ms(&result->latency, 0.99), result->latency.max_us / 1000.0,
+           _kept_up(result) ? "ok" : "BEHIND");
+    fflush(stdout);
+}
+
+static void _usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--vens N] [--rate EVENTS_PER_S] [--fanout N] [--report-interval S] [--step S]\n"
+            "          [--slo-ms MS] [--ramp] [--seed N] [--gateway BINARY [--ven-socket PATH]]\n", program);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--ramp") == 0) {
+            ramp = true;
+            continue;
+        }
+        if (value == NULL) {
+            _usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--vens") == 0) {
+            numVens = atoi(value);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            eventRate = atof(value);
+        } else if (strcmp(argv[i], "--fanout") == 0) {
+            fanout = atoi(value);
+        } else if (strcmp(argv[i], "--report-interval") == 0) {
+            reportInterval = atof(value);
+        } else if (strcmp(argv[i], "--step") == 0) {
+            stepSeconds = atof(value);
+        } else if (strcmp(argv[i], "--slo-ms") == 0) {
+            sloMs = atof(value);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(value, NULL, 0) | 1;
+        } else if (strcmp(argv[i], "--gateway") == 0) {
+            gatewayBinary = value;
+        } else if (strcmp(argv[i], "--ven-socket") == 0) {
+            venSocketPath = value;
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (numVens <= 0 || eventRate <= 0.0 || fanout <= 0 || fanout > numVens || stepSeconds <= 0.0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    FleetEngine *engine = NULL;
+    GatewayTarget *target = NULL;
+    pid_t gateway = -1;
+    if (gatewayBinary != NULL) {
+        target = (GatewayTarget*)calloc(1, sizeof(GatewayTarget));
+        if (target == NULL || (gateway = _start_gateway(target)) < 0) {
+            return 1;
+        }
+        printf("Gateway %s, events as 0x220 writes at %d baud plus wakeup datagrams\n", gatewayBinary,
+               getenv("MODBUS_EMULATOR_BAUD") ? atoi(getenv("MODBUS_EMULATOR_BAUD")) : EMULATOR_DEFAULT_BAUD);
+    } else {
+        engine = (FleetEngine*)calloc(1, sizeof(FleetEngine));
+        if (engine == NULL || _fleet_init(engine) != 0) {
+            fprintf(stderr, "Unable to allocate a fleet of %d VENs\n", numVens);
+            return 1;
+        }
+        printf("Fleet engine, %d VENs, fanout %d, reports every %.1f s (%.0f/s)\n", numVens, fanout, reportInterval,
+               (reportInterval > 0.0) ? numVens / reportInterval : 0.0);
+    }
+
+    printf("%10s %10s %10s %8s %9s %10s %8s %8s %9s\n", "rate", "events/s", "handled/s", "dropped", "coalesced",
+           "dispatched", "p50 ms", "p99 ms", "max ms");
+    double sustained = 0.0;
+    double rate = eventRate;
+    StepResult result;
+    for (int step = 0; step < (ramp ? VTN_MAX_STEPS : 1); step++, rate *= 2.0) {
+        if (target != NULL) {
+            _run_gateway_step(target, rate, &result);
+        } else {
+            _run_fleet_step(engine, rate, &result);
+        }
+        _print_step(&result);
+        if (!_kept_up(&result)) {
+            break;
+        }
+        sustained = rate;
+    }
+
+    if (ramp) {
+        if (sustained > 0.0) {
+            printf("Highest rate kept up with: %.1f events/s\n", sustained);
+        } else {
+            printf("Fell behind at the starting rate; lower --rate\n");
+        }
+    }
+
+    if (target != NULL) {
+        emulator_write(target->bank, 0x220, 0);
+        kill(gateway, SIGTERM);
+        waitpid(gateway, NULL, 0);
+        close(target->sock);
+        free(target);
+    } else {
+        _fleet_free(engine);
+        free(engine);
+    }
+    return 0;
+}
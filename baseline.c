@@ -0,0 +1,161 @@
+#include "baseline.h"
+#include <math.h>
+#include <string.h>
+
+#define MINUTES_PER_DAY 1440
+
+// Year * 1000 + day of year of the local day containing a time
+static int _day_key(time_t when, struct tm *local) {
+    localtime_r(&when, local);
+    return (local->tm_year + 1900) * 1000 + local->tm_yday;
+}
+
+// Initialize a baseline for a meter interval length and eligible-day window
+int baseline_init(CustomerBaseline *baseline, int interval_minutes, int window_days) {
+    memset(baseline, 0, sizeof(*baseline));
+    if (interval_minutes <= 0 || MINUTES_PER_DAY % interval_minutes != 0 ||
+        MINUTES_PER_DAY / interval_minutes > BASELINE_MAX_INTERVALS_PER_DAY ||
+        window_days <= 0 || window_days > BASELINE_MAX_WINDOW_DAYS) {
+        return -1;
+    }
+
+    baseline->interval_minutes = interval_minutes;
+    baseline->intervals_per_day = MINUTES_PER_DAY / interval_minutes;
+    baseline->window_days = window_days;
+
+    // Typical utility day-of adjustment: three hours ending one hour before the event, capped at 40%
+    baseline->adjustment_hours = 3;
+    baseline->adjustment_offset_hours = 1;
+    baseline->adjustment_cap = 0.4;
+
+    baseline->today_key = -1;
+    baseline->pending_ineligible_key = -1;
+    return 0;
+}
+
+// Close out the day being accumulated and push it into the window if it qualifies
+static void _finish_day(CustomerBaseline *baseline) {
+    // Only complete, eligible days enter the window; partial days would bias the average low
+    if (baseline->today_key >= 0 && baseline->today_eligible &&
+        baseline->today_seen >= baseline->intervals_per_day) {
+        float *slot = baseline->history[baseline->head];
+        bool evicting = (baseline->count == baseline->window_days);
+
+        for (int i = 0; i < baseline->intervals_per_day; i++) {
+            baseline->sums[i] += baseline->today[i] - (evicting ? slot[i] : 0.0f);
+            slot[i] = baseline->today[i];
+        }
+
+        baseline->head = (baseline->head + 1) % baseline->window_days;
+        if (!evicting) {
+            baseline->count++;
+        }
+    }
+
+    memset(baseline->today, 0, sizeof(baseline->today));
+    memset(baseline->today_received, 0, sizeof(baseline->today_received));
+    baseline->today_seen = 0;
+    baseline->today_latest = 0;
+}
+
+// Ingest one meter interval
+void baseline_ingest(CustomerBaseline *baseline, time_t interval_start, double energy_kwh) {
+    struct tm local;
+    int key = _day_key(interval_start, &local);
+
+    if (key != baseline->today_key) {
+        _finish_day(baseline);
+        baseline->today_key = key;
+
+        // Weekends never count as eligible days, nor a day marked before its first reading arrived
+        baseline->today_eligible = (local.tm_wday != 0 && local.tm_wday != 6 &&
+                                    key != baseline->pending_ineligible_key);
+        if (key >= baseline->pending_ineligible_key) {
+            baseline->pending_ineligible_key = -1;
+        }
+    }
+
+    int interval = (local.tm_hour * 60 + local.tm_min) / baseline->interval_minutes;
+    if (!baseline->today_received[interval]) {
+        baseline->today_received[interval] = true;
+        baseline->today_seen++;
+    }
+    baseline->today[interval] = (float)energy_kwh;
+    if (interval + 1 > baseline->today_latest) {
+        baseline->today_latest = interval + 1;
+    }
+}
+
+// Exclude the local day containing a time from the window
+void baseline_mark_ineligible_day(CustomerBaseline *baseline, time_t when) {
+    struct tm local;
+    int key = _day_key(when, &local);
+
+    if (key == baseline->today_key) {
+        baseline->today_eligible = false;
+    } else if (key > baseline->today_key) {
+        // Still accumulating an earlier day (e.g. just after midnight): apply the mark when this day starts
+        baseline->pending_ineligible_key = key;
+    }
+}
+
+bool baseline_ready(const CustomerBaseline *baseline) {
+    return baseline->count == baseline->window_days;
+}
+
+// Unadjusted baseline for an interval of the day
+double baseline_predict(const CustomerBaseline *baseline, int interval) {
+    if (baseline->count == 0 || interval < 0 || interval >= baseline->intervals_per_day) {
+        return 0.0;
+    }
+    return baseline->sums[interval] / baseline->count;
+}
+
+// Day-of adjusted baseline for an interval of an event
+double baseline_adjusted(const CustomerBaseline *baseline, int event_start_interval, int interval) {
+    double unadjusted = baseline_predict(baseline, interval);
+
+    int per_hour = 60 / baseline->interval_minutes;
+    int window_end = event_start_interval - baseline->adjustment_offset_hours * per_hour;
+    int window_start = window_end - baseline->adjustment_hours * per_hour;
+
+    // Without today's readings over the whole window the adjustment cannot be computed yet
+    if (window_start < 0 || window_end > baseline->today_latest) {
+        return unadjusted;
+    }
+
+    double actual = 0.0;
+    double expected = 0.0;
+    for (int i = window_start; i < window_end; i++) {
+        actual += baseline->today[i];
+        expected += baseline_predict(baseline, i);
+    }
+    if (expected <= 0.0) {
+        return unadjusted;
+    }
+
+    double ratio = fmin(fmax(actual / expected, 1.0 - baseline->adjustment_cap), 1.0 + baseline->adjustment_cap);
+    return unadjusted * ratio;
+}
+
+// Predicted reduction credited against the adjusted baseline
+double baseline_predicted_reduction(const CustomerBaseline *baseline, int event_start_interval, int interval,
+                                    double predicted_load_kwh) {
+    return fmax(baseline_adjusted(baseline, event_start_interval, interval) - predicted_load_kwh, 0.0);
+}
+
+// Unadjusted baseline summed per hour
+void baseline_hourly_profile(const CustomerBaseline *baseline, double *hourly_kwh) {
+    int per_hour = baseline->intervals_per_day / 24;
+    if (per_hour < 1) {
+        per_hour = 1;
+    }
+
+    for (int hour = 0; hour < 24; hour++) {
+        double sum = 0.0;
+        for (int i = 0; i < per_hour; i++) {
+            sum += baseline_predict(baseline, hour * per_hour + i);
+        }
+        hourly_kwh[hour] = sum;
+    }
+}
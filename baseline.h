@@ -0,0 +1,65 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define BASELINE_MAX_WINDOW_DAYS 10         // 10-in-10 eligible-day window
+#define BASELINE_MAX_INTERVALS_PER_DAY 96   // Up to 15-minute meter intervals
+
+// Incremental customer baseline (e.g. 10-in-10 with day-of adjustment) used for CBP measurement and verification
+typedef struct CustomerBaseline {
+    int interval_minutes;               // Meter interval length (must divide 1440)
+    int intervals_per_day;
+    int window_days;                    // Eligible days averaged (<= BASELINE_MAX_WINDOW_DAYS)
+
+    // Day-of adjustment: ratio of actual to baseline load over a window before the event, capped
+    int adjustment_hours;               // Length of the adjustment window (hours)
+    int adjustment_offset_hours;        // Gap between the end of the window and the event start (hours)
+    double adjustment_cap;              // Maximum fractional adjustment (e.g. 0.4 for +/-40%)
+
+    // Ring of eligible day profiles with running per-interval sums, so each update touches one slot
+    float history[BASELINE_MAX_WINDOW_DAYS][BASELINE_MAX_INTERVALS_PER_DAY];
+    double sums[BASELINE_MAX_INTERVALS_PER_DAY];
+    int head;                           // Next ring slot to overwrite
+    int count;                          // Eligible days currently in the window
+
+    // Day being accumulated
+    float today[BASELINE_MAX_INTERVALS_PER_DAY];
+    bool today_received[BASELINE_MAX_INTERVALS_PER_DAY];
+    int today_seen;                     // Intervals received today
+    int today_latest;                   // One past the latest interval received today
+    int today_key;                      // Year * 1000 + day of year, or -1 before the first reading
+    bool today_eligible;                // Weekday with no event or holiday so far
+    int pending_ineligible_key;         // Later day marked ineligible before its first reading, or -1
+} CustomerBaseline;
+
+// Initialize a baseline for a meter interval length and eligible-day window; returns 0 on success
+int baseline_init(CustomerBaseline *baseline, int interval_minutes, int window_days);
+
+// Ingest one meter interval (kWh consumed by the site, interval starting at interval_start, local time)
+// Rolls the eligible-day window when a new day starts; amortized O(1) per interval
+void baseline_ingest(CustomerBaseline *baseline, time_t interval_start, double energy_kwh);
+
+// Exclude the local day containing a time from the window (DR event day or utility holiday)
+// The day is matched by date, so a mark made before that day's first interval is ingested still applies
+void baseline_mark_ineligible_day(CustomerBaseline *baseline, time_t when);
+
+// True once the window holds a full set of eligible days
+bool baseline_ready(const CustomerBaseline *baseline);
+
+// Unadjusted baseline for an interval of the day (kWh), O(1)
+double baseline_predict(const CustomerBaseline *baseline, int interval);
+
+// Day-of adjusted baseline for an interval of an event starting at event_start_interval (kWh)
+double baseline_adjusted(const CustomerBaseline *baseline, int event_start_interval, int interval);
+
+// Predicted reduction credited against the adjusted baseline for a predicted site load (kWh, never negative)
+double baseline_predicted_reduction(const CustomerBaseline *baseline, int event_start_interval, int interval,
+                                    double predicted_load_kwh);
+
+// Unadjusted baseline summed per hour (kWh), as consumed by calculate_cbp_strategy
+void baseline_hourly_profile(const CustomerBaseline *baseline, double *hourly_kwh);
+
+#endif // BASELINE_H
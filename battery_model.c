@@ -0,0 +1,241 @@
+#include "battery_model.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATTERY_FLEET_ARRAYS 17         // Number of float arrays carved from one allocation
+#define OCV_KNOTS 15                    // Breakpoints of the piecewise-linear open-circuit voltage curve
+
+// Plain selects rather than fminf/fmaxf, whose NaN handling keeps GCC from vectorizing without -ffinite-math-only
+// Functions rather than macros, so each argument is computed once up front: a division left inside one arm of the
+// select could trap and would stop if-conversion. sqrtf still needs -fno-math-errno for the step loop to vectorize
+static inline float _minf(float a, float b) {
+    return a < b ? a : b;
+}
+
+static inline float _maxf(float a, float b) {
+    return a > b ? a : b;
+}
+
+// SOC breakpoints, packed tight around the knees where the curve bends
+static const float ocv_knots[OCV_KNOTS] = {
+    0.0f, 0.02f, 0.05f, 0.08f, 0.12f, 0.18f, 0.3f, 0.5f, 0.7f, 0.82f, 0.88f, 0.92f, 0.95f, 0.975f, 1.0f
+};
+
+// Cell OCV as a sum of hinge terms, ocv_base + sum of ocv_slope[k] * max(soc - ocv_knots[k], 0), within about 5 mV
+// of the curve; the step loop evaluates it with multiplies and selects instead of an expf call or a table gather
+static float ocv_base;
+static float ocv_slope[OCV_KNOTS - 1];
+
+// LFP open-circuit voltage per cell: flat plateau with exponential knees at both ends
+static float _lfp_cell_ocv(float soc) {
+    return 3.25f + 0.1f * soc - 0.35f * expf(-15.0f * soc) + 0.15f * expf(-25.0f * (1.0f - soc));
+}
+
+// Interpolate the curve between breakpoints; each hinge adds the change in slope at its knot
+static void _build_ocv_curve(void) {
+    ocv_base = _lfp_cell_ocv(0.0f);
+    float previous_slope = 0.0f;
+    for (int k = 0; k < OCV_KNOTS - 1; k++) {
+        float slope = (_lfp_cell_ocv(ocv_knots[k + 1]) - _lfp_cell_ocv(ocv_knots[k])) / (ocv_knots[k + 1] - ocv_knots[k]);
+        ocv_slope[k] = slope - previous_slope;
+        previous_slope = slope;
+    }
+}
+
+// Piecewise-linear cell OCV; a fixed-length loop of selects that unrolls and vectorizes across packs
+static inline float _curve_cell_ocv(float soc) {
+    float ocv = ocv_base;
+    for (int k = 0; k < OCV_KNOTS - 1; k++) {
+        ocv += ocv_slope[k] * _maxf(soc - ocv_knots[k], 0.0f);
+    }
+    return ocv;
+}
+
+// Default parameters for a 51.2 V 100 Ah LFP pack
+void battery_pack_default_params(BatteryPackParams *params) {
+    params->capacity_ah = 100.0;
+    params->series_cells = 16;
+    params->r0 = 0.015;
+    params->r1 = 0.010;
+    params->c1 = 3000.0;
+    params->max_current = 100.0;
+    params->min_cell_voltage = 2.8;
+    params->max_cell_voltage = 3.6;
+    params->thermal_mass = 40000.0;
+    params->thermal_resistance = 1.5;
+}
+
+// Allocate a fleet of packs sharing one parameter set
+int battery_fleet_init(BatteryFleetModel *fleet, int count, const BatteryPackParams *params,
+                       double initial_soc, double initial_temperature) {
+    memset(fleet, 0, sizeof(*fleet));
+    if (count <= 0) {
+        return -1;
+    }
+
+    // One contiguous block keeps every array in the same allocation and easy to free
+    float *block = (float*)malloc((size_t)count * BATTERY_FLEET_ARRAYS * sizeof(float));
+    if (block == NULL) {
+        return -1;
+    }
+
+    float **arrays[BATTERY_FLEET_ARRAYS] = {
+        &fleet->capacity_as, &fleet->series_cells, &fleet->r0, &fleet->r1, &fleet->rc_decay_rate,
+        &fleet->max_current, &fleet->min_voltage, &fleet->max_voltage, &fleet->inv_thermal_mass,
+        &fleet->inv_thermal_resistance, &fleet->soc, &fleet->v_rc, &fleet->temperature,
+        &fleet->voltage, &fleet->current, &fleet->power_kw, &fleet->rc_decay
+    };
+    for (int a = 0; a < BATTERY_FLEET_ARRAYS; a++) {
+        *arrays[a] = &block[(size_t)a * count];
+    }
+    fleet->count = count;
+    fleet->decay_dt = 0.0f;
+    _build_ocv_curve();
+
+    for (int i = 0; i < count; i++) {
+        fleet->capacity_as[i] = (float)(params->capacity_ah * 3600.0);
+        fleet->series_cells[i] = (float)params->series_cells;
+        fleet->r0[i] = (float)params->r0;
+        fleet->r1[i] = (float)params->r1;
+        fleet->rc_decay_rate[i] = (float)(1.0 / (params->r1 * params->c1));
+        fleet->max_current[i] = (float)params->max_current;
+        fleet->min_voltage[i] = (float)(params->min_cell_voltage * params->series_cells);
+        fleet->max_voltage[i] = (float)(params->max_cell_voltage * params->series_cells);
+        fleet->inv_thermal_mass[i] = (float)(1.0 / params->thermal_mass);
+        fleet->inv_thermal_resistance[i] = (float)(1.0 / params->thermal_resistance);
+        fleet->soc[i] = (float)initial_soc;
+        fleet->v_rc[i] = 0.0f;
+        fleet->temperature[i] = (float)initial_temperature;
+        fleet->voltage[i] = fleet->series_cells[i] * _curve_cell_ocv(fleet->soc[i]);
+        fleet->current[i] = 0.0f;
+        fleet->power_kw[i] = 0.0f;
+    }
+
+    return 0;
+}
+
+// Release fleet arrays
+void battery_fleet_free(BatteryFleetModel *fleet) {
+    // capacity_as is the start of the shared block
+    free(fleet->capacity_as);
+    memset(fleet, 0, sizeof(*fleet));
+}
+
+// Advance every pack by dt seconds at the requested power
+void battery_fleet_step(BatteryFleetModel *fleet, const float *power_request_kw, float ambient_temperature, float dt) {
+    const int count = fleet->count;
+
+    // The RC decay factor only depends on the step length, so it is recomputed only when dt changes
+    if (dt != fleet->decay_dt) {
+        for (int i = 0; i < count; i++) {
+            fleet->rc_decay[i] = expf(-dt * fleet->rc_decay_rate[i]);
+        }
+        fleet->decay_dt = dt;
+    }
+
+    // Hoist the arrays into restrict-qualified locals so the compiler knows they do not alias and vectorizes the loop
+    const float *restrict request = power_request_kw;
+    const float *restrict capacity_as = fleet->capacity_as;
+    const float *restrict series_cells = fleet->series_cells;
+    const float *restrict r0_ref = fleet->r0;
+    const float *restrict r1 = fleet->r1;
+    const float *restrict rc_decay = fleet->rc_decay;
+    const float *restrict max_current = fleet->max_current;
+    const float *restrict min_voltage = fleet->min_voltage;
+    const float *restrict max_voltage = fleet->max_voltage;
+    const float *restrict inv_thermal_mass = fleet->inv_thermal_mass;
+    const float *restrict inv_thermal_resistance = fleet->inv_thermal_resistance;
+    float *restrict soc = fleet->soc;
+    float *restrict v_rc = fleet->v_rc;
+    float *restrict temperature = fleet->temperature;
+    float *restrict voltage = fleet->voltage;
+    float *restrict current_out = fleet->current;
+    float *restrict power_out = fleet->power_kw;
+
+    // GCC gives up on the alias checks between that many arrays despite restrict, so ivdep asserts it as well
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC ivdep
+#endif
+    for (int i = 0; i < count; i++) {
+        // Ohmic resistance rises in the cold: quadratic fit, about 2x at 0°C and 3x at -15°C, floored at half
+        float cold = 25.0f - temperature[i];
+        float r0 = r0_ref[i] * _maxf(1.0f + 0.03f * cold + 0.0005f * cold * cold, 0.5f);
+        float source = series_cells[i] * _curve_cell_ocv(soc[i]) - v_rc[i];
+        float power = request[i] * 1000.0f;
+
+        // Solve P = (E - I * R0) * I for the smaller root; clamping the discriminant at zero
+        // caps the request at the circuit's maximum power transfer E² / (4 * R0)
+        // The clamp is (x + |x|) / 2 rather than a select, which GCC would thread into a branch around sqrtf
+        float raw_discriminant = source * source - 4.0f * r0 * power;
+        float discriminant = 0.5f * (raw_discriminant + fabsf(raw_discriminant));
+        float current = (source - sqrtf(discriminant)) / (2.0f * r0);
+
+        // Current limit and terminal voltage cutoffs in both directions
+        float discharge_limit = _minf(max_current[i], _maxf((source - min_voltage[i]) / r0, 0.0f));
+        float charge_limit = _minf(max_current[i], _maxf((max_voltage[i] - source) / r0, 0.0f));
+        current = _minf(_maxf(current, -charge_limit), discharge_limit);
+
+        // Coulomb counting, never moving more charge than is left to empty or fill
+        float empty_limit = soc[i] * capacity_as[i] / dt;
+        float full_limit = (1.0f - soc[i]) * capacity_as[i] / dt;
+        current = _minf(_maxf(current, -full_limit), empty_limit);
+        soc[i] = _minf(_maxf(soc[i] - current * dt / capacity_as[i], 0.0f), 1.0f);
+
+        // Exact discretization of the RC branch
+        float decay = rc_decay[i];
+        float polarization = v_rc[i] * decay + r1[i] * current * (1.0f - decay);
+
+        // Lumped thermal model: Joule heating in R0 and R1 against losses to ambient
+        float heat = current * current * r0 + polarization * polarization / r1[i];
+        float cooling = (temperature[i] - ambient_temperature) * inv_thermal_resistance[i];
+        temperature[i] += dt * (heat - cooling) * inv_thermal_mass[i];
+
+        float terminal = source - current * r0;
+        v_rc[i] = polarization;
+        voltage[i] = terminal;
+        current_out[i] = current;
+        power_out[i] = terminal * current / 1000.0f;
+    }
+}
+
+// Energy one pack can deliver at constant power before hitting a limit
+double battery_fleet_deliverable_energy(const BatteryFleetModel *fleet, int index, double power_kw,
+                                        double max_hours, double dt) {
+    if (index < 0 || index >= fleet->count || power_kw <= 0.0 || dt <= 0.0) {
+        return 0.0;
+    }
+
+    // Single-pack view over a copy of this pack's parameters and state
+    float values[BATTERY_FLEET_ARRAYS];
+    float *sources[BATTERY_FLEET_ARRAYS] = {
+        fleet->capacity_as, fleet->series_cells, fleet->r0, fleet->r1, fleet->rc_decay_rate,
+        fleet->max_current, fleet->min_voltage, fleet->max_voltage, fleet->inv_thermal_mass,
+        fleet->inv_thermal_resistance, fleet->soc, fleet->v_rc, fleet->temperature,
+        fleet->voltage, fleet->current, fleet->power_kw, fleet->rc_decay
+    };
+    for (int a = 0; a < BATTERY_FLEET_ARRAYS; a++) {
+        values[a] = sources[a][index];
+    }
+
+    BatteryFleetModel pack = {
+        1, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7],
+        &values[8], &values[9], &values[10], &values[11], &values[12], &values[13], &values[14], &values[15],
+        &values[16], 0.0f
+    };
+
+    float request = (float)power_kw;
+    double energy = 0.0;
+    int steps = (int)ceil(max_hours * 3600.0 / dt);
+    for (int s = 0; s < steps; s++) {
+        battery_fleet_step(&pack, &request, values[12], (float)dt);
+        energy += pack.power_kw[0] * dt / 3600.0;
+
+        // Stop once the pack can no longer hold the requested power
+        if (pack.power_kw[0] < 0.99 * power_kw) {
+            break;
+        }
+    }
+
+    return energy;
+}
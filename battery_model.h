@@ -0,0 +1,66 @@
+#ifndef BATTERY_MODEL_H
+#define BATTERY_MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Parameters for one battery pack's Thevenin equivalent circuit (R0 + one RC pair) and lumped thermal model
+typedef struct {
+    double capacity_ah;             // Pack capacity (Ah)
+    int series_cells;               // LFP cells in series (16 for a 51.2 V pack)
+    double r0;                      // Ohmic resistance at 25°C (ohm)
+    double r1;                      // Polarization resistance (ohm)
+    double c1;                      // Polarization capacitance (F)
+    double max_current;             // Current limit, both directions (A)
+    double min_cell_voltage;        // Discharge cutoff per cell (V)
+    double max_cell_voltage;        // Charge cutoff per cell (V)
+    double thermal_mass;            // Heat capacity (J/K)
+    double thermal_resistance;      // Pack-to-ambient thermal resistance (K/W)
+} BatteryPackParams;
+
+// Structure-of-arrays state for a fleet of packs, so each step is a single branch-free loop the compiler vectorizes
+typedef struct {
+    int count;
+    // Parameters
+    float *capacity_as;             // Capacity in ampere-seconds
+    float *series_cells;
+    float *r0;
+    float *r1;
+    float *rc_decay_rate;           // 1 / (R1 * C1)
+    float *max_current;
+    float *min_voltage;             // Pack cutoffs (V)
+    float *max_voltage;
+    float *inv_thermal_mass;
+    float *inv_thermal_resistance;
+    // State
+    float *soc;                     // State of charge (0.0 to 1.0)
+    float *v_rc;                    // Polarization voltage (V)
+    float *temperature;             // Pack temperature (°C)
+    // Outputs of the last step
+    float *voltage;                 // Terminal voltage (V)
+    float *current;                 // Current, positive on discharge (A)
+    float *power_kw;                // Delivered power, positive on discharge (kW)
+    // Cached RC decay factors for the last step length
+    float *rc_decay;
+    float decay_dt;
+} BatteryFleetModel;
+
+// Default parameters for a 51.2 V 100 Ah LFP pack
+void battery_pack_default_params(BatteryPackParams *params);
+
+// Allocate a fleet of count packs sharing one parameter set, at the given SOC and temperature; returns 0 on success
+int battery_fleet_init(BatteryFleetModel *fleet, int count, const BatteryPackParams *params,
+                       double initial_soc, double initial_temperature);
+
+// Release fleet arrays
+void battery_fleet_free(BatteryFleetModel *fleet);
+
+// Advance every pack by dt seconds at the requested power (kW, positive discharge)
+// Requests beyond the current limit, voltage cutoffs or the circuit's maximum power transfer are curtailed
+void battery_fleet_step(BatteryFleetModel *fleet, const float *power_request_kw, float ambient_temperature, float dt);
+
+// Energy one pack can deliver at constant power before hitting a limit, simulated on a copy of its state (kWh)
+double battery_fleet_deliverable_energy(const BatteryFleetModel *fleet, int index, double power_kw,
+                                        double max_hours, double dt);
+
+#endif // BATTERY_MODEL_H
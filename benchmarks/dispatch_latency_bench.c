@@ -0,0 +1,279 @@
+// End-to-end fast DR dispatch latency: VTN event received to discharge setpoint (0x210) written
+//
+// Build the Linux gateway against the Modbus emulator and this harness's utility API stand-in, then the harness,
+// from the repository root:
+//   gcc -O2 -DGATEWAY_LINUX_RUNTIME -DUTILITY_API_URL='"http://127.0.0.1:18080"' -DVEN_SOCKET_PATH='"/tmp/opencbp-bench-ven.sock"' -Ibenchmarks/modbus_emulator -o gateway_bench gateway_linux.c event_loop.c sunlight_lut.c demand_response.c cbp_planner.c tariff.c baseline.c settlement.c load_forecast.c pv_forecast.c inverter.c soc_trace.c rt_schedule.c spsc_queue.c idle_stats.c mem_stats.c trace.c metrics.c benchmarks/modbus_emulator/modbus_emulator.c -lcurl -lm
+//   gcc -O2 -Wall -Ibenchmarks/modbus_emulator benchmarks/dispatch_latency_bench.c benchmarks/modbus_emulator/modbus_emulator.c -lpthread -o dispatch_latency_bench
+//   ./dispatch_latency_bench ./gateway_bench [events] [--poll-only]
+//
+// A VTN stand-in sends events to a VEN stand-in, which does what openadr_ven-client.py does on an event: write 0x220
+// over the shared RS-485 bus and, unless --poll-only, send the gateway its wakeup datagram. The unmodified gateway
+// runs as a child process, so the numbers include its event loop, Modbus timing at 9600 baud and the bid
+// computation. Events arrive at random phases of the gateway's one-second task grid.
+
+#include "modbus.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define BENCH_DEFAULT_EVENTS 100
+#define BENCH_VEN_SOCKET "/tmp/opencbp-bench-ven.sock"  // Must match the gateway's -DVEN_SOCKET_PATH
+#define BENCH_API_PORT 18080                            // Must match the gateway's -DUTILITY_API_URL
+#define BENCH_DISPATCH_TIMEOUT_US 5000000               // An event not dispatched by then counts as lost
+#define BENCH_MIN_GAP_US 200000                         // Quiet time between events, randomized over one grid period
+#define BENCH_GAP_SPREAD_US 1000000
+
+// Stages of one event, each a timestamp on CLOCK_MONOTONIC
+enum {
+    STAGE_VEN_RECEIVED,             // VTN sent -> VEN received
+    STAGE_DR_WRITTEN,               // VEN received -> 0x220 written
+    STAGE_DISPATCH_READ,            // 0x220 written -> gateway read it
+    STAGE_SETPOINT_WRITTEN,         // Gateway read 0x220 -> 0x210 written
+    STAGE_TOTAL,                    // VTN sent -> 0x210 written
+    NUM_STAGES
+};
+
+static const char *stageNames[NUM_STAGES] = {
+    "VTN -> VEN", "VEN -> 0x220 written", "0x220 -> dispatch read", "dispatch -> 0x210 written", "total"
+};
+
+// Market data making fast DR profitable every hour, so every event ends in a setpoint write
+static const char marketData[] =
+    "{\"prices\":[3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0,3.0],"
+    "\"demand\":[900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900,900],"
+    "\"competitors\":1}";
+
+static EmulatorBank *bank;
+static bool pollOnly = false;
+static int numEvents = BENCH_DEFAULT_EVENTS;
+static uint64_t (*samples)[NUM_STAGES];
+static int completed = 0;
+static int lost = 0;
+
+static void _sleep_us(uint64_t us) {
+    struct timespec duration = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+    nanosleep(&duration, NULL);
+}
+
+// Utility API stand-in: market data on GET /market_data, 200 for every bid
+static void *_apiServer(void *context) {
+    int listener = *(int*)context;
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        char request[1024];
+        ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+        if (received > 0) {
+            request[received] = '\0';
+            const char *body = (strncmp(request, "GET /market_data", 16) == 0) ? marketData : "{}";
+            char response[2048];
+            int length = snprintf(response, sizeof(response),
+                                  "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                                  "Connection: close\r\n\r\n%s", strlen(body), body);
+            send(client, response, (size_t)length, MSG_NOSIGNAL);
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+static void _notifyGateway(int sock, uint16_t active) {
+    if (pollOnly) {
+        return;
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, BENCH_VEN_SOCKET, sizeof(address.sun_path) - 1);
+    char message[32];
+    int length = snprintf(message, sizeof(message), "dr_active=%u", (unsigned)active);
+    sendto(sock, message, (size_t)length, 0, (struct sockaddr*)&address, sizeof(address));
+}
+
+// VTN stand-in: one event at a time, each after a random gap
+static void *_vtn(void *context) {
+    int channel = *(int*)context;
+    for (int i = 0; i < numEvents; i++) {
+        _sleep_us(BENCH_MIN_GAP_US + (uint64_t)rand() % BENCH_GAP_SPREAD_US);
+        uint64_t sent = emulator_now_us();
+        if (write(channel, &sent, sizeof(sent)) != sizeof(sent)) {
+            break;
+        }
+        char ack;
+        if (read(channel, &ack, 1) != 1) {
+            break;
+        }
+    }
+    close(channel);
+    return NULL;
+}
+
+// VEN stand-in: raise the DR flag, wait for the gateway's setpoint, then clear the event
+static void _ven(int channel) {
+    int sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    uint64_t sent;
+
+    while (read(channel, &sent, sizeof(sent)) == sizeof(sent)) {
+        uint64_t received = emulator_now_us();
+        uint32_t writes = atomic_load(&bank->setpoint_writes);
+        uint64_t drWritten = emulator_write(bank, 0x220, 1);
+        _notifyGateway(sock, 1);
+
+        // Poll the bank; the gateway timestamps its own transactions, so polling adds no error
+        bool dispatched = false;
+        while (emulator_now_us() - drWritten < BENCH_DISPATCH_TIMEOUT_US) {
+            if (atomic_load(&bank->setpoint_writes) != writes) {
+                dispatched = true;
+                break;
+            }
+            _sleep_us(100);
+        }
+
+        if (dispatched) {
+            uint64_t *sample = samples[completed++];
+            uint64_t drSeen = atomic_load(&bank->dr_seen_us);
+            uint64_t setpoint = atomic_load(&bank->setpoint_us);
+            sample[STAGE_VEN_RECEIVED] = received - sent;
+            sample[STAGE_DR_WRITTEN] = drWritten - received;
+            sample[STAGE_DISPATCH_READ] = drSeen - drWritten;
+            sample[STAGE_SETPOINT_WRITTEN] = setpoint - drSeen;
+            sample[STAGE_TOTAL] = setpoint - sent;
+        } else {
+            lost++;
+        }
+
+        // End the event and wait for the gateway to see it end, so the next one starts from rest
+        emulator_write(bank, 0x220, 0);
+        _notifyGateway(sock, 0);
+        uint64_t cleared = emulator_now_us();
+        while (atomic_load(&bank->dr_seen) != 0 && emulator_now_us() - cleared < BENCH_DISPATCH_TIMEOUT_US) {
+            _sleep_us(1000);
+        }
+
+        char ack = 1;
+        if (write(channel, &ack, 1) != 1) {
+            break;
+        }
+    }
+    close(sock);
+}
+
+static int _compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double _percentile_ms(const uint64_t *sorted, int count, double fraction) {
+    int index = (int)(fraction * (count - 1) + 0.5);
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s GATEWAY_BINARY [events] [--poll-only]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--poll-only") == 0) {
+            pollOnly = true;
+        } else if (atoi(argv[i]) > 0) {
+            numEvents = atoi(argv[i]);
+        }
+    }
+    samples = calloc((size_t)numEvents, sizeof(*samples));
+    srand((unsigned)time(NULL));
+
+    // Gridlink registers: 80% SOC, 25°C, 1.5 kW site load, no DR event
+    const char *path = getenv("MODBUS_EMULATOR_PATH") ? getenv("MODBUS_EMULATOR_PATH") : EMULATOR_DEFAULT_PATH;
+    setenv("MODBUS_EMULATOR_PATH", path, 1);
+    bank = emulator_open(path, 1);
+    if (bank == NULL || samples == NULL) {
+        fprintf(stderr, "Unable to create the Modbus emulator at %s\n", path);
+        return 1;
+    }
+    atomic_store(&bank->registers[0x208], 80);
+    atomic_store(&bank->registers[0x209], 250);
+    atomic_store(&bank->registers[0x20A], 1500);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(BENCH_API_PORT);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        fprintf(stderr, "Unable to serve the utility API on port %d\n", BENCH_API_PORT);
+        return 1;
+    }
+    pthread_t api;
+    pthread_create(&api, NULL, _apiServer, &listener);
+
+    unlink(BENCH_VEN_SOCKET);
+    pid_t gateway = fork();
+    if (gateway == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        execl(argv[1], argv[1], (char*)NULL);
+        _exit(127);
+    }
+
+    // Ready once the wakeup socket is bound; the one-second jobs then settle the SOC filter
+    struct stat status;
+    for (int i = 0; i < 100 && stat(BENCH_VEN_SOCKET, &status) != 0; i++) {
+        _sleep_us(100000);
+    }
+    _sleep_us(3000000);
+
+    printf("Dispatch latency over %d events (%s, %d baud)\n", numEvents,
+           pollOnly ? "0x220 polling only" : "VEN wakeup datagram",
+           getenv("MODBUS_EMULATOR_BAUD") ? atoi(getenv("MODBUS_EMULATOR_BAUD")) : EMULATOR_DEFAULT_BAUD);
+
+    int channel[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, channel);
+    pthread_t vtn;
+    pthread_create(&vtn, NULL, _vtn, &channel[0]);
+    _ven(channel[1]);
+    pthread_join(vtn, NULL);
+
+    kill(gateway, SIGTERM);
+    waitpid(gateway, NULL, 0);
+
+    if (completed == 0) {
+        fprintf(stderr, "No event was dispatched; check the gateway build line above\n");
+        return 1;
+    }
+
+    printf("%-28s %9s %9s %9s %9s\n", "stage", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    uint64_t *sorted = malloc((size_t)completed * sizeof(uint64_t));
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        for (int i = 0; i < completed; i++) {
+            sorted[i] = samples[i][stage];
+        }
+        qsort(sorted, (size_t)completed, sizeof(uint64_t), _compare);
+        printf("%-28s %9.2f %9.2f %9.2f %9.2f\n", stageNames[stage], _percentile_ms(sorted, completed, 0.5),
+               _percentile_ms(sorted, completed, 0.9), _percentile_ms(sorted, completed, 0.99),
+               sorted[completed - 1] / 1000.0);
+    }
+    if (lost > 0) {
+        printf("%d events not dispatched within %d s\n", lost, BENCH_DISPATCH_TIMEOUT_US / 1000000);
+    }
+
+    free(sorted);
+    free(samples);
+    return 0;
+}
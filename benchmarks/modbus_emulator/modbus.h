@@ -0,0 +1,54 @@
+#ifndef MODBUS_EMULATOR_H
+#define MODBUS_EMULATOR_H
+
+// Stand-in for the subset of libmodbus the gateway uses, for host benchmarks
+// Build the gateway with -Ibenchmarks/modbus_emulator and modbus_emulator.c in place of -lmodbus. Registers live in
+// a file mapped by every process on the emulated bus (MODBUS_EMULATOR_PATH), so a harness can play the VEN and the
+// Gridlink while the unmodified gateway runs as its own process. Each transaction holds the one shared RS-485 bus for
+// its RTU frame time at MODBUS_EMULATOR_BAUD, queuing behind any transaction already on it.
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+
+#define EMULATOR_REGISTERS 0x400        // Addresses 0x000 to 0x3FF
+#define EMULATOR_DEFAULT_PATH "/tmp/opencbp-modbus-emulator"
+#define EMULATOR_DEFAULT_BAUD 9600
+#define EMULATOR_TURNAROUND_US 1750     // Inter-frame silence (3.5 characters) and device turnaround per transaction
+
+// Register bank and dispatch timestamps shared by every process on the bus
+// Timestamps are taken when a register is actually accessed, after the frame time, so an access that oversleeps its
+// bus slot is still ordered after every write it observes
+typedef struct {
+    _Atomic uint16_t registers[EMULATOR_REGISTERS];
+    _Atomic uint64_t bus_free_us;       // End of the last transaction granted the bus (CLOCK_MONOTONIC)
+    _Atomic uint16_t dr_seen;           // 0x220 value the gateway last read
+    _Atomic uint64_t dr_seen_us;        // When the gateway's read first returned a changed 0x220
+    _Atomic uint64_t setpoint_us;       // When the gateway's latest 0x210 write landed
+    _Atomic uint32_t setpoint_writes;   // 0x210 writes by the gateway
+} EmulatorBank;
+
+typedef struct modbus modbus_t;
+
+// libmodbus subset: RTU context, connect and register access against the shared bank
+modbus_t *modbus_new_rtu(const char *device, int baud, char parity, int data_bit, int stop_bit);
+int modbus_connect(modbus_t *ctx);
+void modbus_free(modbus_t *ctx);
+int modbus_set_response_timeout(modbus_t *ctx, uint32_t to_sec, uint32_t to_usec);
+int modbus_read_input_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+int modbus_write_register(modbus_t *ctx, int addr, uint16_t value);
+const char *modbus_strerror(int errnum);
+
+// Map the bank at path, creating and zeroing it when create is set; returns NULL on failure
+EmulatorBank *emulator_open(const char *path, int create);
+
+// Microseconds on CLOCK_MONOTONIC, comparable across processes
+uint64_t emulator_now_us(void);
+
+// Hold the bus for one transaction of request_bytes + response_bytes; returns when the response would have arrived
+uint64_t emulator_transact(EmulatorBank *bank, int request_bytes, int response_bytes);
+
+// Write a register as another master on the bus (the VEN), with the same bus timing; returns when it landed
+uint64_t emulator_write(EmulatorBank *bank, int addr, uint16_t value);
+
+#endif // MODBUS_EMULATOR_H
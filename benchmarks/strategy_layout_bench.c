@@ -0,0 +1,292 @@
+// Fleet fast DR pricing over DemandResponseStrategy: the two-line hot core against the flat layout it replaced, and
+// the time and cache misses of calculate_fast_dr_bid per battery
+//
+// Build from the repository root:
+//   gcc -O2 -Wall -I. benchmarks/strategy_layout_bench.c demand_response.c tariff.c baseline.c load_forecast.c inverter.c -lm
+//
+// The layout comparison prices every battery from exactly the fields calculate_fast_dr_bid reads, once over the
+// 176-byte flat struct from before the hot/cold split and once over the hot core, so only the layout differs. The
+// library run then gives every battery its own strategy, cold configuration and inverter, sharing one compiled tariff
+// and household load forecaster as a fleet engine would, and prices a one-hour fast DR bid per battery each tick.
+// Cache misses come from the PMU via perf_event_open and read "n/a" where the kernel or hypervisor does not expose
+// hardware counters.
+
+#include "demand_response.h"
+#include "tariff.h"
+#include "load_forecast.h"
+#include "inverter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#define BENCH_TOTAL_BIDS 5000000LL      // Bids priced per measurement, split over ticks
+
+// Field order of DemandResponseStrategy before the hot/cold split
+typedef struct {
+    double battery_capacity;
+    double efficiency;
+    double charge_efficiency;
+    double discharge_efficiency;
+    double min_soc;
+    double max_soc;
+    double current_soc;
+    uint32_t cycle_count;
+    double replacement_cost;
+    double k_delta_e1;
+    double k_delta_e2;
+    double cycles_to_eol;
+    RainflowCycle* cycles;
+    int cycle_array_size;
+    int cycle_count_index;
+    double risk_factor;
+    double alpha;
+    double beta;
+    double max_grid_demand;
+    const void *tariff;
+    const void *baseline;
+    const void *load_forecast;
+    const void *inverter;
+} FlatStrategy;
+
+// Ingest a SOC reading and price a bid from the fields calculate_fast_dr_bid reads. Both layouts run the same
+// body, so the two scans differ only in where those fields sit
+static double _tick_flat(FlatStrategy *fleet, int count, const float *soc_readings, double market_price,
+                         double grid_demand) {
+    double offered = 0.0;
+    for (int i = 0; i < count; i++) {
+        fleet[i].current_soc = soc_readings[i];
+        double available = (fleet[i].current_soc - fleet[i].min_soc) * fleet[i].battery_capacity;
+        double depth = available / fleet[i].battery_capacity;
+        double stress = fleet[i].k_delta_e1 * depth * (1.0 + fleet[i].k_delta_e2 * depth);
+        double degradation = fleet[i].replacement_cost / fleet[i].battery_capacity * depth * stress /
+                             fleet[i].cycles_to_eol;
+        double marginal = degradation * (1.0 + fleet[i].risk_factor) / fleet[i].efficiency;
+        double price = market_price * (1.0 + fleet[i].alpha * grid_demand / fleet[i].max_grid_demand /
+                                      (10.0 * fleet[i].beta + 1.0));
+        bool attached = fleet[i].tariff != NULL && fleet[i].load_forecast != NULL && fleet[i].inverter != NULL;
+        if (attached && price > marginal) {
+            offered += available * price;
+        }
+    }
+    return offered;
+}
+
+static double _tick_split(DemandResponseStrategy *fleet, int count, const float *soc_readings, double market_price,
+                          double grid_demand) {
+    double offered = 0.0;
+    for (int i = 0; i < count; i++) {
+        fleet[i].current_soc = soc_readings[i];
+        double available = (fleet[i].current_soc - fleet[i].min_soc) * fleet[i].battery_capacity;
+        double depth = available / fleet[i].battery_capacity;
+        double stress = fleet[i].k_delta_e1 * depth * (1.0 + fleet[i].k_delta_e2 * depth);
+        double degradation = fleet[i].replacement_cost / fleet[i].battery_capacity * depth * stress /
+                             fleet[i].cycles_to_eol;
+        double marginal = degradation * (1.0 + fleet[i].risk_factor) / fleet[i].efficiency;
+        double price = market_price * (1.0 + fleet[i].alpha * grid_demand / fleet[i].max_grid_demand /
+                                      (10.0 * fleet[i].beta + 1.0));
+        bool attached = fleet[i].tariff != NULL && fleet[i].load_forecast != NULL && fleet[i].inverter != NULL;
+        if (attached && price > marginal) {
+            offered += available * price;
+        }
+    }
+    return offered;
+}
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Hardware cache event counter for this thread, or -1 if unavailable
+static int _open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t _read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+static void _format_rate(char *text, size_t size, int fd, uint64_t count, double bids) {
+    if (fd < 0) {
+        snprintf(text, size, "n/a");
+    } else {
+        snprintf(text, size, "%.2f", count / bids);
+    }
+}
+
+int main(void) {
+    static const int fleet_sizes[] = {1000, 10000, 100000, 1000000};
+
+    // L1 data read misses and last-level misses
+    int l1_fd = _open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    int llc_fd = _open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    TariffSchedule schedule;
+    CompiledTariff tariff;
+    tariff_default_schedule(&schedule);
+    LoadForecaster load_forecaster;
+    if (tariff_compile(&schedule, local.tm_year + 1900, 15, &tariff) != 0 ||
+        load_forecast_init(&load_forecaster, 15, 0.1) != 0) {
+        fprintf(stderr, "Unable to set up the tariff or load forecast\n");
+        return 1;
+    }
+    for (int day = 0; day < 14; day++) {
+        for (int interval = 0; interval < 96; interval++) {
+            time_t start = now - (time_t)(14 - day) * 86400 + interval * 900;
+            load_forecast_update(&load_forecaster, start, 0.1 + 0.05 * (interval % 8));
+        }
+    }
+
+    InverterCapability shared_inverter;
+    inverter_init(&shared_inverter, 5.0, 5.0);
+    printf("sizeof flat %zu bytes, hot core %zu bytes (aligned %zu), cold config %zu bytes\n", sizeof(FlatStrategy),
+           sizeof(DemandResponseStrategy), _Alignof(DemandResponseStrategy), sizeof(DemandResponseConfig));
+    printf("%10s %14s %14s %9s\n", "batteries", "flat ns/bid", "split ns/bid", "speedup");
+
+    for (size_t f = 0; f < sizeof(fleet_sizes) / sizeof(fleet_sizes[0]); f++) {
+        int count = fleet_sizes[f];
+        int ticks = (int)(BENCH_TOTAL_BIDS / count);
+
+        FlatStrategy *flat = (FlatStrategy*)calloc(count, sizeof(FlatStrategy));
+        DemandResponseStrategy *split = (DemandResponseStrategy*)aligned_alloc(DR_CACHE_LINE_SIZE,
+                                                                               count * sizeof(DemandResponseStrategy));
+        DemandResponseConfig *configs = (DemandResponseConfig*)calloc(count, sizeof(DemandResponseConfig));
+        float *soc_readings = (float*)malloc(count * sizeof(float));
+        if (flat == NULL || split == NULL || configs == NULL || soc_readings == NULL) {
+            fprintf(stderr, "Allocation failed for %d batteries\n", count);
+            return 1;
+        }
+        memset(split, 0, count * sizeof(DemandResponseStrategy));
+
+        for (int i = 0; i < count; i++) {
+            double capacity = 6.5 + (i % 7);
+            flat[i] = (FlatStrategy){ .battery_capacity = capacity, .efficiency = 0.95, .min_soc = 0.1, .max_soc = 0.9,
+                                      .replacement_cost = 4000.0, .k_delta_e1 = 0.8, .k_delta_e2 = 0.3,
+                                      .cycles_to_eol = 4000.0, .risk_factor = 0.1, .alpha = 0.3, .beta = 0.5,
+                                      .max_grid_demand = 50000.0, .tariff = &tariff, .load_forecast = &load_forecaster,
+                                      .inverter = &shared_inverter };
+            split[i].battery_capacity = capacity;
+            split[i].efficiency = 0.95;
+            split[i].min_soc = 0.1;
+            split[i].replacement_cost = 4000.0;
+            split[i].k_delta_e1 = 0.8;
+            split[i].k_delta_e2 = 0.3;
+            split[i].cycles_to_eol = 4000.0;
+            split[i].risk_factor = 0.1;
+            split[i].alpha = 0.3;
+            split[i].beta = 0.5;
+            split[i].max_grid_demand = 50000.0;
+            split[i].tariff = &tariff;
+            split[i].load_forecast = &load_forecaster;
+            split[i].inverter = &shared_inverter;
+            split[i].config = &configs[i];
+            configs[i].max_soc = 0.9;
+            soc_readings[i] = 0.2f + 0.7f * (float)rand() / RAND_MAX;
+        }
+
+        double checksum = 0.0;
+        double start = _now();
+        for (int t = 0; t < ticks; t++) {
+            checksum += _tick_flat(flat, count, soc_readings, 0.3 + 0.1 * (t % 4), 30000.0);
+        }
+        double flat_elapsed = _now() - start;
+        start = _now();
+        for (int t = 0; t < ticks; t++) {
+            checksum -= _tick_split(split, count, soc_readings, 0.3 + 0.1 * (t % 4), 30000.0);
+        }
+        double split_elapsed = _now() - start;
+
+        double bids = (double)ticks * count;
+        printf("%10d %14.2f %14.2f %8.2fx%s\n", count, flat_elapsed * 1e9 / bids, split_elapsed * 1e9 / bids,
+               flat_elapsed / split_elapsed, (checksum > 1e-6 || checksum < -1e-6) ? " (checksum mismatch)" : "");
+
+        free(flat);
+        free(split);
+        free(configs);
+        free(soc_readings);
+    }
+
+    printf("\n%10s %12s %16s %16s %10s\n", "batteries", "ns/bid", "L1D misses/bid", "LLC misses/bid", "bidding");
+
+    for (size_t f = 0; f < sizeof(fleet_sizes) / sizeof(fleet_sizes[0]); f++) {
+        int count = fleet_sizes[f];
+        int ticks = (int)(BENCH_TOTAL_BIDS / count);
+
+        DemandResponseStrategy *fleet = (DemandResponseStrategy*)aligned_alloc(DR_CACHE_LINE_SIZE,
+                                                                               count * sizeof(DemandResponseStrategy));
+        InverterCapability *inverters = (InverterCapability*)malloc(count * sizeof(InverterCapability));
+        float *soc_readings = (float*)malloc(count * sizeof(float));
+        if (fleet == NULL || inverters == NULL || soc_readings == NULL) {
+            fprintf(stderr, "Allocation failed for %d batteries\n", count);
+            return 1;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (DemandResponseStrategy_init(&fleet[i], 6.5 + (i % 7), 0.95) != 0) {
+                fprintf(stderr, "Allocation failed for battery %d of %d\n", i, count);
+                return 1;
+            }
+            inverter_init(&inverters[i], 5.0, 5.0);
+            fleet[i].tariff = &tariff;
+            fleet[i].load_forecast = &load_forecaster;
+            fleet[i].inverter = &inverters[i];
+            soc_readings[i] = 0.2f + 0.7f * (float)rand() / RAND_MAX;
+        }
+
+        ioctl(l1_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(llc_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(l1_fd, PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(llc_fd, PERF_EVENT_IOC_ENABLE, 0);
+        long long bidding = 0;
+        double start = _now();
+        for (int t = 0; t < ticks; t++) {
+            for (int i = 0; i < count; i++) {
+                double bid_capacity, bid_price;
+                fleet[i].current_soc = soc_readings[i];
+                calculate_fast_dr_bid(&fleet[i], 0.3 + 0.1 * (t % 4), 30000.0, 1.0, now, &bid_capacity, &bid_price);
+                bidding += (bid_capacity > 0.0);
+            }
+        }
+        double elapsed = _now() - start;
+        ioctl(l1_fd, PERF_EVENT_IOC_DISABLE, 0);
+        ioctl(llc_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        double bids = (double)ticks * count;
+        char l1_text[32], llc_text[32];
+        _format_rate(l1_text, sizeof(l1_text), l1_fd, _read_counter(l1_fd), bids);
+        _format_rate(llc_text, sizeof(llc_text), llc_fd, _read_counter(llc_fd), bids);
+        printf("%10d %12.1f %16s %16s %9.0f%%\n", count, elapsed * 1e9 / bids, l1_text, llc_text, 100.0 * bidding / bids);
+
+        for (int i = 0; i < count; i++) {
+            DemandResponseStrategy_free(&fleet[i]);
+        }
+        free(fleet);
+        free(inverters);
+        free(soc_readings);
+    }
+
+    tariff_free(&tariff);
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Fleet telemetry ingestion throughput: reports per second from many gateway connections into the columnar files
+//
+// Build the server, then the harness, from the repository root:
+//   gcc -O2 -Wall -o telemetry_server telemetry_server.c telemetry.c spsc_queue.c metrics.c -lpthread
+//   gcc -O2 -Wall -I. -o telemetry_ingest_bench benchmarks/telemetry_ingest_bench.c telemetry.c
+//   ./telemetry_ingest_bench ./telemetry_server [--gateways 1000] [--rate 100000] [--batch 10] [--seconds 10]
+//
+// Each gateway connection says HELLO and then sends frames of --batch reports, round robin, paced open loop to
+// --rate reports per second in total. The server runs as a child process writing to a scratch directory. After
+// SIGTERM it writes out every open block, and the harness reads the partition files back to check every report
+// landed, in order, under the right gateway.
+
+#include "telemetry.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define BENCH_PORT 19102
+#define BENCH_TICK_US 1000              // Pacing granularity
+
+static uint64_t _now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static int _send_all(int fd, const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char*)data;
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static int _connect(uint32_t gateway) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(BENCH_PORT);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    struct {
+        TelemetryFrameHeader header;
+        uint32_t gateway;
+    } hello = {{TELEMETRY_FRAME_MAGIC, TELEMETRY_FRAME_VERSION, TELEMETRY_HELLO, sizeof(uint32_t)}, gateway};
+    if (_send_all(fd, &hello, sizeof(hello)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Rows in every partition file between two report times
+static uint64_t _rows_on_disk(const char *dir, uint32_t first, uint32_t last) {
+    uint64_t rows = 0;
+    for (uint32_t partition = telemetry_partition(first); partition <= telemetry_partition(last); partition++) {
+        char path[512];
+        telemetry_partition_path(path, sizeof(path), dir, partition);
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+            continue;
+        }
+        TelemetryBlockHeader header;
+        while (fread(&header, sizeof(header), 1, file) == 1 && header.magic == TELEMETRY_BLOCK_MAGIC) {
+            rows += header.rows;
+            fseek(file, (long)(header.rows * TELEMETRY_COLUMNS * sizeof(uint32_t)), SEEK_CUR);
+        }
+        fclose(file);
+    }
+    return rows;
+}
+
+int main(int argc, char **argv) {
+    int gateways = 1000;
+    double rate = 100000.0;
+    int batch = 10;
+    double seconds = 10.0;
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s SERVER_BINARY [--gateways N] [--rate REPORTS_PER_S] [--batch N] [--seconds S]\n",
+                argv[0]);
+        return 1;
+    }
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--gateways") == 0) {
+            gateways = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            rate = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            seconds = atof(argv[i + 1]);
+        }
+    }
+    if (gateways <= 0 || rate <= 0.0 || batch <= 0 || batch * sizeof(TelemetryReport) > TELEMETRY_MAX_FRAME) {
+        fprintf(stderr, "Bad arguments\n");
+        return 1;
+    }
+
+    // One descriptor per gateway
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    char dir[] = "/tmp/opencbp-telemetry-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char port[16];
+    snprintf(port, sizeof(port), "%d", BENCH_PORT);
+    pid_t server = fork();
+    if (server == 0) {
+        freopen("/dev/null", "w", stdout);
+        execl(argv[1], argv[1], "--port", port, "--dir", dir, (char*)NULL);
+        _exit(127);
+    }
+
+    // Ready once it accepts
+    int *fds = (int*)malloc((size_t)gateways * sizeof(int));
+    uint32_t *sent = (uint32_t*)calloc((size_t)gateways, sizeof(uint32_t));
+    int probe = -1;
+    for (int i = 0; i < 100 && (probe = _connect(0)) < 0; i++) {
+        usleep(50000);
+    }
+    if (probe < 0 || fds == NULL || sent == NULL) {
+        fprintf(stderr, "Telemetry server did not start\n");
+        kill(server, SIGTERM);
+        return 1;
+    }
+    close(probe);
+    for (int i = 0; i < gateways; i++) {
+        fds[i] = _connect((uint32_t)i + 1);
+        if (fds[i] < 0) {
+            fprintf(stderr, "Connection %d refused\n", i);
+            kill(server, SIGTERM);
+            return 1;
+        }
+    }
+
+    // Every gateway reports a plausible discharge; report times are wall-clock seconds
+    size_t frame_size = sizeof(TelemetryFrameHeader) + (size_t)batch * sizeof(TelemetryReport);
+    unsigned char *frame = (unsigned char*)malloc(frame_size);
+    TelemetryFrameHeader header = {TELEMETRY_FRAME_MAGIC, TELEMETRY_FRAME_VERSION, TELEMETRY_REPORTS,
+                                   (uint32_t)(batch * sizeof(TelemetryReport))};
+    memcpy(frame, &header, sizeof(header));
+    TelemetryReport *reports = (TelemetryReport*)(frame + sizeof(header));
+
+    printf("%d gateways, %d reports per frame, %.0f reports/s offered for %.0f s\n", gateways, batch, rate, seconds);
+    uint32_t first_time = (uint32_t)time(NULL);
+    uint64_t start = _now_us();
+    uint64_t end = start + (uint64_t)(seconds * 1e6);
+    uint64_t frames = 0;
+    int next = 0;
+    for (uint64_t now = start; now < end; now = _now_us()) {
+        // Frames owed so far at the offered rate
+        uint64_t due = (uint64_t)((now - start) / 1e6 * rate / batch);
+        if (frames >= due) {
+            usleep(BENCH_TICK_US);
+            continue;
+        }
+        while (frames < due) {
+            uint32_t report_time = (uint32_t)time(NULL);
+            for (int r = 0; r < batch; r++) {
+                float progress = (float)((sent[next] + (uint32_t)r) % 3600) / 3600.0f;
+                reports[r] = (TelemetryReport){report_time, 0.9f - 0.5f * progress, 25.0f, 2.5f, 2.5f / 3600.0f,
+                                               2.5f, 0.35f, 100.0f + progress};
+            }
+            if (_send_all(fds[next], frame, frame_size) != 0) {
+                fprintf(stderr, "Gateway %d disconnected\n", next + 1);
+                end = 0;
+                break;
+            }
+            sent[next] += (uint32_t)batch;
+            frames++;
+            next = (next + 1 == gateways) ? 0 : next + 1;
+        }
+    }
+    double elapsed = (_now_us() - start) / 1e6;
+    uint32_t last_time = (uint32_t)time(NULL);
+
+    for (int i = 0; i < gateways; i++) {
+        close(fds[i]);
+    }
+    uint64_t stop = _now_us();
+    kill(server, SIGTERM);
+    int status = 0;
+    waitpid(server, &status, 0);
+    double drain = (_now_us() - stop) / 1e6;
+
+    uint64_t offered = frames * (uint64_t)batch;
+    uint64_t rows = _rows_on_disk(dir, first_time, last_time);
+    printf("Sent %llu reports in %.2f s: %.0f reports/s\n", (unsigned long long)offered, elapsed, offered / elapsed);
+    printf("On disk: %llu rows (%s), server exit %d after %.2f s\n", (unsigned long long)rows,
+           rows == offered ? "all" : "MISSING", WIFEXITED(status) ? WEXITSTATUS(status) : -1, drain);
+
+    // Read back one gateway as the settlement and calibration tools would
+    TelemetrySeries series;
+    memset(&series, 0, sizeof(series));
+    for (uint32_t partition = telemetry_partition(first_time); partition <= telemetry_partition(last_time);
+         partition++) {
+        char path[512];
+        telemetry_partition_path(path, sizeof(path), dir, partition);
+        telemetry_load_series(path, 1, &series);
+    }
+    printf("Gateway 1: %lld of %u reports read back\n", (long long)series.count, sent[0]);
+    telemetry_series_free(&series);
+
+    char command[600];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) {
+        fprintf(stderr, "Unable to remove %s\n", dir);
+    }
+    free(frame);
+    free(fds);
+    free(sent);
+    return rows == offered ? 0 : 1;
+}
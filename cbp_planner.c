@@ -0,0 +1,444 @@
+#include "cbp_planner.h"
+#include "inverter.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLAN_MAX_ITERATIONS 60          // Iteration cap for both the hourly and shadow price searches
+#define PLAN_ENERGY_TOLERANCE 1e-7      // Convergence tolerance on energy (kWh)
+#define PLAN_MIN_WEIGHT 1e-9            // Smallest usable degradation weight
+
+// Horizon policies store next-SOC grid indices in one byte
+#if CBP_SOC_GRID_POINTS > 256
+#error "CBP_SOC_GRID_POINTS must fit in an unsigned char policy entry"
+#endif
+
+// Expected revenue per kWh for an hour, matching the peak weighting used by calculate_capacity_allocation
+static double _expected_hour_price(double *day_ahead_prices, int *expected_peak_hours, int hour) {
+    bool is_peak_hour = (expected_peak_hours != NULL) && expected_peak_hours[hour];
+    return day_ahead_prices[hour] * (is_peak_hour ? 1.2 : 1.0);
+}
+
+// Degradation cost of discharging a given energy in one hour: D(e) = c(e / C) * e
+static double _hour_degradation(DemandResponseStrategy *strategy, double energy) {
+    double depth = energy / strategy->battery_capacity;
+    return calculate_degradation_cost(strategy, depth) * energy;
+}
+
+// Marginal degradation D'(e) and curvature D''(e) of the hourly degradation cost
+static double _hour_marginal_degradation(DemandResponseStrategy *strategy, double energy, double *curvature) {
+    // With K = R * k1 / (C * N) and δ = e / C:
+    // D'(e)  = K * exp(k2 * δ) * (3δ² + k2 * δ³)
+    // D''(e) = K * exp(k2 * δ) * (6δ + 6 * k2 * δ² + k2² * δ³) / C
+    double k2 = strategy->k_delta_e2;
+    double scale = strategy->replacement_cost * strategy->k_delta_e1 /
+                   (strategy->battery_capacity * strategy->cycles_to_eol);
+    double depth = energy / strategy->battery_capacity;
+    double growth = scale * exp(k2 * depth);
+
+    if (curvature != NULL) {
+        *curvature = growth * depth * (6.0 + 6.0 * k2 * depth + k2 * k2 * depth * depth) / strategy->battery_capacity;
+    }
+
+    return growth * depth * depth * (3.0 + k2 * depth);
+}
+
+// Solve weight * D'(e) = target for one hour on [0, max_energy] by safeguarded Newton from a warm start
+static double _solve_hour_energy(DemandResponseStrategy *strategy, double weight, double target,
+                                 double max_energy, double warm_energy) {
+    if (target <= 0.0) {
+        return 0.0;
+    }
+    if (weight * _hour_marginal_degradation(strategy, max_energy, NULL) <= target) {
+        return max_energy;
+    }
+
+    double lo = 0.0;
+    double hi = max_energy;
+    double energy = fmin(fmax(warm_energy, 0.0), max_energy);
+
+    for (int iter = 0; iter < PLAN_MAX_ITERATIONS; iter++) {
+        double curvature;
+        double residual = weight * _hour_marginal_degradation(strategy, energy, &curvature) - target;
+
+        // D' is increasing, so the sign of the residual tightens the bracket
+        if (residual > 0.0) {
+            hi = energy;
+        } else {
+            lo = energy;
+        }
+
+        double next = energy - residual / (weight * curvature);
+        if (!(next > lo && next < hi)) {
+            next = 0.5 * (lo + hi);
+        }
+
+        if (fabs(next - energy) < PLAN_ENERGY_TOLERANCE || hi - lo < PLAN_ENERGY_TOLERANCE) {
+            return next;
+        }
+        energy = next;
+    }
+
+    return energy;
+}
+
+// Total planned energy at a given shadow price; also returns d(total)/d(lambda) for Newton steps
+static double _plan_at_shadow_price(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours,
+                                    int num_hours, double weight, double max_energy, double lambda,
+                                    double *hour_energy, double *d_total) {
+    double total = 0.0;
+    double slope = 0.0;
+
+    for (int hour = 0; hour < num_hours; hour++) {
+        double target = _expected_hour_price(day_ahead_prices, expected_peak_hours, hour) - lambda;
+        hour_energy[hour] = _solve_hour_energy(strategy, weight, target, max_energy, hour_energy[hour]);
+        total += hour_energy[hour];
+
+        // Only hours strictly inside their bounds respond to a change in the shadow price
+        if (hour_energy[hour] > 0.0 && hour_energy[hour] < max_energy) {
+            double curvature;
+            _hour_marginal_degradation(strategy, hour_energy[hour], &curvature);
+            if (curvature > 0.0) {
+                slope -= 1.0 / (weight * curvature);
+            }
+        }
+    }
+
+    *d_total = slope;
+    return total;
+}
+
+// Solve the day-ahead plan maximizing expected revenue minus weighted degradation cost
+double solve_weighted_cbp_plan(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours,
+                               int num_hours, double degradation_weight, double lambda_hint, double *hour_energy) {
+    double weight = fmax(degradation_weight, PLAN_MIN_WEIGHT);
+
+    // Shared SOC window available for discharge across the day
+    double available_energy = strategy->battery_capacity * (strategy->config->max_soc - strategy->min_soc);
+    double hour_max_energy = calculate_deliverable_capacity(strategy, 1.0, available_energy);
+    double d_total;
+
+    // The separable problem couples hours only through the SOC window; if it is slack, no shadow price is needed
+    double total = _plan_at_shadow_price(strategy, day_ahead_prices, expected_peak_hours, num_hours, weight,
+                                         hour_max_energy, 0.0, hour_energy, &d_total);
+    if (total <= available_energy) {
+        return 0.0;
+    }
+
+    // At the highest expected price no hour discharges, so [0, max_price] brackets the shadow price
+    double lo = 0.0;
+    double hi = 0.0;
+    for (int hour = 0; hour < num_hours; hour++) {
+        hi = fmax(hi, _expected_hour_price(day_ahead_prices, expected_peak_hours, hour));
+    }
+
+    double lambda = (lambda_hint > lo && lambda_hint < hi) ? lambda_hint : 0.5 * (lo + hi);
+
+    for (int iter = 0; iter < PLAN_MAX_ITERATIONS; iter++) {
+        total = _plan_at_shadow_price(strategy, day_ahead_prices, expected_peak_hours, num_hours, weight,
+                                      hour_max_energy, lambda, hour_energy, &d_total);
+        double excess = total - available_energy;
+
+        if (fabs(excess) < PLAN_ENERGY_TOLERANCE) {
+            break;
+        }
+
+        // Total energy falls as the shadow price rises
+        if (excess > 0.0) {
+            lo = lambda;
+        } else {
+            hi = lambda;
+        }
+
+        double next = (d_total < 0.0) ? lambda - excess / d_total : 0.5 * (lo + hi);
+        if (!(next > lo && next < hi)) {
+            next = 0.5 * (lo + hi);
+        }
+        if (hi - lo < PLAN_ENERGY_TOLERANCE * 1e-3) {
+            break;
+        }
+        lambda = next;
+    }
+
+    return lambda;
+}
+
+// Sweep the degradation weight to trace the revenue-versus-degradation frontier
+int calculate_cbp_pareto_frontier(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours,
+                                  int num_hours, double min_weight, double max_weight, int num_points,
+                                  ParetoPoint *points, double *plans) {
+    if (num_hours <= 0 || num_points <= 0 || points == NULL) {
+        return 0;
+    }
+
+    double *hour_energy = (double*)calloc(num_hours, sizeof(double));
+    if (hour_energy == NULL) {
+        return 0;
+    }
+
+    min_weight = fmax(min_weight, PLAN_MIN_WEIGHT);
+    max_weight = fmax(max_weight, min_weight);
+    double ratio = (num_points > 1) ? pow(max_weight / min_weight, 1.0 / (num_points - 1)) : 1.0;
+    double weight = min_weight;
+    double lambda = -1.0;
+
+    // Neighbouring weights have nearby solutions, so each solve starts from the previous plan and shadow price
+    for (int k = 0; k < num_points; k++) {
+        lambda = solve_weighted_cbp_plan(strategy, day_ahead_prices, expected_peak_hours, num_hours,
+                                         weight, lambda, hour_energy);
+
+        double revenue = 0.0;
+        double degradation = 0.0;
+        double energy = 0.0;
+        for (int hour = 0; hour < num_hours; hour++) {
+            revenue += _expected_hour_price(day_ahead_prices, expected_peak_hours, hour) * hour_energy[hour];
+            degradation += _hour_degradation(strategy, hour_energy[hour]);
+            energy += hour_energy[hour];
+        }
+
+        points[k].degradation_weight = weight;
+        points[k].expected_revenue = revenue;
+        points[k].degradation_cost = degradation;
+        points[k].total_energy = energy;
+        points[k].energy_price = lambda;
+
+        if (plans != NULL) {
+            memcpy(&plans[k * num_hours], hour_energy, num_hours * sizeof(double));
+        }
+
+        weight *= ratio;
+    }
+
+    free(hour_energy);
+    return num_points;
+}
+
+// Whole SOC grid steps covered by an energy amount, rounded down so the plan never counts on energy it may not get
+static int _energy_to_steps(double energy, double step_energy) {
+    if (energy <= 0.0) {
+        return 0;
+    }
+    double steps = floor(energy / step_energy + 1e-9);
+    return (steps > CBP_SOC_GRID_POINTS - 1) ? CBP_SOC_GRID_POINTS - 1 : (int)steps;
+}
+
+// Backward dynamic program over the SOC grid; fills stage values and the per-stage policy
+// values holds (horizon_hours + 1) * CBP_SOC_GRID_POINTS entries, policy holds horizon_hours * CBP_SOC_GRID_POINTS
+static void _solve_soc_dynamic_program(DemandResponseStrategy *strategy, ChargePlanInputs *inputs, int horizon_hours,
+                                       TerminalSocValue *terminal, double *values, unsigned char *policy) {
+    const int points = CBP_SOC_GRID_POINTS;
+    double step_energy = strategy->battery_capacity * (strategy->config->max_soc - strategy->min_soc) / (points - 1);
+
+    // Degradation of a discharge only depends on how many grid steps it spans
+    double step_degradation[CBP_SOC_GRID_POINTS];
+    for (int k = 0; k < points; k++) {
+        step_degradation[k] = _hour_degradation(strategy, k * step_energy);
+    }
+
+    // Inverter power limits bound how many grid steps one hour can move in either direction
+    int max_discharge_steps = points - 1;
+    int max_charge_steps = points - 1;
+    if (strategy->inverter != NULL) {
+        double hour_discharge = calculate_deliverable_capacity(strategy, 1.0, INFINITY);
+        max_discharge_steps = _energy_to_steps(hour_discharge / strategy->config->discharge_efficiency, step_energy);
+        max_charge_steps = _energy_to_steps(inverter_charge_limit(strategy->inverter) * strategy->config->charge_efficiency,
+                                            step_energy);
+    }
+
+    double *next = &values[horizon_hours * points];
+    for (int s = 0; s < points; s++) {
+        next[s] = (terminal != NULL) ? terminal->value[s] : 0.0;
+    }
+
+    for (int t = horizon_hours - 1; t >= 0; t--) {
+        double *current = &values[t * points];
+        double price = _expected_hour_price(inputs->prices, inputs->peak_hours, t);
+        double delivered_per_step = step_energy * strategy->config->discharge_efficiency;
+        double commitment = (inputs->dr_commitment != NULL) ? inputs->dr_commitment[t] : 0.0;
+
+        int solar_steps = 0;
+        if (inputs->solar_energy != NULL) {
+            solar_steps = _energy_to_steps(inputs->solar_energy[t] * strategy->config->charge_efficiency, step_energy);
+        }
+
+        // Grid charging is only considered when an import tariff is supplied
+        int grid_steps = 0;
+        double grid_step_cost = 0.0;
+        if (inputs->import_prices != NULL) {
+            grid_steps = points - 1;
+            if (inputs->max_grid_charge != NULL) {
+                grid_steps = _energy_to_steps(inputs->max_grid_charge[t] * strategy->config->charge_efficiency, step_energy);
+            }
+            if (grid_steps > max_charge_steps) {
+                grid_steps = max_charge_steps;
+            }
+            grid_step_cost = inputs->import_prices[t] * step_energy / strategy->config->charge_efficiency;
+        }
+
+        for (int s = 0; s < points; s++) {
+            // Free solar charging happens first; the remaining choice is discharge below it or grid charge above it
+            int after_solar = (s + solar_steps > points - 1) ? points - 1 : s + solar_steps;
+            int top = (after_solar + grid_steps > points - 1) ? points - 1 : after_solar + grid_steps;
+
+            double best = -INFINITY;
+            int best_next = after_solar;
+            int bottom = (after_solar > max_discharge_steps) ? after_solar - max_discharge_steps : 0;
+            for (int s2 = top; s2 >= bottom; s2--) {
+                double value;
+                double delivered = 0.0;
+                if (s2 <= after_solar) {
+                    int steps = after_solar - s2;
+                    delivered = steps * delivered_per_step;
+                    value = price * delivered - step_degradation[steps];
+                } else {
+                    value = -(s2 - after_solar) * grid_step_cost;
+                }
+
+                // Undelivered DR commitments are charged at the shortfall penalty
+                if (delivered < commitment) {
+                    value -= inputs->shortfall_penalty * (commitment - delivered);
+                }
+
+                value += next[s2];
+                if (value > best) {
+                    best = value;
+                    best_next = s2;
+                }
+            }
+
+            current[s] = best;
+            policy[t * points + s] = (unsigned char)best_next;
+        }
+
+        next = current;
+    }
+}
+
+// Precompute a terminal SOC value as the optimal earnings of one further representative day
+void calculate_terminal_soc_value(DemandResponseStrategy *strategy, double *day_prices, int *peak_hours,
+                                  double *hour_recharge, int num_hours, TerminalSocValue *terminal) {
+    memset(terminal, 0, sizeof(*terminal));
+    if (num_hours <= 0 || num_hours > CBP_MAX_HORIZON_HOURS) {
+        return;
+    }
+
+    ChargePlanInputs inputs = {0};
+    inputs.prices = day_prices;
+    inputs.peak_hours = peak_hours;
+    inputs.solar_energy = hour_recharge;
+
+    double *values = (double*)malloc((num_hours + 1) * CBP_SOC_GRID_POINTS * sizeof(double));
+    unsigned char *policy = (unsigned char*)malloc(num_hours * CBP_SOC_GRID_POINTS);
+    if (values != NULL && policy != NULL) {
+        _solve_soc_dynamic_program(strategy, &inputs, num_hours, NULL, values, policy);
+        memcpy(terminal->value, values, sizeof(terminal->value));
+    }
+
+    free(values);
+    free(policy);
+}
+
+// Jointly plan solar charging, grid charging and discharge over a horizon starting from the current SOC
+double plan_charge_discharge(DemandResponseStrategy *strategy, ChargePlanInputs *inputs, int horizon_hours,
+                             TerminalSocValue *terminal, double *discharge, double *solar_charge, double *grid_charge) {
+    if (horizon_hours <= 0 || horizon_hours > CBP_MAX_HORIZON_HOURS || inputs->prices == NULL) {
+        return -1.0;
+    }
+
+    const int points = CBP_SOC_GRID_POINTS;
+    double *values = (double*)malloc((horizon_hours + 1) * points * sizeof(double));
+    unsigned char *policy = (unsigned char*)malloc(horizon_hours * points);
+    if (values == NULL || policy == NULL) {
+        free(values);
+        free(policy);
+        return -1.0;
+    }
+
+    _solve_soc_dynamic_program(strategy, inputs, horizon_hours, terminal, values, policy);
+
+    // Snap the current SOC onto the grid and roll the policy forward
+    double step_soc = (strategy->config->max_soc - strategy->min_soc) / (points - 1);
+    double step_energy = strategy->battery_capacity * step_soc;
+    int s = (int)floor((strategy->current_soc - strategy->min_soc) / step_soc + 1e-9);
+    if (s < 0) s = 0;
+    if (s > points - 1) s = points - 1;
+
+    double objective = values[s];
+    for (int t = 0; t < horizon_hours; t++) {
+        int solar_steps = 0;
+        if (inputs->solar_energy != NULL) {
+            solar_steps = _energy_to_steps(inputs->solar_energy[t] * strategy->config->charge_efficiency, step_energy);
+        }
+        int after_solar = (s + solar_steps > points - 1) ? points - 1 : s + solar_steps;
+        int s2 = policy[t * points + s];
+
+        discharge[t] = (s2 < after_solar) ? (after_solar - s2) * step_energy * strategy->config->discharge_efficiency : 0.0;
+        if (solar_charge != NULL) {
+            solar_charge[t] = (after_solar - s) * step_energy / strategy->config->charge_efficiency;
+        }
+        if (grid_charge != NULL) {
+            grid_charge[t] = (s2 > after_solar) ? (s2 - after_solar) * step_energy / strategy->config->charge_efficiency : 0.0;
+        }
+        s = s2;
+    }
+
+    free(values);
+    free(policy);
+    return objective;
+}
+
+// Plan discharge over a rolling horizon starting from the current SOC
+double plan_rolling_horizon(DemandResponseStrategy *strategy, double *prices, int *peak_hours, double *hour_recharge,
+                            int horizon_hours, TerminalSocValue *terminal, double *hour_energy) {
+    ChargePlanInputs inputs = {0};
+    inputs.prices = prices;
+    inputs.peak_hours = peak_hours;
+    inputs.solar_energy = hour_recharge;
+
+    return plan_charge_discharge(strategy, &inputs, horizon_hours, terminal, hour_energy, NULL, NULL);
+}
+
+// Bid the discharge side of a joint charge/discharge plan
+int calculate_joint_cbp_strategy(DemandResponseStrategy *strategy, ChargePlanInputs *inputs, int horizon_hours, int start_hour,
+                                 TerminalSocValue *terminal, int num_bid_hours, double *bid_capacities, double *bid_prices,
+                                 double *grid_charge) {
+    double discharge[CBP_MAX_HORIZON_HOURS];
+    double charge[CBP_MAX_HORIZON_HOURS];
+    if (num_bid_hours > horizon_hours ||
+        plan_charge_discharge(strategy, inputs, horizon_hours, terminal, discharge, NULL, charge) < 0.0) {
+        return -1;
+    }
+
+    for (int hour = 0; hour < num_bid_hours; hour++) {
+        bool is_peak_hour = (inputs->peak_hours != NULL) && inputs->peak_hours[hour];
+
+        // Opportunity cost over the next day of the actual horizon, truncated at its end
+        int forecast_hours = horizon_hours - hour;
+        if (forecast_hours > 24) {
+            forecast_hours = 24;
+        }
+        double opp_cost = calculate_opportunity_cost(strategy, &inputs->prices[hour], forecast_hours);
+
+        bid_capacities[hour] = calculate_creditable_capacity(strategy, (start_hour + hour) % 24, discharge[hour]);
+        bid_prices[hour] = calculate_cbp_bid_price(strategy, (start_hour + hour) % 24, inputs->prices[hour], is_peak_hour,
+                                                   bid_capacities[hour], opp_cost);
+        if (grid_charge != NULL) {
+            grid_charge[hour] = charge[hour];
+        }
+    }
+
+    return 0;
+}
+
+// Rolling-horizon counterpart of calculate_cbp_strategy
+int calculate_rolling_cbp_strategy(DemandResponseStrategy *strategy, double *prices, int *peak_hours, double *hour_recharge,
+                                   int horizon_hours, int start_hour, TerminalSocValue *terminal,
+                                   int num_bid_hours, double *bid_capacities, double *bid_prices) {
+    ChargePlanInputs inputs = {0};
+    inputs.prices = prices;
+    inputs.peak_hours = peak_hours;
+    inputs.solar_energy = hour_recharge;
+
+    return calculate_joint_cbp_strategy(strategy, &inputs, horizon_hours, start_hour, terminal,
+                                        num_bid_hours, bid_capacities, bid_prices, NULL);
+}
@@ -0,0 +1,76 @@
+#ifndef CBP_PLANNER_H
+#define CBP_PLANNER_H
+
+#include "demand_response.h"
+
+#define CBP_SOC_GRID_POINTS 51          // SOC discretization used by horizon planning
+#define CBP_MAX_HORIZON_HOURS 168       // Longest supported rolling horizon (one week)
+
+// One point on the revenue-versus-degradation trade-off curve
+typedef struct {
+    double degradation_weight;      // Weight applied to degradation cost in the objective
+    double expected_revenue;        // Expected day-ahead revenue ($)
+    double degradation_cost;        // Cumulative degradation cost of the plan ($)
+    double total_energy;            // Total energy committed across the day (kWh)
+    double energy_price;            // Shadow price of the SOC window ($/kWh), zero when not binding
+} ParetoPoint;
+
+// Solve the day-ahead plan maximizing expected revenue minus weighted degradation cost
+// hour_energy is both the warm start and the resulting plan (kWh per hour); returns the SOC window shadow price
+// lambda_hint seeds the shadow price search (pass a negative value for a cold start)
+double solve_weighted_cbp_plan(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours,
+                               int num_hours, double degradation_weight, double lambda_hint, double *hour_energy);
+
+// Sweep the degradation weight geometrically from min_weight to max_weight with warm-started solves
+// points receives num_points frontier entries; plans (optional) receives num_points * num_hours hourly energies
+// Returns the number of points written
+int calculate_cbp_pareto_frontier(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours,
+                                  int num_hours, double min_weight, double max_weight, int num_points,
+                                  ParetoPoint *points, double *plans);
+
+// Value of end-of-horizon SOC ($), one entry per SOC grid point from min_soc to max_soc
+typedef struct {
+    double value[CBP_SOC_GRID_POINTS];
+} TerminalSocValue;
+
+// Precompute a terminal SOC value as the optimal earnings of one further representative day
+// hour_recharge (optional) is energy available to recharge each hour (kWh), e.g. forecast solar surplus
+void calculate_terminal_soc_value(DemandResponseStrategy *strategy, double *day_prices, int *peak_hours,
+                                  double *hour_recharge, int num_hours, TerminalSocValue *terminal);
+
+// Hourly inputs to the joint charge/discharge plan; every array covers the planning horizon
+typedef struct {
+    double *prices;                 // DR / capacity revenue per kWh delivered ($/kWh), required
+    int *peak_hours;                // Expected peak flags (optional)
+    double *solar_energy;           // PV energy available for charging (kWh, optional)
+    double *import_prices;          // TOU import price ($/kWh, optional; NULL disables grid charging)
+    double *max_grid_charge;        // Grid energy that may be drawn for charging (kWh, optional; NULL is unlimited)
+    double *dr_commitment;          // Energy already committed for delivery (kWh, optional)
+    double shortfall_penalty;       // Penalty per kWh of undelivered commitment ($/kWh)
+} ChargePlanInputs;
+
+// Jointly plan solar charging, grid charging and discharge over a horizon starting from the current SOC
+// Uses the strategy's separate charge/discharge efficiencies; discharge is energy delivered, charges are energy drawn
+// solar_charge and grid_charge may be NULL; returns the expected net revenue ($) or a negative value on error
+double plan_charge_discharge(DemandResponseStrategy *strategy, ChargePlanInputs *inputs, int horizon_hours,
+                             TerminalSocValue *terminal, double *discharge, double *solar_charge, double *grid_charge);
+
+// Bid the discharge side of a joint charge/discharge plan for the first num_bid_hours
+// grid_charge (optional) receives the planned grid charging for the same hours
+int calculate_joint_cbp_strategy(DemandResponseStrategy *strategy, ChargePlanInputs *inputs, int horizon_hours, int start_hour,
+                                 TerminalSocValue *terminal, int num_bid_hours, double *bid_capacities, double *bid_prices,
+                                 double *grid_charge);
+
+// Plan discharge over a rolling horizon (up to CBP_MAX_HORIZON_HOURS) starting from the current SOC
+// Dynamic program over the SOC grid; each stage only couples to its neighbour, so cost grows linearly with the horizon
+// peak_hours, hour_recharge and terminal may be NULL; returns the expected objective ($) or a negative value on error
+double plan_rolling_horizon(DemandResponseStrategy *strategy, double *prices, int *peak_hours, double *hour_recharge,
+                            int horizon_hours, TerminalSocValue *terminal, double *hour_energy);
+
+// Rolling-horizon counterpart of calculate_cbp_strategy: bids the first num_bid_hours of a multi-day plan
+// Opportunity cost looks forward along the horizon instead of wrapping around the current day
+int calculate_rolling_cbp_strategy(DemandResponseStrategy *strategy, double *prices, int *peak_hours, double *hour_recharge,
+                                   int horizon_hours, int start_hour, TerminalSocValue *terminal,
+                                   int num_bid_hours, double *bid_capacities, double *bid_prices);
+
+#endif // CBP_PLANNER_H
@@ -0,0 +1,251 @@
+#include "degradation_fit.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIT_MAX_ITERATIONS 100          // Levenberg-Marquardt iteration cap
+#define FIT_INITIAL_DAMPING 1e-3
+#define FIT_MAX_DAMPING 1e12            // Damping at which no downhill step is left
+#define FIT_STEP_TOLERANCE 1e-10        // Relative parameter change treated as converged
+#define FIT_COST_TOLERANCE 1e-9         // Relative cost decrease treated as converged
+#define FIT_MAX_K2 20.0                 // Bound on |k2| keeping exp(k2 * δ) finite
+
+// Fit state shared by the model evaluations
+typedef struct {
+    const RainflowResult *cycles;
+    const SohMeasurement *measurements;
+    int num_measurements;
+    int *segment;                   // First measurement each cycle counts towards (num_measurements if none)
+    double *stress;                 // Per measurement: sum of count * δ * exp(k2 * δ) up to it
+    double *stress_slope;           // Per measurement: sum of count * δ² * exp(k2 * δ) up to it
+    double fade_per_life;           // (1 - eol_soh) / cycles_to_eol
+} FitProblem;
+
+// Cumulative stress sums at each measurement for a given k2
+static void _accumulate_stress(FitProblem *problem, double k2) {
+    memset(problem->stress, 0, problem->num_measurements * sizeof(double));
+    memset(problem->stress_slope, 0, problem->num_measurements * sizeof(double));
+
+    for (int64_t i = 0; i < problem->cycles->num_cycles; i++) {
+        int segment = problem->segment[i];
+        if (segment >= problem->num_measurements) {
+            continue;
+        }
+        const RainflowTraceCycle *cycle = &problem->cycles->cycles[i];
+        double weighted = cycle->count * cycle->depth * exp(k2 * cycle->depth);
+        problem->stress[segment] += weighted;
+        problem->stress_slope[segment] += weighted * cycle->depth;
+    }
+
+    for (int j = 1; j < problem->num_measurements; j++) {
+        problem->stress[j] += problem->stress[j - 1];
+        problem->stress_slope[j] += problem->stress_slope[j - 1];
+    }
+}
+
+// Sum of squared residuals for parameters (initial_soh, k1, k2); fills the normal equations when requested
+static double _evaluate(FitProblem *problem, const double *params, double hessian[3][3], double *gradient) {
+    _accumulate_stress(problem, params[2]);
+
+    if (hessian != NULL) {
+        memset(hessian, 0, 9 * sizeof(double));
+        memset(gradient, 0, 3 * sizeof(double));
+    }
+
+    double cost = 0.0;
+    for (int j = 0; j < problem->num_measurements; j++) {
+        double fade = problem->fade_per_life * params[1] * problem->stress[j];
+        double residual = params[0] - fade - problem->measurements[j].soh;
+        cost += residual * residual;
+
+        if (hessian != NULL) {
+            // d(residual) / d(initial_soh, k1, k2)
+            double jacobian[3] = {
+                1.0,
+                -problem->fade_per_life * problem->stress[j],
+                -problem->fade_per_life * params[1] * problem->stress_slope[j]
+            };
+            for (int a = 0; a < 3; a++) {
+                gradient[a] += jacobian[a] * residual;
+                for (int b = 0; b < 3; b++) {
+                    hessian[a][b] += jacobian[a] * jacobian[b];
+                }
+            }
+        }
+    }
+    return cost;
+}
+
+// Solve a 3x3 system by Gaussian elimination with partial pivoting; returns -1 if singular
+static int _solve3(double matrix[3][3], double *rhs, double *solution) {
+    double m[3][4];
+    for (int r = 0; r < 3; r++) {
+        memcpy(m[r], matrix[r], 3 * sizeof(double));
+        m[r][3] = rhs[r];
+    }
+
+    for (int col = 0; col < 3; col++) {
+        int pivot = col;
+        for (int r = col + 1; r < 3; r++) {
+            if (fabs(m[r][col]) > fabs(m[pivot][col])) {
+                pivot = r;
+            }
+        }
+        if (fabs(m[pivot][col]) < 1e-300) {
+            return -1;
+        }
+        if (pivot != col) {
+            double swap[4];
+            memcpy(swap, m[col], sizeof(swap));
+            memcpy(m[col], m[pivot], sizeof(swap));
+            memcpy(m[pivot], swap, sizeof(swap));
+        }
+        for (int r = col + 1; r < 3; r++) {
+            double factor = m[r][col] / m[col][col];
+            for (int c = col; c < 4; c++) {
+                m[r][c] -= factor * m[col][c];
+            }
+        }
+    }
+
+    for (int r = 2; r >= 0; r--) {
+        double value = m[r][3];
+        for (int c = r + 1; c < 3; c++) {
+            value -= m[r][c] * solution[c];
+        }
+        solution[r] = value / m[r][r];
+    }
+    return 0;
+}
+
+// Start a fit from the strategy's current parameters
+void degradation_fit_init(DegradationFit *fit, const DemandResponseStrategy *strategy, double eol_soh) {
+    memset(fit, 0, sizeof(*fit));
+    fit->initial_soh = 1.0;
+    fit->k_delta_e1 = strategy->k_delta_e1;
+    fit->k_delta_e2 = strategy->k_delta_e2;
+    fit->cycles_to_eol = strategy->cycles_to_eol;
+    fit->eol_soh = eol_soh;
+}
+
+// Fit initial SoH, k1 and k2 by Levenberg-Marquardt
+int degradation_fit(DegradationFit *fit, const RainflowResult *cycles, const SohMeasurement *measurements,
+                    int num_measurements) {
+    if (num_measurements < 3 || fit->cycles_to_eol <= 0.0 || fit->eol_soh >= 1.0) {
+        return -1;
+    }
+
+    FitProblem problem;
+    problem.cycles = cycles;
+    problem.measurements = measurements;
+    problem.num_measurements = num_measurements;
+    problem.fade_per_life = (1.0 - fit->eol_soh) / fit->cycles_to_eol;
+    problem.segment = (int*)malloc((cycles->num_cycles > 0 ? cycles->num_cycles : 1) * sizeof(int));
+    problem.stress = (double*)malloc(num_measurements * sizeof(double));
+    problem.stress_slope = (double*)malloc(num_measurements * sizeof(double));
+    if (problem.segment == NULL || problem.stress == NULL || problem.stress_slope == NULL) {
+        free(problem.segment);
+        free(problem.stress);
+        free(problem.stress_slope);
+        return -1;
+    }
+
+    // A cycle counts towards every measurement taken at or after it closed; find the first once up front
+    for (int64_t i = 0; i < cycles->num_cycles; i++) {
+        int lo = 0;
+        int hi = num_measurements;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if ((int64_t)measurements[mid].time < cycles->cycles[i].end) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        problem.segment[i] = lo;
+    }
+
+    double params[3] = {fit->initial_soh, fmax(fit->k_delta_e1, 1e-6), fit->k_delta_e2};
+    double hessian[3][3];
+    double gradient[3];
+    double cost = _evaluate(&problem, params, hessian, gradient);
+    double damping = FIT_INITIAL_DAMPING;
+
+    fit->converged = false;
+    fit->iterations = 0;
+    while (fit->iterations < FIT_MAX_ITERATIONS && !fit->converged) {
+        fit->iterations++;
+
+        // Raise the damping until a step lowers the cost
+        bool accepted = false;
+        while (!accepted && damping < FIT_MAX_DAMPING) {
+            double damped[3][3];
+            double rhs[3];
+            double step[3];
+            memcpy(damped, hessian, sizeof(damped));
+            for (int a = 0; a < 3; a++) {
+                damped[a][a] += damping * fmax(hessian[a][a], 1e-12);
+                rhs[a] = -gradient[a];
+            }
+
+            double trial[3];
+            bool valid = (_solve3(damped, rhs, step) == 0);
+            for (int a = 0; a < 3; a++) {
+                trial[a] = params[a] + step[a];
+            }
+            valid = valid && trial[1] > 0.0 && fabs(trial[2]) <= FIT_MAX_K2;
+
+            double trial_cost = valid ? _evaluate(&problem, trial, NULL, NULL) : INFINITY;
+            if (trial_cost < cost) {
+                double change = 0.0;
+                for (int a = 0; a < 3; a++) {
+                    change = fmax(change, fabs(step[a]) / (fabs(params[a]) + 1e-12));
+                }
+                memcpy(params, trial, sizeof(params));
+                double previous = cost;
+                cost = _evaluate(&problem, params, hessian, gradient);
+                damping = fmax(damping * 0.1, 1e-12);
+                accepted = true;
+                fit->converged = (change < FIT_STEP_TOLERANCE || previous - cost <= FIT_COST_TOLERANCE * previous);
+            } else {
+                damping *= 10.0;
+            }
+        }
+
+        // No downhill direction left: the current point is a (possibly flat) minimum
+        if (!accepted) {
+            fit->converged = true;
+        }
+    }
+
+    fit->initial_soh = params[0];
+    fit->k_delta_e1 = params[1];
+    fit->k_delta_e2 = params[2];
+    fit->rms_error = sqrt(cost / num_measurements);
+
+    free(problem.segment);
+    free(problem.stress);
+    free(problem.stress_slope);
+    return 0;
+}
+
+// Copy fitted parameters into a strategy
+void degradation_fit_apply(const DegradationFit *fit, DemandResponseStrategy *strategy) {
+    strategy->k_delta_e1 = fit->k_delta_e1;
+    strategy->k_delta_e2 = fit->k_delta_e2;
+    strategy->cycles_to_eol = fit->cycles_to_eol;
+}
+
+// Load SoH measurements from CSV
+int degradation_load_measurements(FILE *file, SohMeasurement *measurements, int max_measurements) {
+    int count = 0;
+    long time_value;
+    double soh;
+
+    while (count < max_measurements && fscanf(file, "%ld,%lf", &time_value, &soh) == 2) {
+        measurements[count].time = (time_t)time_value;
+        measurements[count].soh = soh;
+        count++;
+    }
+    return count;
+}
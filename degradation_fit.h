@@ -0,0 +1,48 @@
+#ifndef DEGRADATION_FIT_H
+#define DEGRADATION_FIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "demand_response.h"
+#include "rainflow.h"
+
+// Capacity test or BMS state-of-health reading
+typedef struct {
+    time_t time;
+    double soh;                     // Measured capacity over nameplate (1.0 when new)
+} SohMeasurement;
+
+// Millner parameters fitted to a battery's capacity history
+// SoH(t) = initial_soh - (1 - eol_soh) * sum over cycles closed by t of count * k1 * δ * exp(k2 * δ) / cycles_to_eol
+// Only k1 / cycles_to_eol is identifiable from fade data, so cycles_to_eol is held at its reference value
+typedef struct {
+    double initial_soh;             // Fitted SoH before the first counted cycle
+    double k_delta_e1;              // Fitted Millner coefficient 1
+    double k_delta_e2;              // Fitted Millner coefficient 2
+    double cycles_to_eol;           // Reference cycles to end of life (held fixed)
+    double eol_soh;                 // SoH defining end of life (e.g. 0.8)
+    int iterations;                 // Levenberg-Marquardt iterations taken
+    double rms_error;               // RMS SoH residual at the solution
+    bool converged;
+} DegradationFit;
+
+// Start a fit from the strategy's current parameters
+void degradation_fit_init(DegradationFit *fit, const DemandResponseStrategy *strategy, double eol_soh);
+
+// Fit initial SoH, k1 and k2 by Levenberg-Marquardt with an analytic Jacobian
+// Cycle times are their end indices in seconds since epoch (as recorded by the gateway's SOC history);
+// measurements must be in time order
+// Each iteration is linear in the number of cycles; returns 0 on success, -1 on bad input or allocation failure
+int degradation_fit(DegradationFit *fit, const RainflowResult *cycles, const SohMeasurement *measurements,
+                    int num_measurements);
+
+// Copy fitted parameters into a strategy
+void degradation_fit_apply(const DegradationFit *fit, DemandResponseStrategy *strategy);
+
+// Load SoH measurements from CSV lines of "epoch,soh"; returns the number read
+int degradation_load_measurements(FILE *file, SohMeasurement *measurements, int max_measurements);
+
+#endif // DEGRADATION_FIT_H
@@ -1,40 +1,72 @@
 #include "demand_response.h"
+#include "tariff.h"
+#include "baseline.h"
+#include "load_forecast.h"
+#include "inverter.h"
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
 
 // Initialize the DR strategy with improved parameters
-void DemandResponseStrategy_init(DemandResponseStrategy *strategy, double battery_capacity, double efficiency) {
+int DemandResponseStrategy_init(DemandResponseStrategy *strategy, double battery_capacity, double efficiency) {
+    DemandResponseConfig *config = (DemandResponseConfig*)calloc(1, sizeof(DemandResponseConfig));
+    if (config == NULL) {
+        strategy->config = NULL;
+        return -1;
+    }
+    
+    // Initialize rainflow counting array
+    config->cycle_array_size = 1000;        // Store up to 1000 cycles
+    config->cycles = (RainflowCycle*)malloc(config->cycle_array_size * sizeof(RainflowCycle));
+    if (config->cycles == NULL) {
+        free(config);
+        strategy->config = NULL;
+        return -1;
+    }
+    config->cycle_count_index = 0;
+    strategy->config = config;
+    
     strategy->battery_capacity = battery_capacity;
     strategy->efficiency = efficiency;
-    strategy->min_soc = 0.1;           // 10% minimum SOC
-    strategy->max_soc = 0.9;           // 90% maximum SOC
-    strategy->current_soc = 0.5;       // 50% initial SOC
-    strategy->cycle_count = 0;
+    config->charge_efficiency = sqrt(efficiency); // Split round-trip losses evenly
+    config->discharge_efficiency = sqrt(efficiency);
+    strategy->min_soc = 0.1;                // 10% minimum SOC
+    config->max_soc = 0.9;                  // 90% maximum SOC
+    strategy->current_soc = 0.5;            // 50% initial SOC
+    config->cycle_count = 0.0;
     
     // Battery degradation parameters for LFP chemistry
     // Based on Millner (2010) exponential model: S_delta(δ) = k_delta_e1 * δ * exp(k_delta_e2 * δ)
     // Parameters empirically determined for ExpertPower EP512100 LFP battery system
-    strategy->replacement_cost = 4000.0;  // Replacement cost in $
+    strategy->replacement_cost = 4000.0;    // Replacement cost in $
     
     // LFP-specific exponential model parameters
-    strategy->k_delta_e1 = 0.693;      // Exponential coefficient 1
-    strategy->k_delta_e2 = 3.31;       // Exponential coefficient 2
+    strategy->k_delta_e1 = 0.693;           // Exponential coefficient 1
+    strategy->k_delta_e2 = 3.31;            // Exponential coefficient 2
     
     // Note: LFP batteries have significantly better cycle life than NMC/LMO
     // Manufacturer specs: 5000+ cycles at 95% DoD @ 25°C
-    strategy->cycles_to_eol = 5000;    // Cycles to 80% capacity at reference conditions
-    
-    // Initialize rainflow counting array
-    strategy->cycle_array_size = 1000;  // Store up to 1000 cycles
-    strategy->cycles = (RainflowCycle*)malloc(strategy->cycle_array_size * sizeof(RainflowCycle));
-    strategy->cycle_count_index = 0;
+    strategy->cycles_to_eol = 5000;         // Cycles to 80% capacity at reference conditions
     
     // Market parameters
-    strategy->risk_factor = 0.05;       // 5% risk premium
-    strategy->alpha = 0.3;              // Markup scaling parameter
-    strategy->beta = 0.2;               // Competition factor
-    strategy->max_grid_demand = 50000.0; // Maximum grid demand in kW
+    strategy->risk_factor = 0.05;           // 5% risk premium
+    strategy->alpha = 0.3;                  // Markup scaling parameter
+    strategy->beta = 0.2;                   // Competition factor
+    strategy->max_grid_demand = 50000.0;    // Maximum grid demand in kW
+    strategy->tariff = NULL;                // Built-in day/night rates until a tariff is compiled
+    config->baseline = NULL;                // No baseline until meter history is available
+    strategy->load_forecast = NULL;         // No household load forecast until one is attached
+    strategy->inverter = NULL;              // No power limits until an inverter model is attached
+    return 0;
+}
+
+// Release the cold configuration and cycle history
+void DemandResponseStrategy_free(DemandResponseStrategy *strategy) {
+    if (strategy->config != NULL) {
+        free(strategy->config->cycles);
+        free(strategy->config);
+        strategy->config = NULL;
+    }
 }
 
 // Calculate non-linear degradation cost using rainflow model
@@ -57,30 +89,55 @@ double calculate_degradation_cost(DemandResponseStrategy *strategy, double depth
 
 // Add a new cycle to the rainflow counting array
 void add_rainflow_cycle(DemandResponseStrategy *strategy, double depth, double mean_soc, double temperature) {
-    if (strategy->cycle_count_index >= strategy->cycle_array_size) {
+    if (strategy->config->cycle_count_index >= strategy->config->cycle_array_size) {
         // If array is full, double its size
-        strategy->cycle_array_size *= 2;
-        strategy->cycles = (RainflowCycle*)realloc(strategy->cycles, 
-                                                 strategy->cycle_array_size * sizeof(RainflowCycle));
+        strategy->config->cycle_array_size *= 2;
+        strategy->config->cycles = (RainflowCycle*)realloc(strategy->config->cycles, 
+                                                 strategy->config->cycle_array_size * sizeof(RainflowCycle));
     }
     
     // Add new cycle
-    strategy->cycles[strategy->cycle_count_index].depth = depth;
-    strategy->cycles[strategy->cycle_count_index].mean_soc = mean_soc;
-    strategy->cycles[strategy->cycle_count_index].temperature = temperature;
-    strategy->cycles[strategy->cycle_count_index].timestamp = time(NULL);
+    strategy->config->cycles[strategy->config->cycle_count_index].depth = depth;
+    strategy->config->cycles[strategy->config->cycle_count_index].mean_soc = mean_soc;
+    strategy->config->cycles[strategy->config->cycle_count_index].temperature = temperature;
+    strategy->config->cycles[strategy->config->cycle_count_index].timestamp = time(NULL);
     
-    strategy->cycle_count_index++;
+    strategy->config->cycle_count_index++;
     
     // Update equivalent full cycle count
-    strategy->cycle_count += depth;
+    strategy->config->cycle_count += depth;
 }
 
-// Calculate marginal cost with improved model
-static double _calculate_marginal_cost(DemandResponseStrategy *strategy, double time_of_day, double depth_of_discharge, double opp_cost) {
+// Energy cost of the current time-of-use period
+double get_tou_energy_cost(double time_of_day) {
     // Time-dependent base cost (day/night)
-    double base_cost = (time_of_day >= 6 && time_of_day <= 18) ? 0.29 : 0.10;
+    return (time_of_day >= 6 && time_of_day <= 18) ? 0.29 : 0.10;
+}
+
+// Energy cost at an absolute time, from the compiled tariff when one is attached
+double get_strategy_energy_cost(DemandResponseStrategy *strategy, time_t when) {
+    if (strategy->tariff == NULL) {
+        struct tm local;
+        localtime_r(&when, &local);
+        return get_tou_energy_cost(local.tm_hour);
+    }
     
+    // O(1) lookup into the flat per-interval rate array
+    int interval = tariff_interval_at(strategy->tariff, when);
+    return tariff_import_rate(strategy->tariff, interval);
+}
+
+// Energy cost at a time of day today
+static double _hour_energy_cost(DemandResponseStrategy *strategy, double time_of_day) {
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    time_t day_start = now - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+    return get_strategy_energy_cost(strategy, day_start + (time_t)(time_of_day * 3600));
+}
+
+// Calculate marginal cost with improved model, given the time-dependent energy cost (TOU tariff or day/night)
+static double _calculate_marginal_cost(DemandResponseStrategy *strategy, double base_cost, double depth_of_discharge, double opp_cost) {
     // Calculate degradation cost using non-linear model
     double degradation_cost = calculate_degradation_cost(strategy, depth_of_discharge);
     
@@ -108,6 +165,60 @@ double find_nash_equilibrium_price(DemandResponseStrategy *strategy, double mark
     return equilibrium_price;
 }
 
+// Degradation cost with its derivative with respect to depth of discharge
+double calculate_degradation_cost_grad(DemandResponseStrategy *strategy, double depth_of_discharge, double *d_cost_d_dod) {
+    // Substituting the stress factor into the cost gives a closed form that stays finite at zero depth:
+    // cost(δ) = R / (C * N) * k1 * δ² * exp(k2 * δ)
+    double scale = strategy->replacement_cost * strategy->k_delta_e1 /
+                   (strategy->battery_capacity * strategy->cycles_to_eol);
+    double growth = exp(strategy->k_delta_e2 * depth_of_discharge);
+
+    // d(cost)/dδ = R / (C * N) * k1 * exp(k2 * δ) * (2δ + k2 * δ²)
+    if (d_cost_d_dod != NULL) {
+        *d_cost_d_dod = scale * growth * depth_of_discharge * (2.0 + strategy->k_delta_e2 * depth_of_discharge);
+    }
+
+    return scale * growth * depth_of_discharge * depth_of_discharge;
+}
+
+// Marginal cost with its derivatives with respect to depth of discharge and opportunity cost
+double calculate_marginal_cost_grad(DemandResponseStrategy *strategy, double time_of_day, double depth_of_discharge, double opp_cost,
+                                   double *d_cost_d_dod, double *d_cost_d_opp) {
+    double d_degradation = 0.0;
+    calculate_degradation_cost_grad(strategy, depth_of_discharge, &d_degradation);
+
+    // Base cost and risk premium are constant in both arguments, so only the efficiency scaling remains
+    if (d_cost_d_dod != NULL) {
+        *d_cost_d_dod = d_degradation / strategy->efficiency;
+    }
+    if (d_cost_d_opp != NULL) {
+        *d_cost_d_opp = 1.0 / strategy->efficiency;
+    }
+
+    return _calculate_marginal_cost(strategy, _hour_energy_cost(strategy, time_of_day), depth_of_discharge, opp_cost);
+}
+
+// Nash equilibrium price with its derivatives with respect to market inputs and markup parameters
+double find_nash_equilibrium_price_grad(DemandResponseStrategy *strategy, double market_price, double grid_demand, int num_competitors,
+                                       NashPriceGradient *grad) {
+    double raw_demand_factor = grid_demand / strategy->max_grid_demand;
+    double demand_factor = fmin(raw_demand_factor, 1.5);
+    double competition = num_competitors * strategy->beta + 1;
+    double markup = strategy->alpha * (demand_factor / competition);
+
+    if (grad != NULL) {
+        // Demand factor is clamped at 1.5, beyond which grid demand no longer moves the price
+        double d_demand_factor = (raw_demand_factor < 1.5) ? 1.0 / strategy->max_grid_demand : 0.0;
+
+        grad->d_market_price = 1 + markup;
+        grad->d_grid_demand = market_price * strategy->alpha * d_demand_factor / competition;
+        grad->d_alpha = market_price * demand_factor / competition;
+        grad->d_beta = -market_price * strategy->alpha * demand_factor * num_competitors / (competition * competition);
+    }
+
+    return market_price * (1 + markup);
+}
+
 // Calculate opportunity cost based on future price forecasts
 double calculate_opportunity_cost(DemandResponseStrategy *strategy, double *price_forecast, int forecast_hours) {
     if (price_forecast == NULL || forecast_hours <= 0) {
@@ -117,13 +228,15 @@ double calculate_opportunity_cost(DemandResponseStrategy *strategy, double *pric
     // Find maximum expected value of future prices
     double max_expected_value = 0.0;
     double discount_factor = 0.9; // Time value discount factor
+    double discount = 1.0;
     
     for (int i = 0; i < forecast_hours; i++) {
         // Apply time discount to future prices (further hours are less certain)
-        double expected_value = price_forecast[i] * pow(discount_factor, i);
+        double expected_value = price_forecast[i] * discount;
         if (expected_value > max_expected_value) {
             max_expected_value = expected_value;
         }
+        discount *= discount_factor;
     }
     
     return max_expected_value * 0.5; // 50% of max future value as opportunity cost
@@ -131,13 +244,27 @@ double calculate_opportunity_cost(DemandResponseStrategy *strategy, double *pric
 
 // Calculate Fast DR Dispatch bid with improved model
 void calculate_fast_dr_bid(DemandResponseStrategy *strategy, double market_price, double grid_demand, double time_window, 
-                          double *bid_capacity, double *bid_price) {
+                          time_t now, double *bid_capacity, double *bid_price) {
     // Calculate available capacity
     double available_capacity = (strategy->current_soc - strategy->min_soc) * strategy->battery_capacity;
     
     // Estimate depth of discharge if we were to use all available capacity
     double depth_of_discharge = available_capacity / strategy->battery_capacity;
     
+    // Behind the meter, household load during the window is served from the battery before anything is exported
+    double household_load = 0.0;
+    if (strategy->load_forecast != NULL) {
+        household_load = load_forecast_energy(strategy->load_forecast, now, time_window, 
+                                              LOAD_FORECAST_DEFAULT_Z);
+        available_capacity = fmax(available_capacity - household_load, 0.0);
+    }
+    
+    // The inverter carries household load and export alike, ramping from whatever it is already delivering
+    if (strategy->inverter != NULL) {
+        double inverter_energy = inverter_window_energy(strategy->inverter, strategy->inverter->setpoint_kw, time_window);
+        available_capacity = fmin(available_capacity, fmax(inverter_energy - household_load, 0.0));
+    }
+    
     // For simplicity, using a dummy price forecast array here
     double price_forecast[24] = {0};
     for (int i = 0; i < 24; i++) {
@@ -147,15 +274,8 @@ void calculate_fast_dr_bid(DemandResponseStrategy *strategy, double market_price
     // Calculate opportunity cost
     double opp_cost = calculate_opportunity_cost(strategy, price_forecast, 24);
     
-    // Calculate time of day (hour)
-    time_t raw_time;
-    struct tm *time_info;
-    time(&raw_time);
-    time_info = localtime(&raw_time);
-    double hour_of_day = time_info->tm_hour;
-    
-    // Calculate marginal cost
-    double marginal_cost = _calculate_marginal_cost(strategy, hour_of_day, depth_of_discharge, opp_cost);
+    // Calculate marginal cost at the energy cost in force now
+    double marginal_cost = _calculate_marginal_cost(strategy, get_strategy_energy_cost(strategy, now), depth_of_discharge, opp_cost);
     
     // Calculate Nash equilibrium price (assuming 10 competitors)
     double nash_price = find_nash_equilibrium_price(strategy, market_price, grid_demand, 10);
@@ -206,7 +326,7 @@ void calculate_cbp_strategy(DemandResponseStrategy *strategy, double *day_ahead_
     calculate_capacity_allocation(strategy, day_ahead_prices, expected_peak_hours, num_hours, capacity_factors);
     
     // Available energy
-    double available_energy = strategy->battery_capacity * (strategy->max_soc - strategy->min_soc);
+    double available_energy = strategy->battery_capacity * (strategy->config->max_soc - strategy->min_soc);
     
     // Calculate bids for each hour
     for (int hour = 0; hour < num_hours; hour++) {
@@ -221,25 +341,58 @@ void calculate_cbp_strategy(DemandResponseStrategy *strategy, double *day_ahead_
         // Calculate opportunity cost
         double opp_cost = calculate_opportunity_cost(strategy, price_forecast, 24);
         
-        // Estimate depth of discharge for this hour
-        double hour_capacity = available_energy * capacity_factors[hour];
-        double depth_of_discharge = hour_capacity / strategy->battery_capacity;
-        
-        // Calculate marginal cost
-        double base_cost = _calculate_marginal_cost(strategy, hour, depth_of_discharge, opp_cost);
+        // Allocate capacity for this hour, limited to what the inverter can deliver and the baseline will credit
+        double hour_capacity = calculate_deliverable_capacity(strategy, 1.0, available_energy * capacity_factors[hour]);
+        hour_capacity = calculate_creditable_capacity(strategy, hour, hour_capacity);
         
         // Set bid capacity
         bid_capacities[hour] = hour_capacity;
         
-        // Calculate bid price (peak hours get higher markup)
-        double markup = is_peak_hour ? 0.15 : 0.05;
-        double cost_markup = is_peak_hour ? 0.2 : 0.1;
-        
         // Set bid price
-        bid_prices[hour] = fmax(day_ahead_prices[hour] * (1 + markup), base_cost * (1 + cost_markup));
+        bid_prices[hour] = calculate_cbp_bid_price(strategy, hour, day_ahead_prices[hour], is_peak_hour, 
+                                                   hour_capacity, opp_cost);
     }
 }
 
+// Cap a CBP hour's capacity at the load reduction the utility baseline can credit
+double calculate_creditable_capacity(DemandResponseStrategy *strategy, int hour_of_day, double hour_capacity) {
+    // Until the eligible-day window is full the baseline is unknown, so bids are left uncapped
+    if (strategy->config->baseline == NULL || !baseline_ready(strategy->config->baseline)) {
+        return hour_capacity;
+    }
+    
+    // Behind-the-meter discharge only reduces metered load down to zero; exports earn no CBP credit
+    double hourly_baseline[24];
+    baseline_hourly_profile(strategy->config->baseline, hourly_baseline);
+    return fmin(hour_capacity, hourly_baseline[hour_of_day % 24]);
+}
+
+// Cap energy committed over a future window at what the inverter can deliver
+double calculate_deliverable_capacity(DemandResponseStrategy *strategy, double window_hours, double capacity) {
+    if (strategy->inverter == NULL) {
+        return capacity;
+    }
+    
+    // Future windows start from rest, so each one pays for its own ramp
+    return fmin(capacity, inverter_window_energy(strategy->inverter, 0.0, window_hours));
+}
+
+// Price a single CBP hour given its committed capacity and opportunity cost
+double calculate_cbp_bid_price(DemandResponseStrategy *strategy, int hour_of_day, double day_ahead_price, bool is_peak_hour, 
+                               double hour_capacity, double opp_cost) {
+    // Estimate depth of discharge for this hour
+    double depth_of_discharge = hour_capacity / strategy->battery_capacity;
+    
+    // Calculate marginal cost
+    double base_cost = _calculate_marginal_cost(strategy, _hour_energy_cost(strategy, hour_of_day), depth_of_discharge, opp_cost);
+    
+    // Calculate bid price (peak hours get higher markup)
+    double markup = is_peak_hour ? 0.15 : 0.05;
+    double cost_markup = is_peak_hour ? 0.2 : 0.1;
+    
+    return fmax(day_ahead_price * (1 + markup), base_cost * (1 + cost_markup));
+}
+
 // Update state of charge and track battery degradation
 void update_state_of_charge(DemandResponseStrategy *strategy, double energy_delivered_kwh) {
     // Previous SOC
@@ -249,7 +402,7 @@ void update_state_of_charge(DemandResponseStrategy *strategy, double energy_deli
     strategy->current_soc -= energy_delivered_kwh / strategy->battery_capacity;
     
     // Ensure SOC stays within bounds
-    strategy->current_soc = fmax(strategy->min_soc, fmin(strategy->max_soc, strategy->current_soc));
+    strategy->current_soc = fmax(strategy->min_soc, fmin(strategy->config->max_soc, strategy->current_soc));
     
     // Calculate depth of discharge
     double depth = fabs(prev_soc - strategy->current_soc);
@@ -3,17 +3,52 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 // Forward declaration for rainflow data structure
 typedef struct RainflowCycle RainflowCycle;
 
+// Forward declaration for compiled utility tariff (tariff.h)
+typedef struct CompiledTariff CompiledTariff;
+
+// Forward declaration for customer baseline (baseline.h)
+typedef struct CustomerBaseline CustomerBaseline;
+
+// Forward declaration for household load forecaster (load_forecast.h)
+typedef struct LoadForecaster LoadForecaster;
+
+// Forward declaration for inverter capability model (inverter.h)
+typedef struct InverterCapability InverterCapability;
+
+#define DR_CACHE_LINE_SIZE 64        // Alignment of the hot strategy core
+
+// Configuration and history read only when planning or recording cycles, allocated apart from the hot core
+typedef struct DemandResponseConfig {
+    double max_soc;                 // Maximum state of charge (0.0 to 1.0)
+    double charge_efficiency;       // One-way charge efficiency (0.0 to 1.0)
+    double discharge_efficiency;    // One-way discharge efficiency (0.0 to 1.0)
+    double cycle_count;             // Number of equivalent full cycles
+    
+    // Rainflow counting for degradation
+    RainflowCycle* cycles;          // Array of rainflow cycles
+    int cycle_array_size;           // Size of rainflow cycles array
+    int cycle_count_index;          // Current index in cycle array
+    
+    const CustomerBaseline *baseline; // Utility baseline the CBP is settled against (NULL disables capping)
+} DemandResponseConfig;
+
+// Hot core read on every tick and every fast DR bid, allocated apart from the cold configuration
+// Exactly two cache lines: everything calculate_fast_dr_bid reads, then the config pointer, so pricing a fleet never
+// follows config. Arrays of strategies need DR_CACHE_LINE_SIZE-aligned storage (e.g. aligned_alloc)
 typedef struct {
+    _Alignas(DR_CACHE_LINE_SIZE) double current_soc; // Current state of charge (0.0 to 1.0)
+    double min_soc;                 // Minimum state of charge (0.0 to 1.0)
     double battery_capacity;        // Battery capacity in kWh
     double efficiency;              // Battery round-trip efficiency (0.0 to 1.0)
-    double min_soc;                 // Minimum state of charge (0.0 to 1.0)
-    double max_soc;                 // Maximum state of charge (0.0 to 1.0)
-    double current_soc;             // Current state of charge (0.0 to 1.0)
-    uint32_t cycle_count;           // Number of equivalent full cycles
+    double alpha;                   // Scaling parameter for markup function
+    double beta;                    // Competition factor for markup function
+    double risk_factor;             // Risk premium for uncertainty
+    double max_grid_demand;         // Maximum historical grid demand
     
     // Battery degradation parameters
     double replacement_cost;        // Cost of battery replacement ($)
@@ -22,18 +57,14 @@ typedef struct {
     double cycles_to_eol;          // Number of cycles to end-of-life at reference conditions
     // Note: Using Millner (2010) exponential model for LFP batteries
     
-    // Rainflow counting for degradation
-    RainflowCycle* cycles;          // Array of rainflow cycles
-    int cycle_array_size;           // Size of rainflow cycles array
-    int cycle_count_index;          // Current index in cycle array
-    
-    // Market parameters
-    double risk_factor;             // Risk premium for uncertainty
-    double alpha;                   // Scaling parameter for markup function
-    double beta;                    // Competition factor for markup function
-    double max_grid_demand;         // Maximum historical grid demand
+    const CompiledTariff *tariff;   // Compiled utility rates (NULL uses built-in day/night rates)
+    const LoadForecaster *load_forecast; // Household load served before export (NULL assumes none)
+    const InverterCapability *inverter; // Power, ramp and temperature limits (NULL leaves bids energy-limited)
+    DemandResponseConfig *config;   // Cold configuration and history
 } DemandResponseStrategy;
 
+_Static_assert(sizeof(DemandResponseStrategy) == 2 * DR_CACHE_LINE_SIZE, "hot core fits two cache lines");
+
 // Rainflow cycle structure for battery degradation tracking
 typedef struct RainflowCycle {
     double depth;                   // Depth of discharge (0.0 to 1.0)
@@ -42,17 +73,37 @@ typedef struct RainflowCycle {
     time_t timestamp;               // When the cycle occurred
 } RainflowCycle;
 
-// Initialize the DR strategy
-void DemandResponseStrategy_init(DemandResponseStrategy *strategy, double battery_capacity, double efficiency);
+// Initialize the DR strategy; allocates its cold configuration and cycle history
+// Returns 0, or -1 if either allocation fails (nothing is left allocated and config is NULL)
+int DemandResponseStrategy_init(DemandResponseStrategy *strategy, double battery_capacity, double efficiency);
 
-// Calculate Fast DR Dispatch bid
+// Release the cold configuration and cycle history
+void DemandResponseStrategy_free(DemandResponseStrategy *strategy);
+
+// Energy cost of the current time-of-use period ($/kWh)
+double get_tou_energy_cost(double time_of_day);
+
+// Energy cost at an absolute time, from the strategy's compiled tariff when one is attached ($/kWh)
+double get_strategy_energy_cost(DemandResponseStrategy *strategy, time_t when);
+
+// Calculate Fast DR Dispatch bid for a window starting at now
 void calculate_fast_dr_bid(DemandResponseStrategy *strategy, double market_price, double grid_demand, double time_window, 
-                          double *bid_capacity, double *bid_price);
+                          time_t now, double *bid_capacity, double *bid_price);
 
 // Calculate Capacity Bidding Program strategy
 void calculate_cbp_strategy(DemandResponseStrategy *strategy, double *day_ahead_prices, int *expected_peak_hours, 
                            int num_hours, double *bid_capacities, double *bid_prices);
 
+// Cap a CBP hour's capacity at the load reduction the utility baseline can credit (kWh)
+double calculate_creditable_capacity(DemandResponseStrategy *strategy, int hour_of_day, double hour_capacity);
+
+// Cap energy committed over a future window at what the inverter can deliver ramping from rest (kWh)
+double calculate_deliverable_capacity(DemandResponseStrategy *strategy, double window_hours, double capacity);
+
+// Price a single CBP hour given its committed capacity (kWh) and opportunity cost
+double calculate_cbp_bid_price(DemandResponseStrategy *strategy, int hour_of_day, double day_ahead_price, bool is_peak_hour, 
+                               double hour_capacity, double opp_cost);
+
 // Update state of charge and track battery degradation
 void update_state_of_charge(DemandResponseStrategy *strategy, double energy_delivered_kwh);
 
@@ -72,4 +123,20 @@ void calculate_capacity_allocation(DemandResponseStrategy *strategy, double *day
 // Nash equilibrium calculation with competition factors
 double find_nash_equilibrium_price(DemandResponseStrategy *strategy, double market_price, double grid_demand, int num_competitors);
 
+// Partial derivatives of the Nash equilibrium price
+typedef struct {
+    double d_market_price;          // d(price) / d(market_price)
+    double d_grid_demand;           // d(price) / d(grid_demand), zero once demand factor saturates
+    double d_alpha;                 // d(price) / d(alpha)
+    double d_beta;                  // d(price) / d(beta)
+} NashPriceGradient;
+
+// Analytic gradients of the bid cost model, for SQP/MPC solvers that would otherwise finite-difference
+// Each returns the same value as its plain counterpart and writes the derivatives through the out-pointers (may be NULL)
+double calculate_degradation_cost_grad(DemandResponseStrategy *strategy, double depth_of_discharge, double *d_cost_d_dod);
+double calculate_marginal_cost_grad(DemandResponseStrategy *strategy, double time_of_day, double depth_of_discharge, double opp_cost,
+                                   double *d_cost_d_dod, double *d_cost_d_opp);
+double find_nash_equilibrium_price_grad(DemandResponseStrategy *strategy, double market_price, double grid_demand, int num_competitors,
+                                       NashPriceGradient *grad);
+
 #endif // DEMAND_RESPONSE_H
@@ -0,0 +1,350 @@
+#include "event_loop.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+// An HTTP transfer in progress
+typedef struct HttpTransfer {
+    CURL *easy;
+    HttpDoneHandler done;
+    void *context;
+    struct HttpTransfer *next;
+} HttpTransfer;
+
+static HttpTransfer *_transfers = NULL; // Transfers of every loop, so event_loop_free can abort them
+
+static uint64_t _now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static EventSource *_find_source(EventLoop *loop, int fd) {
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (loop->sources[i].fd == fd) {
+            return &loop->sources[i];
+        }
+    }
+    return NULL;
+}
+
+static int _add_source(EventLoop *loop, int fd, uint32_t events, bool is_timer, EventHandler handler, void *context) {
+    EventSource *source = _find_source(loop, -1);
+    if (source == NULL) {
+        return -1;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = source;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return -1;
+    }
+
+    source->fd = fd;
+    source->is_timer = is_timer;
+    source->handler = handler;
+    source->context = context;
+    return 0;
+}
+
+// Arm a timerfd; a zero first expiry is moved to 1 ns because zero disarms
+static int _arm_timer(int timer_fd, uint64_t first_ns, uint64_t period_ns) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (first_ns == 0) {
+        first_ns = 1;
+    }
+    spec.it_value.tv_sec = first_ns / 1000000000u;
+    spec.it_value.tv_nsec = first_ns % 1000000000u;
+    spec.it_interval.tv_sec = period_ns / 1000000000u;
+    spec.it_interval.tv_nsec = period_ns % 1000000000u;
+    return timerfd_settime(timer_fd, 0, &spec, NULL);
+}
+
+// Hand finished transfers to their completion handlers
+static void _finish_transfers(EventLoop *loop) {
+    CURLMsg *message;
+    int pending;
+
+    while ((message = curl_multi_info_read(loop->multi, &pending)) != NULL) {
+        if (message->msg != CURLMSG_DONE) {
+            continue;
+        }
+        CURL *easy = message->easy_handle;
+        CURLcode result = message->data.result;
+        curl_multi_remove_handle(loop->multi, easy);
+
+        HttpTransfer **link = &_transfers;
+        while (*link != NULL && (*link)->easy != easy) {
+            link = &(*link)->next;
+        }
+        HttpTransfer *transfer = *link;
+        if (transfer != NULL) {
+            *link = transfer->next;
+            if (transfer->done != NULL) {
+                transfer->done(easy, result, transfer->context);
+            }
+            free(transfer);
+        }
+        curl_easy_cleanup(easy);
+    }
+}
+
+static void _curl_socket_ready(int fd, uint32_t events, void *context) {
+    EventLoop *loop = (EventLoop*)context;
+    int flags = 0;
+    if (events & EPOLLIN) {
+        flags |= CURL_CSELECT_IN;
+    }
+    if (events & EPOLLOUT) {
+        flags |= CURL_CSELECT_OUT;
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        flags |= CURL_CSELECT_ERR;
+    }
+    curl_multi_socket_action(loop->multi, fd, flags, &loop->transfers);
+    _finish_transfers(loop);
+}
+
+static void _curl_timeout(int fd, uint32_t events, void *context) {
+    EventLoop *loop = (EventLoop*)context;
+    curl_multi_socket_action(loop->multi, CURL_SOCKET_TIMEOUT, 0, &loop->transfers);
+    _finish_transfers(loop);
+}
+
+// curl asks to watch, re-watch or forget one of its sockets
+static int _curl_socket(CURL *easy, curl_socket_t fd, int what, void *userp, void *socketp) {
+    EventLoop *loop = (EventLoop*)userp;
+
+    if (what == CURL_POLL_REMOVE) {
+        event_loop_remove_fd(loop, fd);
+        return 0;
+    }
+
+    uint32_t events = 0;
+    if (what & CURL_POLL_IN) {
+        events |= EPOLLIN;
+    }
+    if (what & CURL_POLL_OUT) {
+        events |= EPOLLOUT;
+    }
+    if (_find_source(loop, fd) != NULL) {
+        return event_loop_modify_fd(loop, fd, events);
+    }
+    return event_loop_add_fd(loop, fd, events, _curl_socket_ready, loop);
+}
+
+// curl asks to be called back after timeout_ms (-1 cancels)
+static int _curl_timer(CURLM *multi, long timeout_ms, void *userp) {
+    EventLoop *loop = (EventLoop*)userp;
+    if (timeout_ms < 0) {
+        struct itimerspec disarm;
+        memset(&disarm, 0, sizeof(disarm));
+        return timerfd_settime(loop->curl_timer_fd, 0, &disarm, NULL);
+    }
+    return _arm_timer(loop->curl_timer_fd, (uint64_t)timeout_ms * 1000000u, 0);
+}
+
+// Create the epoll instance and curl multi handle
+int event_loop_init(EventLoop *loop) {
+    memset(loop, 0, sizeof(*loop));
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        loop->sources[i].fd = -1;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->curl_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->multi = curl_multi_init();
+    if (loop->epoll_fd < 0 || loop->curl_timer_fd < 0 || loop->multi == NULL ||
+        _add_source(loop, loop->curl_timer_fd, EPOLLIN, true, _curl_timeout, loop) != 0) {
+        event_loop_free(loop);
+        return -1;
+    }
+
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETFUNCTION, _curl_socket);
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETDATA, loop);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERFUNCTION, _curl_timer);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERDATA, loop);
+    return 0;
+}
+
+// Close every watched descriptor and abort transfers in progress
+void event_loop_free(EventLoop *loop) {
+    if (loop->multi != NULL) {
+        HttpTransfer **link = &_transfers;
+        while (*link != NULL) {
+            HttpTransfer *transfer = *link;
+            if (curl_multi_remove_handle(loop->multi, transfer->easy) == CURLM_OK) {
+                *link = transfer->next;
+                curl_easy_cleanup(transfer->easy);
+                free(transfer);
+            } else {
+                link = &transfer->next;
+            }
+        }
+        curl_multi_cleanup(loop->multi);
+        loop->multi = NULL;
+    }
+
+    // curl has closed its own sockets; timers are ours
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (loop->sources[i].fd >= 0 && loop->sources[i].is_timer) {
+            close(loop->sources[i].fd);
+        }
+        loop->sources[i].fd = -1;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    loop->epoll_fd = -1;
+    loop->curl_timer_fd = -1;
+}
+
+int event_loop_add_fd(EventLoop *loop, int fd, uint32_t events, EventHandler handler, void *context) {
+    return _add_source(loop, fd, events, false, handler, context);
+}
+
+int event_loop_modify_fd(EventLoop *loop, int fd, uint32_t events) {
+    EventSource *source = _find_source(loop, fd);
+    if (source == NULL) {
+        return -1;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = source;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void event_loop_remove_fd(EventLoop *loop, int fd) {
+    EventSource *source = _find_source(loop, fd);
+    if (source != NULL) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        source->fd = -1;
+    }
+}
+
+// Run handler after first_ms and then every period_ms
+int event_loop_add_timer(EventLoop *loop, uint32_t first_ms, uint32_t period_ms, EventHandler handler, void *context) {
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        return -1;
+    }
+    if (_arm_timer(timer_fd, (uint64_t)first_ms * 1000000u, (uint64_t)period_ms * 1000000u) != 0 ||
+        _add_source(loop, timer_fd, EPOLLIN, true, handler, context) != 0) {
+        close(timer_fd);
+        return -1;
+    }
+    return timer_fd;
+}
+
+// Run handler on a shared wake grid
+int event_loop_add_aligned_timer(EventLoop *loop, uint32_t period_ms, uint32_t align_ms, EventHandler handler,
+                                 void *context) {
+    if (align_ms == 0) {
+        return event_loop_add_timer(loop, 0, period_ms, handler, context);
+    }
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        return -1;
+    }
+
+    // First expiry at the next grid point; the period is a whole number of grid steps for the timers to stay together
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t align_ns = (uint64_t)align_ms * 1000000u;
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    uint64_t first_ns = (now_ns / align_ns + 1) * align_ns;
+    uint64_t period_ns = ((uint64_t)period_ms * 1000000u + align_ns - 1) / align_ns * align_ns;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = first_ns / 1000000000u;
+    spec.it_value.tv_nsec = first_ns % 1000000000u;
+    spec.it_interval.tv_sec = period_ns / 1000000000u;
+    spec.it_interval.tv_nsec = period_ns % 1000000000u;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0 ||
+        _add_source(loop, timer_fd, EPOLLIN, true, handler, context) != 0) {
+        close(timer_fd);
+        return -1;
+    }
+    return timer_fd;
+}
+
+void event_loop_remove_timer(EventLoop *loop, int timer_fd) {
+    event_loop_remove_fd(loop, timer_fd);
+    close(timer_fd);
+}
+
+// Start a configured easy handle without blocking
+int event_loop_start_http(EventLoop *loop, CURL *easy, HttpDoneHandler done, void *context) {
+    HttpTransfer *transfer = (HttpTransfer*)malloc(sizeof(HttpTransfer));
+    if (transfer == NULL) {
+        return -1;
+    }
+    transfer->easy = easy;
+    transfer->done = done;
+    transfer->context = context;
+
+    // Adding the handle asks for an immediate timeout, which starts the transfer from the loop
+    if (curl_multi_add_handle(loop->multi, easy) != CURLM_OK) {
+        free(transfer);
+        return -1;
+    }
+    transfer->next = _transfers;
+    _transfers = transfer;
+    return 0;
+}
+
+// Dispatch events until event_loop_stop
+int event_loop_run(EventLoop *loop) {
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+    loop->running = true;
+    while (loop->running) {
+        if (loop->idle != NULL) {
+            idle_stats_sleep_begin(loop->idle, _now_us());
+        }
+        int ready = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, -1);
+        if (loop->idle != NULL) {
+            idle_stats_sleep_end(loop->idle, _now_us());
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        loop->wakeups++;
+
+        for (int i = 0; i < ready && loop->running; i++) {
+            EventSource *source = (EventSource*)events[i].data.ptr;
+
+            // An earlier handler in this batch may have removed the source
+            if (source->fd < 0) {
+                continue;
+            }
+            if (source->is_timer) {
+                uint64_t expirations;
+                if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+            }
+            source->handler(source->fd, events[i].events, source->context);
+            loop->dispatched++;
+        }
+    }
+    return 0;
+}
+
+void event_loop_stop(EventLoop *loop) {
+    loop->running = false;
+}
@@ -0,0 +1,79 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <curl/curl.h>
+
+#include "idle_stats.h"
+
+#define EVENT_LOOP_MAX_SOURCES 64       // Descriptors watched at once (timers, sockets, IPC)
+#define EVENT_LOOP_MAX_EVENTS 16        // Events taken per epoll_wait
+
+// Called when a watched descriptor is ready; for timers, after the expirations have been read
+typedef void (*EventHandler)(int fd, uint32_t events, void *context);
+
+// Called when an HTTP transfer finishes; the loop cleans up the easy handle afterwards
+typedef void (*HttpDoneHandler)(CURL *easy, CURLcode result, void *context);
+
+// A watched descriptor
+typedef struct {
+    int fd;                         // -1 when the slot is free
+    bool is_timer;                  // timerfd whose expiration count is drained before the handler runs
+    EventHandler handler;
+    void *context;
+} EventSource;
+
+// Single-threaded epoll reactor with timerfd schedules and curl multi transfers
+// Every handler runs on the loop's thread, so handlers share state without locks; a handler must not block
+typedef struct {
+    int epoll_fd;
+    bool running;
+    EventSource sources[EVENT_LOOP_MAX_SOURCES];
+
+    CURLM *multi;                   // All HTTP transfers
+    int curl_timer_fd;              // One-shot timer requested by curl
+    int transfers;                  // Transfers in progress
+
+    uint64_t wakeups;               // Returns from epoll_wait
+    uint64_t dispatched;            // Handler calls
+    IdleStats *idle;                // Time blocked in epoll_wait is recorded here when set
+} EventLoop;
+
+// Create the epoll instance and curl multi handle; returns 0 on success, -1 on failure
+int event_loop_init(EventLoop *loop);
+
+// Close every watched descriptor and abort transfers in progress
+void event_loop_free(EventLoop *loop);
+
+// Watch a descriptor for EPOLLIN / EPOLLOUT; returns 0 on success, -1 on failure or a full table
+int event_loop_add_fd(EventLoop *loop, int fd, uint32_t events, EventHandler handler, void *context);
+
+// Change the events a watched descriptor waits for
+int event_loop_modify_fd(EventLoop *loop, int fd, uint32_t events);
+
+// Stop watching a descriptor (does not close it)
+void event_loop_remove_fd(EventLoop *loop, int fd);
+
+// Run handler after first_ms and then every period_ms (0 for one shot); returns the timerfd or -1
+int event_loop_add_timer(EventLoop *loop, uint32_t first_ms, uint32_t period_ms, EventHandler handler, void *context);
+
+// Run handler every period_ms at multiples of align_ms on the monotonic clock, so timers sharing a grid expire
+// together and cost one wakeup; returns the timerfd or -1
+int event_loop_add_aligned_timer(EventLoop *loop, uint32_t period_ms, uint32_t align_ms, EventHandler handler,
+                                 void *context);
+
+// Stop and close a timer
+void event_loop_remove_timer(EventLoop *loop, int timer_fd);
+
+// Start a configured easy handle without blocking; done runs on completion or failure
+// Returns 0 if the transfer was started; otherwise the handle is left to the caller
+int event_loop_start_http(EventLoop *loop, CURL *easy, HttpDoneHandler done, void *context);
+
+// Dispatch events until event_loop_stop; returns 0, or -1 if epoll fails
+int event_loop_run(EventLoop *loop);
+
+// Return from event_loop_run after the current handler
+void event_loop_stop(EventLoop *loop);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,302 @@
+// Linux runtime: one epoll loop drives the gateway jobs in place of the RTOS tasks
+//
+// Build from the repository root with the same modules as the RTOS image, minus FreeRTOS:
+//   gcc -O2 -DGATEWAY_LINUX_RUNTIME gateway_linux.c event_loop.c sunlight_lut.c demand_response.c cbp_planner.c tariff.c baseline.c settlement.c load_forecast.c pv_forecast.c inverter.c soc_trace.c rt_schedule.c spsc_queue.c idle_stats.c mem_stats.c trace.c metrics.c -lmodbus -lcurl -lm
+//
+// Each task table job runs from its own timerfd, HTTP requests go through curl multi on the same loop, and the VEN
+// can wake fast DR dispatch through a datagram socket instead of waiting for the next 0x220 poll. libmodbus has no
+// non-blocking RTU transactions, so Modbus reads and writes stay inline, bounded by MODBUS_RESPONSE_TIMEOUT_MS.
+
+#include "sunlight_lut.h"
+#include "event_loop.h"
+#include <curl/curl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// The gateway's only event loop
+EventLoop gatewayLoop;
+
+// A market data response being collected
+typedef struct {
+    char *data;
+    size_t length;
+    void (*done)(void);
+    TraceRing *trace;               // Timeline of the job that asked, which the continuation runs on
+    int32_t trace_id;
+    uint64_t start_us;
+} MarketDataFetch;
+
+// A bid POST in flight, for its trace span and latency
+typedef struct {
+    TraceRing *trace;
+    int32_t trace_id;
+    uint64_t start_us;
+} BidPost;
+
+// Heap in use from glibc: arena allocations plus large mmap'd blocks
+size_t heapInUse(void) {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Run one task table job with deadline and heap monitoring, then post any bids it queued
+void runJob(GatewayTaskId id) {
+    runGatewayJob(id);
+
+    if (id != TASK_BID_SUBMISSION) {
+        runJob(TASK_BID_SUBMISSION);
+    }
+}
+
+static void _onTaskTimer(int fd, uint32_t events, void *context) {
+    runJob((GatewayTaskId)(intptr_t)context);
+}
+
+// A VEN datagram means the DR status may have changed; dispatch now rather than at the next tick
+static void _onVenMessage(int fd, uint32_t events, void *context) {
+    char message[128];
+    ssize_t length;
+    bool received = false;
+
+    while ((length = recv(fd, message, sizeof(message) - 1, MSG_DONTWAIT)) >= 0) {
+        message[length] = '\0';
+        printf("VEN: %s\n", message);
+        received = true;
+    }
+    if (received) {
+        runJob(TASK_FAST_DR_DISPATCH);
+    }
+}
+
+// SIGUSR1 dumps the task timelines; anything else stops the loop
+static void _onSignal(int fd, uint32_t events, void *context) {
+    struct signalfd_siginfo info;
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGUSR1) {
+            writeGatewayTrace();
+        } else {
+            event_loop_stop(&gatewayLoop);
+        }
+    }
+}
+
+static void _onBidPosted(CURL *easy, CURLcode result, void *context) {
+    BidPost *post = (BidPost*)context;
+    if (post != NULL) {
+        long status = 0;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+        recordBidPost(result == CURLE_OK, status, rt_now_us() - post->start_us);
+        trace_async_end(post->trace, TRACE_HTTP, "POST bid", post->trace_id);
+        free(post);
+    }
+    if (result != CURLE_OK) {
+        fprintf(stderr, "Failed to submit bid: %s\n", curl_easy_strerror(result));
+    }
+}
+
+// POST to the utility API without blocking the loop
+void postUrl(const char *url) {
+    CURL *curl = curl_easy_init();
+    if (curl) {
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)BID_POST_TIMEOUT_MS);
+
+        // Tracing and metrics are best effort: without memory for them the bid is still posted
+        BidPost *post = (BidPost*)malloc(sizeof(BidPost));
+        if (post != NULL) {
+            post->trace = currentTrace();
+            post->trace_id = nextTraceId();
+            post->start_us = rt_now_us();
+            trace_async_begin(post->trace, TRACE_HTTP, "POST bid", post->trace_id);
+        }
+        if (event_loop_start_http(&gatewayLoop, curl, _onBidPosted, post) != 0) {
+            curl_easy_cleanup(curl);
+            free(post);
+        }
+    }
+}
+
+static size_t _appendResponse(void *contents, size_t size, size_t nmemb, void *userp) {
+    MarketDataFetch *fetch = (MarketDataFetch*)userp;
+    size_t length = size * nmemb;
+
+    char *data = (char*)realloc(fetch->data, fetch->length + length + 1);
+    if (data == NULL) {
+        return 0;
+    }
+    memcpy(data + fetch->length, contents, length);
+    fetch->data = data;
+    fetch->length += length;
+    fetch->data[fetch->length] = '\0';
+    return length;
+}
+
+// Parse the whole response at once, then continue as the RTOS path would after a blocking fetch
+static void _onMarketData(CURL *easy, CURLcode result, void *context) {
+    MarketDataFetch *fetch = (MarketDataFetch*)context;
+
+    trace_async_end(fetch->trace, TRACE_HTTP, "GET market data", fetch->trace_id);
+    recordMarketDataFetch(rt_now_us() - fetch->start_us);
+    runningTrace = fetch->trace;
+    if (result != CURLE_OK) {
+        fprintf(stderr, "Failed to fetch market data: %s\n", curl_easy_strerror(result));
+    } else if (fetch->data != NULL) {
+        write_callback(fetch->data, 1, fetch->length, NULL);
+    }
+    if (fetch->done != NULL) {
+        fetch->done();
+    }
+    runningTrace = NULL;
+
+    free(fetch->data);
+    free(fetch);
+    runJob(TASK_BID_SUBMISSION);
+}
+
+// Fetch market data without blocking the loop, then continue with done
+void requestMarketData(void (*done)(void)) {
+    MarketDataFetch *fetch = (MarketDataFetch*)calloc(1, sizeof(MarketDataFetch));
+    CURL *curl = curl_easy_init();
+    if (fetch == NULL || curl == NULL) {
+        free(fetch);
+        if (curl) {
+            curl_easy_cleanup(curl);
+        }
+        done();
+        return;
+    }
+    fetch->done = done;
+    fetch->trace = currentTrace();
+    fetch->trace_id = nextTraceId();
+    fetch->start_us = rt_now_us();
+
+    curl_easy_setopt(curl, CURLOPT_URL, UTILITY_API_URL "/market_data");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _appendResponse);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fetch);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)MARKET_DATA_TIMEOUT_MS);
+    trace_async_begin(fetch->trace, TRACE_HTTP, "GET market data", fetch->trace_id);
+    if (event_loop_start_http(&gatewayLoop, curl, _onMarketData, fetch) != 0) {
+        trace_async_end(fetch->trace, TRACE_HTTP, "GET market data", fetch->trace_id);
+        curl_easy_cleanup(curl);
+        free(fetch);
+        done();
+    }
+}
+
+// Answer pending scrapes in place; the socket timeouts bound how long a slow scraper can hold up the loop
+static void _onMetricsClient(int fd, uint32_t events, void *context) {
+    int client;
+    while ((client = accept(fd, NULL, NULL)) >= 0) {
+        struct timeval timeout = {0, METRICS_SCRAPE_TIMEOUT_MS * 1000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serveMetrics(client);
+        close(client);
+    }
+}
+
+// Bind the VEN wakeup socket; returns the descriptor or -1
+static int _openVenSocket(void) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, VEN_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    unlink(VEN_SOCKET_PATH);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(void) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (initGateway() != 0) {
+        return 1;
+    }
+    if (event_loop_init(&gatewayLoop) != 0) {
+        fprintf(stderr, "Unable to create the event loop\n");
+        return 1;
+    }
+
+    // Time blocked in epoll_wait is the gateway's idle time
+    gatewayLoop.idle = &idleStats;
+    idle_stats_init(&idleStats, rt_now_us());
+
+    // Let the kernel push timer expiries together with other wakeups on the system
+    prctl(PR_SET_TIMERSLACK, TIMER_SLACK_NS, 0, 0, 0);
+
+    // Every periodic job gets a timer on the shared wake grid, so all jobs due in the same second cost one wakeup;
+    // bid submission instead runs right after whatever queued the bids
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        if (i == TASK_BID_SUBMISSION) {
+            continue;
+        }
+        if (event_loop_add_aligned_timer(&gatewayLoop, taskTiming[i].period_us / 1000, taskTiming[i].align_us / 1000,
+                                         _onTaskTimer, (void*)(intptr_t)i) < 0) {
+            fprintf(stderr, "Unable to schedule %s\n", taskTiming[i].name);
+            return 1;
+        }
+    }
+
+    int venSocket = _openVenSocket();
+    if (venSocket < 0 || event_loop_add_fd(&gatewayLoop, venSocket, EPOLLIN, _onVenMessage, NULL) != 0) {
+        fprintf(stderr, "VEN socket %s unavailable, relying on 0x220 polling\n", VEN_SOCKET_PATH);
+    }
+
+    // Prometheus scrapes share the loop with the jobs
+    int metricsSocket = metrics_listen(METRICS_PORT);
+    if (metricsSocket < 0 || fcntl(metricsSocket, F_SETFL, O_NONBLOCK) != 0 ||
+        event_loop_add_fd(&gatewayLoop, metricsSocket, EPOLLIN, _onMetricsClient, NULL) != 0) {
+        fprintf(stderr, "Unable to serve metrics on port %d\n", METRICS_PORT);
+    }
+
+    // Stop cleanly on SIGINT / SIGTERM; dump a Chrome trace to TRACE_PATH on SIGUSR1
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd >= 0) {
+        event_loop_add_fd(&gatewayLoop, signalFd, EPOLLIN, _onSignal, NULL);
+    }
+
+    int status = event_loop_run(&gatewayLoop);
+    flushSocJournal();
+
+    event_loop_free(&gatewayLoop);
+    if (venSocket >= 0) {
+        close(venSocket);
+        unlink(VEN_SOCKET_PATH);
+    }
+    if (signalFd >= 0) {
+        close(signalFd);
+    }
+    if (metricsSocket >= 0) {
+        close(metricsSocket);
+    }
+    curl_global_cleanup();
+    return status == 0 ? 0 : 1;
+}
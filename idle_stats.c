@@ -0,0 +1,54 @@
+#include "idle_stats.h"
+#include <string.h>
+
+// Start measuring
+void idle_stats_init(IdleStats *stats, uint64_t now_us) {
+    memset(stats, 0, sizeof(*stats));
+    stats->started_us = now_us;
+}
+
+void idle_stats_sleep_begin(IdleStats *stats, uint64_t now_us) {
+    stats->sleep_start_us = now_us;
+}
+
+// Close the current sleep period
+void idle_stats_sleep_end(IdleStats *stats, uint64_t now_us) {
+    if (stats->sleep_start_us == 0 || now_us < stats->sleep_start_us) {
+        return;
+    }
+
+    uint64_t length = now_us - stats->sleep_start_us;
+    stats->sleep_start_us = 0;
+    stats->sleep_us += length;
+    stats->sleeps++;
+    if (length > stats->longest_sleep_us) {
+        stats->longest_sleep_us = length;
+    }
+
+    // Bucket b holds sleeps shorter than 2^b ms; the last bucket takes the rest
+    int bucket = 0;
+    uint64_t limit = 1000;
+    while (bucket < IDLE_HISTOGRAM_BUCKETS - 1 && length >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    stats->histogram[bucket]++;
+}
+
+double idle_stats_residency(const IdleStats *stats, uint64_t now_us) {
+    if (now_us <= stats->started_us) {
+        return 0.0;
+    }
+    uint64_t asleep = stats->sleep_us;
+    if (stats->sleep_start_us != 0 && now_us > stats->sleep_start_us) {
+        asleep += now_us - stats->sleep_start_us;
+    }
+    return (double)asleep / (double)(now_us - stats->started_us);
+}
+
+double idle_stats_wakeup_rate(const IdleStats *stats, uint64_t now_us) {
+    if (now_us <= stats->started_us) {
+        return 0.0;
+    }
+    return stats->sleeps * 1e6 / (double)(now_us - stats->started_us);
+}
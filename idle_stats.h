@@ -0,0 +1,34 @@
+#ifndef IDLE_STATS_H
+#define IDLE_STATS_H
+
+#include <stdint.h>
+
+#define IDLE_HISTOGRAM_BUCKETS 12       // Sleep lengths <1 ms, <2 ms, <4 ms, ... <1 s, and longer
+
+// Idle residency of the gateway: how much of the time the CPU sleeps, and in how many pieces
+// Fed by the FreeRTOS tickless idle hooks or by the Linux event loop around epoll_wait
+typedef struct {
+    uint64_t started_us;            // Start of the measurement
+    uint64_t sleep_start_us;        // Start of the current sleep (0 while awake)
+    uint64_t sleep_us;              // Total time asleep
+    uint64_t sleeps;                // Sleep periods, i.e. wakeups
+    uint64_t longest_sleep_us;
+    uint32_t histogram[IDLE_HISTOGRAM_BUCKETS]; // Sleep periods by length
+} IdleStats;
+
+// Start measuring at now_us
+void idle_stats_init(IdleStats *stats, uint64_t now_us);
+
+// The CPU is about to sleep
+void idle_stats_sleep_begin(IdleStats *stats, uint64_t now_us);
+
+// The CPU woke up
+void idle_stats_sleep_end(IdleStats *stats, uint64_t now_us);
+
+// Fraction of the time since the start spent asleep (0 to 1)
+double idle_stats_residency(const IdleStats *stats, uint64_t now_us);
+
+// Wakeups per second since the start
+double idle_stats_wakeup_rate(const IdleStats *stats, uint64_t now_us);
+
+#endif // IDLE_STATS_H
@@ -0,0 +1,80 @@
+#include "inverter.h"
+#include <math.h>
+
+// Initialize with rated limits and default ramp and derate settings
+void inverter_init(InverterCapability *inverter, double max_discharge_kw, double max_charge_kw) {
+    inverter->max_discharge_kw = max_discharge_kw;
+    inverter->max_charge_kw = max_charge_kw;
+    inverter->ramp_up_kw_per_s = max_discharge_kw / 10.0;     // Full power in 10 seconds
+    inverter->ramp_down_kw_per_s = max_discharge_kw / 10.0;
+    inverter->derate_start_c = 45.0;
+    inverter->derate_per_c = 0.025;                             // Zero output by 85°C
+    inverter->min_derate = 0.0;
+
+    inverter->temperature_c = 25.0;
+    inverter->derate = 1.0;
+    inverter->setpoint_kw = 0.0;
+    inverter->setpoint_time = 0;
+}
+
+// Record a temperature measurement and update the derate factor
+void inverter_set_temperature(InverterCapability *inverter, double temperature_c) {
+    double excess = fmax(temperature_c - inverter->derate_start_c, 0.0);
+    inverter->temperature_c = temperature_c;
+    inverter->derate = fmin(fmax(1.0 - inverter->derate_per_c * excess, inverter->min_derate), 1.0);
+}
+
+double inverter_discharge_limit(const InverterCapability *inverter) {
+    return inverter->max_discharge_kw * inverter->derate;
+}
+
+double inverter_charge_limit(const InverterCapability *inverter) {
+    return inverter->max_charge_kw * inverter->derate;
+}
+
+// Energy deliverable over a window when ramping from start_kw to the derated discharge limit
+double inverter_window_energy(const InverterCapability *inverter, double start_kw, double window_hours) {
+    double limit = inverter_discharge_limit(inverter);
+    double start = fmin(fmax(start_kw, 0.0), limit);
+    double window = fmax(window_hours, 0.0) * 3600.0;
+    double ramp = inverter->ramp_up_kw_per_s;
+
+    if (ramp <= 0.0) {
+        return limit * window / 3600.0;
+    }
+
+    // Linear ramp to the limit, then hold; a short window ends part-way up the ramp
+    double ramp_time = (limit - start) / ramp;
+    if (window >= ramp_time) {
+        return (limit * window - 0.5 * (limit - start) * ramp_time) / 3600.0;
+    }
+    return (start * window + 0.5 * ramp * window * window) / 3600.0;
+}
+
+// Clamp a requested setpoint to the derated limits and the ramp from the previous setpoint
+double inverter_limit_setpoint(InverterCapability *inverter, double requested_kw, time_t now) {
+    double setpoint = fmin(fmax(requested_kw, -inverter_charge_limit(inverter)), inverter_discharge_limit(inverter));
+
+    // A setpoint held for a long time still only moves one ramp step per write
+    double elapsed = (inverter->setpoint_time != 0) ? difftime(now, inverter->setpoint_time) : INVERTER_RAMP_STEP_SECONDS;
+    elapsed = fmin(fmax(elapsed, 0.0), INVERTER_RAMP_STEP_SECONDS);
+
+    double max_step_up = inverter->ramp_up_kw_per_s * elapsed;
+    double max_step_down = inverter->ramp_down_kw_per_s * elapsed;
+    if (inverter->ramp_up_kw_per_s > 0.0 && setpoint > inverter->setpoint_kw + max_step_up) {
+        setpoint = inverter->setpoint_kw + max_step_up;
+    }
+    if (inverter->ramp_down_kw_per_s > 0.0 && setpoint < inverter->setpoint_kw - max_step_down) {
+        setpoint = inverter->setpoint_kw - max_step_down;
+    }
+
+    inverter->setpoint_kw = setpoint;
+    inverter->setpoint_time = now;
+    return setpoint;
+}
+
+// Forget the tracked setpoint so the next dispatch ramps from rest
+void inverter_reset_setpoint(InverterCapability *inverter) {
+    inverter->setpoint_kw = 0.0;
+    inverter->setpoint_time = 0;
+}
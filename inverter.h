@@ -0,0 +1,48 @@
+#ifndef INVERTER_H
+#define INVERTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define INVERTER_RAMP_STEP_SECONDS 1    // Longest interval one setpoint change may be ramped over
+
+// Inverter capability: AC power limits, setpoint ramp rates and a linear over-temperature derate
+// Every query is a closed-form expression, so bid paths can check deliverability in constant time
+typedef struct InverterCapability {
+    double max_discharge_kw;        // Rated discharge power (kW)
+    double max_charge_kw;           // Rated charge power (kW)
+    double ramp_up_kw_per_s;        // Largest setpoint increase per second (kW/s)
+    double ramp_down_kw_per_s;      // Largest setpoint decrease per second (kW/s)
+    double derate_start_c;          // Temperature above which rated power is derated (°C)
+    double derate_per_c;            // Fraction of rated power lost per °C above derate_start_c
+    double min_derate;              // Floor on the derate factor (0.0 lets the inverter shut down)
+
+    // Live state
+    double temperature_c;           // Last measured temperature (°C)
+    double derate;                  // Derate factor at temperature_c (0.0 to 1.0)
+    double setpoint_kw;             // Last setpoint issued, positive for discharge
+    time_t setpoint_time;           // When setpoint_kw was issued, 0 before the first
+} InverterCapability;
+
+// Initialize with rated limits; ramps default to full power over 10 s, derating 2.5%/°C above 45°C
+void inverter_init(InverterCapability *inverter, double max_discharge_kw, double max_charge_kw);
+
+// Record a temperature measurement and update the derate factor
+void inverter_set_temperature(InverterCapability *inverter, double temperature_c);
+
+// Derated power limits at the last measured temperature (kW)
+double inverter_discharge_limit(const InverterCapability *inverter);
+double inverter_charge_limit(const InverterCapability *inverter);
+
+// Energy deliverable over a window when ramping up from start_kw to the derated discharge limit (kWh)
+double inverter_window_energy(const InverterCapability *inverter, double start_kw, double window_hours);
+
+// Clamp a requested setpoint (kW, positive discharge, negative charge) to the derated limits and the ramp
+// from the previous setpoint, record it as issued at now, and return it
+double inverter_limit_setpoint(InverterCapability *inverter, double requested_kw, time_t now);
+
+// Forget the tracked setpoint after the inverter was stopped outside the gateway (e.g. DR disabled)
+void inverter_reset_setpoint(InverterCapability *inverter);
+
+#endif // INVERTER_H
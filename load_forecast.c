@@ -0,0 +1,103 @@
+#include "load_forecast.h"
+#include <math.h>
+#include <string.h>
+
+#define MINUTES_PER_DAY 1440
+
+// Profile slot (day type and interval of day) for a wall-clock time
+static void _profile_slot(const LoadForecaster *forecaster, time_t t, int *day_type, int *interval) {
+    struct tm local;
+    localtime_r(&t, &local);
+    *day_type = (local.tm_wday == 0 || local.tm_wday == 6) ? 1 : 0;
+    *interval = (local.tm_hour * 60 + local.tm_min) / forecaster->interval_minutes;
+}
+
+// Initialize for a meter interval length
+int load_forecast_init(LoadForecaster *forecaster, int interval_minutes, double smoothing) {
+    memset(forecaster, 0, sizeof(*forecaster));
+    if (interval_minutes <= 0 || MINUTES_PER_DAY % interval_minutes != 0 ||
+        MINUTES_PER_DAY / interval_minutes > LOAD_FORECAST_MAX_INTERVALS ||
+        smoothing <= 0.0 || smoothing > 1.0) {
+        return -1;
+    }
+
+    forecaster->interval_minutes = interval_minutes;
+    forecaster->intervals_per_day = MINUTES_PER_DAY / interval_minutes;
+    forecaster->smoothing = smoothing;
+    return 0;
+}
+
+// Fold one observed interval into its profile
+void load_forecast_update(LoadForecaster *forecaster, time_t interval_start, double energy_kwh) {
+    int day_type, interval;
+    _profile_slot(forecaster, interval_start, &day_type, &interval);
+
+    float *mean = &forecaster->mean[day_type][interval];
+    float *variance = &forecaster->variance[day_type][interval];
+    uint16_t *samples = &forecaster->samples[day_type][interval];
+
+    if (*samples == 0) {
+        *mean = (float)energy_kwh;
+        *variance = 0.0f;
+    } else {
+        // Use a plain running average until the profile has enough history for the EWMA to be stable
+        double weight = fmax(forecaster->smoothing, 1.0 / (*samples + 1));
+        double diff = energy_kwh - *mean;
+        double increment = weight * diff;
+        *mean += (float)increment;
+        *variance = (float)((1.0 - weight) * (*variance + diff * increment));
+    }
+
+    if (*samples < UINT16_MAX) {
+        (*samples)++;
+    }
+}
+
+// Predicted net load for one profile slot
+static double _slot_predict(const LoadForecaster *forecaster, int day_type, int interval, double z) {
+    // Fall back to the other day type before any history exists for this one
+    if (forecaster->samples[day_type][interval] == 0) {
+        day_type = 1 - day_type;
+        if (forecaster->samples[day_type][interval] == 0) {
+            return 0.0;
+        }
+    }
+
+    double mean = forecaster->mean[day_type][interval];
+    double deviation = sqrt(fmax(forecaster->variance[day_type][interval], 0.0f));
+    return fmax(mean + z * deviation, 0.0);
+}
+
+// Predicted net load for the interval containing a time
+double load_forecast_predict(const LoadForecaster *forecaster, time_t t, double z) {
+    int day_type, interval;
+    _profile_slot(forecaster, t, &day_type, &interval);
+    return _slot_predict(forecaster, day_type, interval, z);
+}
+
+// Predicted net load over a window of hours
+double load_forecast_energy(const LoadForecaster *forecaster, time_t start, double hours, double z) {
+    int interval_seconds = forecaster->interval_minutes * 60;
+    double remaining = hours * 3600.0;
+    double total = 0.0;
+    time_t t = start;
+
+    // Local time is resolved once and the slot stepped from there, re-resolving at midnight for the day type
+    // A DST change inside the window leaves the rest of it one hour out on the profile
+    int day_type, interval;
+    _profile_slot(forecaster, t, &day_type, &interval);
+
+    // Partial intervals at either end are prorated
+    while (remaining > 0.0) {
+        double in_interval = interval_seconds - (double)(t % interval_seconds);
+        double span = fmin(in_interval, remaining);
+        total += _slot_predict(forecaster, day_type, interval, z) * span / interval_seconds;
+        remaining -= span;
+        t += (time_t)span;
+        if (++interval == forecaster->intervals_per_day && remaining > 0.0) {
+            _profile_slot(forecaster, t, &day_type, &interval);
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,35 @@
+#ifndef LOAD_FORECAST_H
+#define LOAD_FORECAST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define LOAD_FORECAST_MAX_INTERVALS 96  // Up to 15-minute intervals
+#define LOAD_FORECAST_DAY_TYPES 2       // Weekday and weekend profiles
+#define LOAD_FORECAST_DEFAULT_Z 1.0     // Bid against roughly the 84th percentile of household load
+
+// Seasonal household load profiles with exponentially weighted mean and variance per interval of day
+// Fixed memory and O(1) updates, sized for on-device use
+typedef struct LoadForecaster {
+    int interval_minutes;
+    int intervals_per_day;
+    double smoothing;               // EWMA weight of each new observation (0.0 to 1.0)
+    float mean[LOAD_FORECAST_DAY_TYPES][LOAD_FORECAST_MAX_INTERVALS];      // kWh per interval
+    float variance[LOAD_FORECAST_DAY_TYPES][LOAD_FORECAST_MAX_INTERVALS];  // kWh² per interval
+    uint16_t samples[LOAD_FORECAST_DAY_TYPES][LOAD_FORECAST_MAX_INTERVALS];
+} LoadForecaster;
+
+// Initialize for a meter interval length; smoothing of ~0.1 tracks seasonal drift over a few weeks
+int load_forecast_init(LoadForecaster *forecaster, int interval_minutes, double smoothing);
+
+// Fold one observed interval of household net load (consumption less PV, kWh) into its profile
+void load_forecast_update(LoadForecaster *forecaster, time_t interval_start, double energy_kwh);
+
+// Predicted net load for the interval containing a time (kWh): mean + z standard deviations, never negative
+double load_forecast_predict(const LoadForecaster *forecaster, time_t t, double z);
+
+// Predicted net load over a window of hours starting at a time (kWh)
+double load_forecast_energy(const LoadForecaster *forecaster, time_t start, double hours, double z);
+
+#endif // LOAD_FORECAST_H
@@ -0,0 +1,61 @@
+#include "mem_stats.h"
+#include <string.h>
+
+// Start tracking a task
+void mem_task_init(TaskMemory *memory, uint32_t stack_bytes) {
+    memset(memory, 0, sizeof(*memory));
+    memory->stack_bytes = stack_bytes;
+    memory->stack_min_free = UINT32_MAX;
+}
+
+// Record the stack still free
+bool mem_task_stack_sample(TaskMemory *memory, uint32_t free_bytes, double warn_fraction) {
+    if (free_bytes < memory->stack_min_free) {
+        memory->stack_min_free = free_bytes;
+    }
+    if (!memory->stack_warned && memory->stack_min_free < warn_fraction * memory->stack_bytes) {
+        memory->stack_warned = true;
+        return true;
+    }
+    return false;
+}
+
+void mem_task_heap_job(TaskMemory *memory, size_t heap_before, size_t heap_after) {
+    int64_t growth = (int64_t)heap_after - (int64_t)heap_before;
+    memory->heap_net += growth;
+    if (growth > (int64_t)memory->heap_job_peak) {
+        memory->heap_job_peak = (growth > UINT32_MAX) ? UINT32_MAX : (uint32_t)growth;
+    }
+}
+
+double mem_task_stack_use(const TaskMemory *memory) {
+    if (memory->stack_bytes == 0 || memory->stack_min_free == UINT32_MAX) {
+        return 0.0;
+    }
+    return 1.0 - (double)memory->stack_min_free / memory->stack_bytes;
+}
+
+// Start tracking the heap, before any task samples it
+void mem_heap_init(HeapMonitor *heap, size_t warn_bytes) {
+    atomic_init(&heap->in_use, 0);
+    atomic_init(&heap->peak, 0);
+    heap->warn_bytes = warn_bytes;
+    atomic_init(&heap->warned, false);
+}
+
+bool mem_heap_sample(HeapMonitor *heap, size_t in_use) {
+    atomic_store_explicit(&heap->in_use, in_use, memory_order_relaxed);
+
+    // Raise the peak unless another core has already raised it past this sample
+    size_t peak = atomic_load_explicit(&heap->peak, memory_order_relaxed);
+    while (in_use > peak &&
+           !atomic_compare_exchange_weak_explicit(&heap->peak, &peak, in_use, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+
+    if (heap->warn_bytes > 0 && in_use > heap->warn_bytes &&
+        !atomic_load_explicit(&heap->warned, memory_order_relaxed)) {
+        return !atomic_exchange_explicit(&heap->warned, true, memory_order_relaxed);
+    }
+    return false;
+}
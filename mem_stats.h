@@ -0,0 +1,46 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Stack and heap use of one task
+typedef struct {
+    uint32_t stack_bytes;           // Stack allocated
+    uint32_t stack_min_free;        // Least stack ever free, the high-water mark (UINT32_MAX before the first sample)
+    int64_t heap_net;               // Net heap growth over all of the task's jobs
+    uint32_t heap_job_peak;         // Largest growth across one job
+    bool stack_warned;              // Stack threshold crossing already reported
+} TaskMemory;
+
+// Heap use of the whole gateway, sampled lock-free by tasks on any core
+typedef struct {
+    _Atomic size_t in_use;          // Latest sample
+    _Atomic size_t peak;            // Largest sample
+    size_t warn_bytes;              // Threshold for a warning
+    atomic_bool warned;             // Threshold crossing already reported
+} HeapMonitor;
+
+// Start tracking a task with a stack of stack_bytes
+void mem_task_init(TaskMemory *memory, uint32_t stack_bytes);
+
+// Record the stack still free at its high-water mark; returns true the first time less than warn_fraction is free
+bool mem_task_stack_sample(TaskMemory *memory, uint32_t free_bytes, double warn_fraction);
+
+// Charge the heap change across one job to the task
+// The heap is shared, so allocations by a higher-priority task that preempts the job, or on SMP by tasks running on
+// other cores at the same time, are charged here too: per-task figures are approximate, the whole-heap ones are not
+void mem_task_heap_job(TaskMemory *memory, size_t heap_before, size_t heap_after);
+
+// Worst share of the stack used so far (0 to 1)
+double mem_task_stack_use(const TaskMemory *memory);
+
+// Start tracking the heap
+void mem_heap_init(HeapMonitor *heap, size_t warn_bytes);
+
+// Record heap in use; safe to call from every core, and returns true for exactly one sample above the threshold
+bool mem_heap_sample(HeapMonitor *heap, size_t in_use);
+
+#endif // MEM_STATS_H
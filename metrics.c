@@ -0,0 +1,188 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0                  // Stacks without SIGPIPE
+#endif
+
+static uint64_t _bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double _value(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Append to the exposition; once anything overflows the whole render fails
+static void _append(char *buffer, size_t size, size_t *length, bool *overflow, const char *format, ...) {
+    if (*overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, size - *length, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= size - *length) {
+        *overflow = true;
+        return;
+    }
+    *length += (size_t)written;
+}
+
+static int _send_all(int client, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(client, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+void metric_counter_add(MetricCounter *counter, uint64_t amount) {
+    atomic_fetch_add_explicit(&counter->value, amount, memory_order_relaxed);
+}
+
+void metric_gauge_set(MetricGauge *gauge, double value) {
+    atomic_store_explicit(&gauge->bits, _bits(value), memory_order_relaxed);
+}
+
+void metric_histogram_init(MetricHistogram *histogram, const double *bounds, int num_bounds) {
+    histogram->bounds = bounds;
+    histogram->num_bounds = (num_bounds < METRIC_MAX_BUCKETS) ? num_bounds : METRIC_MAX_BUCKETS;
+    for (int i = 0; i <= METRIC_MAX_BUCKETS; i++) {
+        atomic_init(&histogram->buckets[i], 0);
+    }
+    atomic_init(&histogram->sum_bits, _bits(0.0));
+}
+
+// Record one observation
+void metric_histogram_observe(MetricHistogram *histogram, double value) {
+    int bucket = 0;
+    while (bucket < histogram->num_bounds && value > histogram->bounds[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+
+    // No atomic add for doubles; retry the swap if another writer got in between
+    uint64_t expected = atomic_load_explicit(&histogram->sum_bits, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&histogram->sum_bits, &expected, _bits(_value(expected) + value),
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Write the text exposition format
+size_t metrics_render(char *buffer, size_t size, const MetricDescriptor *metrics, int num_metrics) {
+    static const char *typeNames[] = {"counter", "gauge", "histogram"};
+    size_t length = 0;
+    bool overflow = (size == 0);
+
+    for (int i = 0; i < num_metrics; i++) {
+        const MetricDescriptor *metric = &metrics[i];
+        if (i == 0 || strcmp(metric->name, metrics[i - 1].name) != 0) {
+            _append(buffer, size, &length, &overflow, "# HELP %s %s\n# TYPE %s %s\n",
+                    metric->name, metric->help, metric->name, typeNames[metric->type]);
+        }
+
+        const char *labels = (metric->labels != NULL) ? metric->labels : "";
+        const char *open = (metric->labels != NULL) ? "{" : "";
+        const char *close = (metric->labels != NULL) ? "}" : "";
+        if (metric->type == METRIC_COUNTER) {
+            MetricCounter *counter = (MetricCounter*)metric->metric;
+            _append(buffer, size, &length, &overflow, "%s%s%s%s %llu\n", metric->name, open, labels, close,
+                    (unsigned long long)atomic_load_explicit(&counter->value, memory_order_relaxed));
+        } else if (metric->type == METRIC_GAUGE) {
+            MetricGauge *gauge = (MetricGauge*)metric->metric;
+            _append(buffer, size, &length, &overflow, "%s%s%s%s %.9g\n", metric->name, open, labels, close,
+                    _value(atomic_load_explicit(&gauge->bits, memory_order_relaxed)));
+        } else {
+            // Buckets are cumulative in the exposition
+            MetricHistogram *histogram = (MetricHistogram*)metric->metric;
+            const char *separator = (metric->labels != NULL) ? "," : "";
+            uint64_t cumulative = 0;
+            for (int b = 0; b <= histogram->num_bounds; b++) {
+                cumulative += atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+                if (b < histogram->num_bounds) {
+                    _append(buffer, size, &length, &overflow, "%s_bucket{%s%sle=\"%g\"} %llu\n", metric->name,
+                            labels, separator, histogram->bounds[b], (unsigned long long)cumulative);
+                } else {
+                    _append(buffer, size, &length, &overflow, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", metric->name,
+                            labels, separator, (unsigned long long)cumulative);
+                }
+            }
+            _append(buffer, size, &length, &overflow, "%s_sum%s%s%s %.9g\n%s_count%s%s%s %llu\n",
+                    metric->name, open, labels, close,
+                    _value(atomic_load_explicit(&histogram->sum_bits, memory_order_relaxed)),
+                    metric->name, open, labels, close, (unsigned long long)cumulative);
+        }
+    }
+    return overflow ? 0 : length;
+}
+
+// Listen for scrapes
+int metrics_listen(uint16_t port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0) {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+// Answer one scrape
+int metrics_serve(int client, char *buffer, size_t size, const MetricDescriptor *metrics, int num_metrics) {
+    // The request line arrives in the first segment; headers and body are ignored
+    char request[256];
+    ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+    if (received <= 0) {
+        return -1;
+    }
+    request[received] = '\0';
+
+    char header[160];
+    if (strncmp(request, "GET /metrics", 12) != 0 || (request[12] != ' ' && request[12] != '?')) {
+        int length = snprintf(header, sizeof(header),
+                              "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return _send_all(client, header, (size_t)length);
+    }
+
+    size_t body = metrics_render(buffer, size, metrics, num_metrics);
+    if (body == 0) {
+        int length = snprintf(header, sizeof(header),
+                              "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        _send_all(client, header, (size_t)length);
+        return -1;
+    }
+
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: %zu\r\nConnection: close\r\n\r\n", body);
+    if (_send_all(client, header, (size_t)length) != 0) {
+        return -1;
+    }
+    return _send_all(client, buffer, body);
+}
@@ -0,0 +1,67 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define METRIC_MAX_BUCKETS 12           // Finite histogram bounds; +Inf is implicit
+
+// Monotonic count, e.g. bids posted
+typedef struct {
+    _Atomic uint64_t value;
+} MetricCounter;
+
+// Latest value, e.g. SOC; the double is stored by bit pattern so updates are single atomic stores
+typedef struct {
+    _Atomic uint64_t bits;
+} MetricGauge;
+
+// Distribution over fixed bounds, e.g. request latency in seconds
+typedef struct {
+    const double *bounds;           // Ascending upper bounds, at most METRIC_MAX_BUCKETS
+    int num_bounds;
+    _Atomic uint64_t buckets[METRIC_MAX_BUCKETS + 1]; // Observations per bucket (not cumulative); the last is +Inf
+    _Atomic uint64_t sum_bits;      // Sum of observations, a double stored by bit pattern
+} MetricHistogram;
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} MetricType;
+
+// One exported series; consecutive descriptors with the same name share its HELP and TYPE lines
+typedef struct {
+    const char *name;
+    const char *help;
+    const char *labels;             // Label pairs without braces, e.g. "op=\"read\"", or NULL
+    MetricType type;
+    void *metric;                   // MetricCounter, MetricGauge or MetricHistogram
+} MetricDescriptor;
+
+// Updates are lock-free and never allocate, so they can sit in control-loop hot paths
+
+// Add to a counter
+void metric_counter_add(MetricCounter *counter, uint64_t amount);
+
+// Set a gauge
+void metric_gauge_set(MetricGauge *gauge, double value);
+
+// Start a histogram over bounds (kept by reference)
+void metric_histogram_init(MetricHistogram *histogram, const double *bounds, int num_bounds);
+
+// Record one observation
+void metric_histogram_observe(MetricHistogram *histogram, double value);
+
+// Write metrics in the Prometheus text exposition format into buffer; returns the length, or 0 if it did not fit
+size_t metrics_render(char *buffer, size_t size, const MetricDescriptor *metrics, int num_metrics);
+
+// Listen for scrapes on a TCP port; returns the socket or -1
+int metrics_listen(uint16_t port);
+
+// Answer one scrape on a connected socket: GET /metrics gets the metrics rendered into buffer, anything else 404
+// The caller sets socket timeouts and closes the socket; returns 0 on success, -1 on a socket error or overflow
+int metrics_serve(int client, char *buffer, size_t size, const MetricDescriptor *metrics, int num_metrics);
+
+#endif // METRICS_H
@@ -3,12 +3,14 @@ import logging
 from openleadr import OpenADRClient, enums
 import modbus_tk.modbus_rtu as modbus_rtu
 import serial
+import socket
 
 logging.basicConfig(level=logging.DEBUG)
 
 MODBUS_PORT = "/dev/ttyUSB0"  # Update with your Modbus port
 MODBUS_BAUD = 9600
 MODBUS_UNIT = 1
+VEN_SOCKET_PATH = "/run/opencbp/ven.sock"  # Gateway wakeup socket (Linux runtime only)
 
 class MyOpenADRClient(OpenADRClient):
     def __init__(self, *args, **kwargs):
@@ -48,6 +50,15 @@ class MyOpenADRClient(OpenADRClient):
     def set_dr_active(self, value):
         self.is_dr_active = value
         self.master.execute(MODBUS_UNIT, modbus_rtu.WRITE_SINGLE_REGISTER, 0x220, output_value=int(value))
+        self.notify_gateway(value)
+
+    def notify_gateway(self, value):
+        # Wake the gateway's event loop so dispatch doesn't wait for its next 0x220 poll
+        try:
+            with socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM) as sock:
+                sock.sendto(f"dr_active={int(value)}".encode(), VEN_SOCKET_PATH)
+        except OSError:
+            pass  # RTOS gateway, or the Linux runtime is not running
 
     def get_bid_data(self):
         # Read SOC and available capacity from C code via Modbus
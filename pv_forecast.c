@@ -0,0 +1,116 @@
+#include "pv_forecast.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CLEAR_SKY_SUBSTEPS 6            // Samples per hour when integrating clear-sky irradiance
+#define PV_TEMP_COEFFICIENT -0.004      // Module power change per °C above 25°C
+#define PV_CELL_HEATING 0.03            // Cell temperature rise per W/m² of irradiance (°C)
+
+// Precompute the clear-sky table for a site
+int pv_forecast_init(PvForecast *forecast, double peak_kw, double latitude, double longitude, double timezone_offset) {
+    memset(forecast, 0, sizeof(*forecast));
+    if (peak_kw <= 0.0) {
+        return -1;
+    }
+    forecast->peak_kw = peak_kw;
+
+    double lat = latitude * M_PI / 180.0;
+    double solar_noon = 12.0 - (longitude / 15.0) + timezone_offset;
+
+    for (int day = 0; day < 366; day++) {
+        // Same declination approximation as the sunrise/sunset LUT
+        double declination = -23.44 * cos((2 * M_PI / 365.0) * (day + 10)) * M_PI / 180.0;
+
+        for (int hour = 0; hour < 24; hour++) {
+            double energy = 0.0;
+            for (int k = 0; k < CLEAR_SKY_SUBSTEPS; k++) {
+                double t = hour + (k + 0.5) / CLEAR_SKY_SUBSTEPS;
+                double hour_angle = 15.0 * (t - solar_noon) * M_PI / 180.0;
+                double cos_zenith = sin(lat) * sin(declination) + cos(lat) * cos(declination) * cos(hour_angle);
+
+                // Haurwitz clear-sky global horizontal irradiance (W/m²)
+                if (cos_zenith > 0.0) {
+                    double ghi = 1098.0 * cos_zenith * exp(-0.057 / cos_zenith);
+                    energy += peak_kw * ghi / 1000.0 / CLEAR_SKY_SUBSTEPS;
+                }
+            }
+            forecast->clear_sky_kwh[day][hour] = (float)energy;
+        }
+    }
+
+    return 0;
+}
+
+// Re-read the weather file if it changed since the last call
+int pv_forecast_refresh(PvForecast *forecast, const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+    if (info.st_mtime == forecast->file_mtime) {
+        return 0;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    // Each hour lands in its own ring slot, so a new file only overwrites the hours it covers
+    int updated = 0;
+    long hour;
+    double cloud_percent, temperature;
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%ld,%lf,%lf", &hour, &cloud_percent, &temperature) != 3) {
+            continue;
+        }
+        hour -= hour % 3600;
+
+        WeatherHour *slot = &forecast->weather[(hour / 3600) % PV_FORECAST_HORIZON_HOURS];
+        slot->hour = (time_t)hour;
+        slot->cloud_cover = (float)fmin(fmax(cloud_percent / 100.0, 0.0), 1.0);
+        slot->temperature = (float)temperature;
+        updated++;
+    }
+
+    fclose(file);
+    forecast->file_mtime = info.st_mtime;
+    return updated;
+}
+
+// Forecast PV energy for one hour
+double pv_forecast_hour(const PvForecast *forecast, time_t hour_start) {
+    struct tm local;
+    localtime_r(&hour_start, &local);
+    double clear_sky = forecast->clear_sky_kwh[local.tm_yday][local.tm_hour];
+    if (clear_sky <= 0.0) {
+        return 0.0;
+    }
+
+    time_t hour = hour_start - (hour_start % 3600);
+    const WeatherHour *slot = &forecast->weather[(hour / 3600) % PV_FORECAST_HORIZON_HOURS];
+    if (slot->hour != hour) {
+        return clear_sky;
+    }
+
+    // Kasten-Czeplak cloud attenuation
+    double cloud_factor = 1.0 - 0.75 * pow(slot->cloud_cover, 3.4);
+    double energy = clear_sky * cloud_factor;
+
+    // Module temperature derate from ambient temperature and mean irradiance over the hour
+    double irradiance = energy / forecast->peak_kw * 1000.0;
+    double cell_temperature = slot->temperature + PV_CELL_HEATING * irradiance;
+    energy *= 1.0 + PV_TEMP_COEFFICIENT * (cell_temperature - 25.0);
+
+    return fmax(energy, 0.0);
+}
+
+// Forecast PV energy for consecutive hours
+void pv_forecast_hourly(const PvForecast *forecast, time_t start, int hours, double *hourly_energy) {
+    for (int i = 0; i < hours; i++) {
+        hourly_energy[i] = pv_forecast_hour(forecast, start + i * 3600);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef PV_FORECAST_H
+#define PV_FORECAST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PV_FORECAST_HORIZON_HOURS 168   // Weather hours retained (one week ahead)
+
+// One hour of a local weather forecast
+typedef struct {
+    time_t hour;                    // Hour start (epoch seconds), 0 when the slot is empty
+    float cloud_cover;              // Cloud cover fraction (0.0 to 1.0)
+    float temperature;              // Ambient temperature (°C)
+} WeatherHour;
+
+// PV production forecast: precomputed clear-sky energy adjusted by the latest weather file
+typedef struct {
+    double peak_kw;                 // PV array output at 1000 W/m² in kW
+    float clear_sky_kwh[366][24];   // Clear-sky energy per day of year and local hour (kWh)
+    WeatherHour weather[PV_FORECAST_HORIZON_HOURS];  // Ring keyed by hour
+    time_t file_mtime;              // Modification time of the last weather file read
+} PvForecast;
+
+// Precompute the clear-sky table for a site; returns 0 on success
+int pv_forecast_init(PvForecast *forecast, double peak_kw, double latitude, double longitude, double timezone_offset);
+
+// Re-read the weather file if it changed since the last call
+// File lines are "epoch_seconds,cloud_cover_percent,temperature_c", one per forecast hour
+// Returns the number of hours updated, 0 if the file is unchanged, or -1 if it cannot be read
+int pv_forecast_refresh(PvForecast *forecast, const char *path);
+
+// Forecast PV energy for the hour starting at hour_start (kWh); clear-sky when no weather covers the hour
+double pv_forecast_hour(const PvForecast *forecast, time_t hour_start);
+
+// Forecast PV energy for consecutive hours starting at start, as consumed by the CBP planner (kWh)
+void pv_forecast_hourly(const PvForecast *forecast, time_t start, int hours, double *hourly_energy);
+
+#endif // PV_FORECAST_H
@@ -0,0 +1,293 @@
+#include "rainflow.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Stack of turning points not yet closed into a cycle, plus the latest point not yet known to be a reversal
+typedef struct {
+    double *value;
+    int64_t *index;
+    int64_t size;
+    int64_t capacity;
+    double pending_value;
+    int64_t pending_index;
+    bool has_pending;
+    int direction;                  // +1 rising, -1 falling, 0 before the second distinct value
+} RainflowStack;
+
+// One chunk of a parallel count
+typedef struct {
+    const double *soc;
+    int64_t first;
+    int64_t last;                   // One past the final sample
+    RainflowStack stack;
+    RainflowResult result;
+    int status;
+} RainflowChunk;
+
+static int _append_cycle(RainflowResult *result, double from, double to, double count, int64_t start, int64_t end) {
+    if (result->num_cycles == result->capacity) {
+        int64_t capacity = (result->capacity > 0) ? result->capacity * 2 : 64;
+        RainflowTraceCycle *cycles = (RainflowTraceCycle*)realloc(result->cycles, capacity * sizeof(RainflowTraceCycle));
+        if (cycles == NULL) {
+            return -1;
+        }
+        result->cycles = cycles;
+        result->capacity = capacity;
+    }
+
+    RainflowTraceCycle *cycle = &result->cycles[result->num_cycles++];
+    cycle->depth = fabs(from - to);
+    cycle->mean_soc = 0.5 * (from + to);
+    cycle->count = count;
+    cycle->start = start;
+    cycle->end = end;
+    return 0;
+}
+
+// Commit a turning point and close every cycle it completes
+static int _push_turning_point(RainflowStack *stack, RainflowResult *result, double value, int64_t index) {
+    if (stack->size == stack->capacity) {
+        int64_t capacity = (stack->capacity > 0) ? stack->capacity * 2 : 64;
+        double *values = (double*)realloc(stack->value, capacity * sizeof(double));
+        if (values == NULL) {
+            return -1;
+        }
+        stack->value = values;
+        int64_t *indices = (int64_t*)realloc(stack->index, capacity * sizeof(int64_t));
+        if (indices == NULL) {
+            return -1;
+        }
+        stack->index = indices;
+        stack->capacity = capacity;
+    }
+    stack->value[stack->size] = value;
+    stack->index[stack->size] = index;
+    stack->size++;
+
+    // Four-point rule: the inner pair b-c is a closed cycle when it is enclosed by the ranges either side
+    // Ties close only on the trailing side, so repeated SOC levels pair the same way whatever preceded them
+    while (stack->size >= 4) {
+        double *v = &stack->value[stack->size - 4];
+        double inner = fabs(v[1] - v[2]);
+        if (inner >= fabs(v[0] - v[1]) || inner > fabs(v[2] - v[3])) {
+            break;
+        }
+
+        int64_t *idx = &stack->index[stack->size - 4];
+        if (_append_cycle(result, v[1], v[2], 1.0, idx[1], idx[2]) != 0) {
+            return -1;
+        }
+        v[1] = v[3];
+        idx[1] = idx[3];
+        stack->size -= 2;
+    }
+    return 0;
+}
+
+// Feed one sample; only reversals reach the stack, so plateaus and monotone runs cost nothing
+static int _feed_sample(RainflowStack *stack, RainflowResult *result, double value, int64_t index) {
+    if (!stack->has_pending) {
+        stack->pending_value = value;
+        stack->pending_index = index;
+        stack->has_pending = true;
+        stack->direction = 0;
+        return 0;
+    }
+    if (value == stack->pending_value) {
+        return 0;
+    }
+
+    int direction = (value > stack->pending_value) ? 1 : -1;
+    if (direction == stack->direction) {
+        stack->pending_value = value;
+        stack->pending_index = index;
+        return 0;
+    }
+
+    // The pending point is a reversal (or the start of the trace)
+    if (_push_turning_point(stack, result, stack->pending_value, stack->pending_index) != 0) {
+        return -1;
+    }
+    stack->pending_value = value;
+    stack->pending_index = index;
+    stack->direction = direction;
+    return 0;
+}
+
+// Count the final residue as half cycles between consecutive turning points
+static int _count_residue(RainflowStack *stack, RainflowResult *result) {
+    if (stack->has_pending && _push_turning_point(stack, result, stack->pending_value, stack->pending_index) != 0) {
+        return -1;
+    }
+    stack->has_pending = false;
+
+    for (int64_t i = 0; i + 1 < stack->size; i++) {
+        if (_append_cycle(result, stack->value[i], stack->value[i + 1], 0.5,
+                          stack->index[i], stack->index[i + 1]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void _free_stack(RainflowStack *stack) {
+    free(stack->value);
+    free(stack->index);
+    memset(stack, 0, sizeof(*stack));
+}
+
+// Each turning point opens at most one cycle, so the start index is a unique ordering key
+static int _compare_cycle_start(const void *a, const void *b) {
+    int64_t start_a = ((const RainflowTraceCycle*)a)->start;
+    int64_t start_b = ((const RainflowTraceCycle*)b)->start;
+    return (start_a > start_b) - (start_a < start_b);
+}
+
+// Count cycles over a SOC trace with the four-point method
+int rainflow_count(const double *soc, int64_t num_samples, RainflowResult *result) {
+    return rainflow_count_indexed(soc, NULL, num_samples, result);
+}
+
+// Count cycles over samples at the given sample indices (consecutive indices when sample_index is NULL)
+int rainflow_count_indexed(const double *soc, const int64_t *sample_index, int64_t num_samples, RainflowResult *result) {
+    RainflowStack stack;
+    memset(&stack, 0, sizeof(stack));
+    memset(result, 0, sizeof(*result));
+
+    int status = 0;
+    for (int64_t i = 0; i < num_samples && status == 0; i++) {
+        status = _feed_sample(&stack, result, soc[i], (sample_index != NULL) ? sample_index[i] : i);
+    }
+    if (status == 0) {
+        status = _count_residue(&stack, result);
+    }
+    _free_stack(&stack);
+
+    if (status != 0) {
+        rainflow_result_free(result);
+        return -1;
+    }
+    qsort(result->cycles, result->num_cycles, sizeof(RainflowTraceCycle), _compare_cycle_start);
+    return 0;
+}
+
+static void *_count_chunk(void *arg) {
+    RainflowChunk *chunk = (RainflowChunk*)arg;
+    for (int64_t i = chunk->first; i < chunk->last && chunk->status == 0; i++) {
+        chunk->status = _feed_sample(&chunk->stack, &chunk->result, chunk->soc[i], i);
+    }
+    return NULL;
+}
+
+// Count chunks concurrently, then count the concatenated chunk residues
+int rainflow_count_parallel(const double *soc, int64_t num_samples, int num_threads, RainflowResult *result) {
+    if (num_threads <= 1 || num_samples < 4 * (int64_t)num_threads) {
+        return rainflow_count(soc, num_samples, result);
+    }
+
+    memset(result, 0, sizeof(*result));
+    RainflowChunk *chunks = (RainflowChunk*)calloc(num_threads, sizeof(RainflowChunk));
+    pthread_t *threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+    bool *started = (bool*)calloc(num_threads, sizeof(bool));
+    if (chunks == NULL || threads == NULL || started == NULL) {
+        free(chunks);
+        free(threads);
+        free(started);
+        return -1;
+    }
+
+    for (int k = 0; k < num_threads; k++) {
+        chunks[k].soc = soc;
+        chunks[k].first = num_samples * k / num_threads;
+        chunks[k].last = num_samples * (k + 1) / num_threads;
+        // Fall back to counting in this thread if one cannot be started
+        started[k] = (pthread_create(&threads[k], NULL, _count_chunk, &chunks[k]) == 0);
+        if (!started[k]) {
+            _count_chunk(&chunks[k]);
+        }
+    }
+
+    int status = 0;
+    for (int k = 0; k < num_threads; k++) {
+        if (started[k]) {
+            pthread_join(threads[k], NULL);
+        }
+        if (chunks[k].status != 0) {
+            status = -1;
+        }
+    }
+
+    // A chunk's cycles only involve its own turning points; whatever it could not close is replayed in order,
+    // which closes exactly the cycles that span chunk boundaries
+    RainflowStack merge;
+    memset(&merge, 0, sizeof(merge));
+    for (int k = 0; k < num_threads && status == 0; k++) {
+        RainflowStack *residue = &chunks[k].stack;
+        for (int64_t i = 0; i < residue->size && status == 0; i++) {
+            status = _feed_sample(&merge, result, residue->value[i], residue->index[i]);
+        }
+        if (residue->has_pending && status == 0) {
+            status = _feed_sample(&merge, result, residue->pending_value, residue->pending_index);
+        }
+    }
+    if (status == 0) {
+        status = _count_residue(&merge, result);
+    }
+    _free_stack(&merge);
+
+    // Gather chunk cycles behind the boundary-spanning ones
+    int64_t total = result->num_cycles;
+    for (int k = 0; k < num_threads; k++) {
+        total += chunks[k].result.num_cycles;
+    }
+    if (status == 0 && total > result->capacity) {
+        RainflowTraceCycle *cycles = (RainflowTraceCycle*)realloc(result->cycles, total * sizeof(RainflowTraceCycle));
+        if (cycles == NULL) {
+            status = -1;
+        } else {
+            result->cycles = cycles;
+            result->capacity = total;
+        }
+    }
+    for (int k = 0; k < num_threads; k++) {
+        if (status == 0 && chunks[k].result.num_cycles > 0) {
+            memcpy(&result->cycles[result->num_cycles], chunks[k].result.cycles,
+                   chunks[k].result.num_cycles * sizeof(RainflowTraceCycle));
+            result->num_cycles += chunks[k].result.num_cycles;
+        }
+        rainflow_result_free(&chunks[k].result);
+        _free_stack(&chunks[k].stack);
+    }
+    free(chunks);
+    free(threads);
+    free(started);
+
+    if (status != 0) {
+        rainflow_result_free(result);
+        return -1;
+    }
+    qsort(result->cycles, result->num_cycles, sizeof(RainflowTraceCycle), _compare_cycle_start);
+    return 0;
+}
+
+// Release the cycle array
+void rainflow_result_free(RainflowResult *result) {
+    free(result->cycles);
+    memset(result, 0, sizeof(*result));
+}
+
+// Degradation cost of every counted cycle ($)
+double rainflow_degradation_cost(DemandResponseStrategy *strategy, const RainflowResult *result) {
+    double total = 0.0;
+    for (int64_t i = 0; i < result->num_cycles; i++) {
+        const RainflowTraceCycle *cycle = &result->cycles[i];
+        if (cycle->depth > 0.0) {
+            // calculate_degradation_cost is per kWh cycled, and a cycle moves depth * capacity kWh
+            total += cycle->count * calculate_degradation_cost(strategy, cycle->depth) *
+                     cycle->depth * strategy->battery_capacity;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,42 @@
+#ifndef RAINFLOW_H
+#define RAINFLOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "demand_response.h"
+
+// Cycle extracted from a SOC trace by rainflow counting
+typedef struct {
+    double depth;                   // SOC range of the cycle (0.0 to 1.0)
+    double mean_soc;                // Mean SOC of the cycle (0.0 to 1.0)
+    double count;                   // 1.0 for a closed cycle, 0.5 for a half cycle left in the residue
+    int64_t start;                  // Sample index of the turning point that opens the cycle
+    int64_t end;                    // Sample index of the turning point that closes it
+} RainflowTraceCycle;
+
+// Cycles counted over a whole trace, ordered by start index
+typedef struct {
+    RainflowTraceCycle *cycles;
+    int64_t num_cycles;
+    int64_t capacity;
+} RainflowResult;
+
+// Count cycles over a SOC trace with the four-point method; the final residue is counted as half cycles
+// Returns 0 on success, -1 on allocation failure; release the result with rainflow_result_free
+int rainflow_count(const double *soc, int64_t num_samples, RainflowResult *result);
+
+// Count cycles over a sparse trace given as samples and their sample indices (e.g. kept points of a compressed trace)
+int rainflow_count_indexed(const double *soc, const int64_t *sample_index, int64_t num_samples, RainflowResult *result);
+
+// Same counts as rainflow_count, computed on num_threads chunks concurrently
+// Each chunk leaves a residue of unclosed turning points; the residues are counted in order in a final pass
+int rainflow_count_parallel(const double *soc, int64_t num_samples, int num_threads, RainflowResult *result);
+
+// Release the cycle array
+void rainflow_result_free(RainflowResult *result);
+
+// Degradation cost of every counted cycle under the strategy's degradation model ($)
+double rainflow_degradation_cost(DemandResponseStrategy *strategy, const RainflowResult *result);
+
+#endif // RAINFLOW_H
@@ -0,0 +1,125 @@
+#include "rt_schedule.h"
+#include <time.h>
+
+// Order for rate-monotonic assignment: shorter period, then shorter deadline, then earlier in the table
+static bool _runs_before(const RtTask *tasks, int a, int b) {
+    if (tasks[a].period_us != tasks[b].period_us) {
+        return tasks[a].period_us < tasks[b].period_us;
+    }
+    if (tasks[a].deadline_us != tasks[b].deadline_us) {
+        return tasks[a].deadline_us < tasks[b].deadline_us;
+    }
+    return a < b;
+}
+
+// Assign rate-monotonic priorities
+void rt_assign_priorities(RtTask *tasks, int num_tasks, int base_priority) {
+    for (int i = 0; i < num_tasks; i++) {
+        // Count the tasks that run before this one; the fastest gets the highest priority
+        int ahead = 0;
+        for (int j = 0; j < num_tasks; j++) {
+            if (j != i && _runs_before(tasks, j, i)) {
+                ahead++;
+            }
+        }
+        tasks[i].priority = base_priority + (num_tasks - 1 - ahead);
+    }
+}
+
+// Tasks interfere unless they are pinned to disjoint cores
+static bool _shares_core(const RtTask *a, const RtTask *b) {
+    return a->core_mask == 0 || b->core_mask == 0 || (a->core_mask & b->core_mask) != 0;
+}
+
+// A short measured job (an empty queue, a minute with nothing to plan) says nothing about the expensive path, so a
+// measurement only ever raises the budget
+uint32_t rt_execution_time(const RtTask *task) {
+    return (task->wcet_us > task->budget_us) ? task->wcet_us : task->budget_us;
+}
+
+// Worst-case response-time analysis
+int rt_analyze(RtTask *tasks, int num_tasks) {
+    int unschedulable = 0;
+
+    for (int i = 0; i < num_tasks; i++) {
+        uint64_t own = (uint64_t)rt_execution_time(&tasks[i]) + tasks[i].blocking_us;
+        uint64_t response = own;
+
+        // Fixed-point iteration; the response only grows, so stop once it passes the deadline
+        for (;;) {
+            uint64_t next = own;
+            for (int j = 0; j < num_tasks; j++) {
+                if (j == i || tasks[j].priority <= tasks[i].priority || tasks[j].period_us == 0 ||
+                    !_shares_core(&tasks[i], &tasks[j])) {
+                    continue;
+                }
+                uint64_t releases = (response + tasks[j].period_us - 1) / tasks[j].period_us;
+                next += releases * rt_execution_time(&tasks[j]);
+            }
+            if (next == response || next > tasks[i].deadline_us) {
+                response = next;
+                break;
+            }
+            response = next;
+        }
+
+        tasks[i].response_bound_us = (response > tasks[i].deadline_us) ? UINT32_MAX : (uint32_t)response;
+        if (response > tasks[i].deadline_us) {
+            unschedulable++;
+        }
+    }
+    return unschedulable;
+}
+
+// Mark the start of a job
+void rt_job_start(RtTask *task, uint64_t now_us) {
+    // A job started before its release (timer rounding, or an event-triggered run) is released when it starts
+    if (task->next_release_us == 0 || task->next_release_us > now_us) {
+        task->next_release_us = now_us;
+    }
+    task->job_start_us = now_us;
+}
+
+// Mark the end of a job
+bool rt_job_finish(RtTask *task, uint64_t now_us) {
+    uint64_t execution = now_us - task->job_start_us;
+    uint64_t response = now_us - task->next_release_us;
+
+    // Start to finish includes preemption by higher-priority tasks, so it over-estimates the execution time and
+    // keeps the analysis on the safe side
+    if (execution > task->wcet_us) {
+        task->wcet_us = (execution > UINT32_MAX) ? UINT32_MAX : (uint32_t)execution;
+    }
+    task->last_response_us = (response > UINT32_MAX) ? UINT32_MAX : (uint32_t)response;
+    if (task->last_response_us > task->worst_response_us) {
+        task->worst_response_us = task->last_response_us;
+    }
+    task->jobs++;
+
+    bool missed = response > task->deadline_us;
+    if (missed) {
+        task->deadline_misses++;
+    }
+
+    // Releases are periodic, moved up to the shared wake grid; after an overrun, skip the releases that have already
+    // passed
+    task->next_release_us += task->period_us;
+    if (task->align_us > 0) {
+        task->next_release_us = (task->next_release_us + task->align_us - 1) / task->align_us * task->align_us;
+    }
+    while (task->period_us > 0 && task->next_release_us + task->period_us <= now_us) {
+        task->next_release_us += task->period_us;
+    }
+    return missed;
+}
+
+uint64_t rt_time_to_release(const RtTask *task, uint64_t now_us) {
+    return (task->next_release_us > now_us) ? task->next_release_us - now_us : 0;
+}
+
+// Monotonic clock in microseconds
+uint64_t rt_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
@@ -0,0 +1,55 @@
+#ifndef RT_SCHEDULE_H
+#define RT_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Timing of one periodic task for fixed-priority scheduling
+// Times are in microseconds; a period or deadline of up to ~70 minutes fits
+typedef struct {
+    const char *name;
+    uint32_t period_us;             // Release period
+    uint32_t deadline_us;           // Relative deadline (at most the period)
+    uint32_t budget_us;             // Worst-case execution time assumed; measurements can only raise it
+    uint32_t blocking_us;           // Longest time a lower-priority task can hold a resource this task needs
+    int priority;                   // Assigned by rt_assign_priorities (higher runs first)
+    uint32_t core_mask;             // Cores the task may run on (0 on a single-core build)
+    uint32_t align_us;              // Releases fall on multiples of this grid so tasks share wakeups (0 for none)
+
+    // Runtime monitoring
+    uint64_t next_release_us;       // Release time of the current or next job (0 before the first)
+    uint64_t job_start_us;          // Start of the running job
+    uint32_t wcet_us;               // Longest measured execution time
+    uint32_t last_response_us;      // Release to completion of the latest job
+    uint32_t worst_response_us;     // Longest measured response time
+    uint32_t response_bound_us;     // Worst-case response time from the latest analysis (UINT32_MAX if unbounded)
+    uint64_t jobs;                  // Completed jobs
+    uint32_t deadline_misses;       // Jobs that completed after their deadline
+} RtTask;
+
+// Assign rate-monotonic priorities: shorter period runs first, ties broken by deadline then table order
+// The longest-period task gets base_priority and each faster task one more
+void rt_assign_priorities(RtTask *tasks, int num_tasks, int base_priority);
+
+// Execution time used by the analysis: the budget, or the measured worst case if a job has ever exceeded it
+uint32_t rt_execution_time(const RtTask *task);
+
+// Worst-case response-time analysis: R = C + B + sum over higher-priority tasks j of ceil(R / Tj) * Cj
+// With core masks the analysis is per partition: only tasks sharing a core interfere
+// Fills response_bound_us for every task; returns the number of tasks whose bound exceeds their deadline
+int rt_analyze(RtTask *tasks, int num_tasks);
+
+// Mark the start of a job; a job starting before its release (the first, or one triggered by an event) is released
+// at its start
+void rt_job_start(RtTask *task, uint64_t now_us);
+
+// Mark the end of a job and advance to the next release; returns true if the job missed its deadline
+bool rt_job_finish(RtTask *task, uint64_t now_us);
+
+// Time from now until the next release (0 if it has passed)
+uint64_t rt_time_to_release(const RtTask *task, uint64_t now_us);
+
+// Monotonic clock in microseconds
+uint64_t rt_now_us(void);
+
+#endif // RT_SCHEDULE_H
@@ -0,0 +1,145 @@
+#include "settlement.h"
+#include <math.h>
+#include <string.h>
+
+// Default program rules
+void settlement_default_config(SettlementConfig *config) {
+    config->interval_seconds = 3600;
+    config->delivery_tolerance = 0.1;
+    config->shortfall_penalty = 0.5;
+}
+
+// Reconcile time-sorted streams in a single merge-join pass
+int settle_intervals(const SettlementConfig *config,
+                     const SettlementBid *bids, int num_bids,
+                     const SettlementAward *awards, int num_awards,
+                     const DispatchSetpoint *setpoints, int num_setpoints,
+                     const MeterSample *meter, int num_meter,
+                     SettlementInterval *intervals, int max_intervals, SettlementSummary *summary) {
+    int bid_index = 0;
+    int setpoint_index = 0;
+    int meter_index = 0;
+    double active_kw = 0.0;
+
+    for (int a = 0; a < num_awards; a++) {
+        time_t start = awards[a].start;
+        time_t end = start + config->interval_seconds;
+        SettlementInterval row;
+        memset(&row, 0, sizeof(row));
+        row.start = start;
+        row.awarded_kwh = awards[a].capacity_kwh;
+        row.clearing_price = awards[a].clearing_price;
+
+        // Bids: each stream cursor only moves forward, so the whole join is linear in total input size
+        while (bid_index < num_bids && bids[bid_index].start < start) {
+            bid_index++;
+        }
+        if (bid_index < num_bids && bids[bid_index].start == start) {
+            row.bid_kwh = bids[bid_index].capacity_kwh;
+            row.bid_price = bids[bid_index].price;
+        }
+
+        // Setpoints are piecewise constant; pick up the one in force at the interval start, then integrate
+        while (setpoint_index < num_setpoints && setpoints[setpoint_index].time <= start) {
+            active_kw = setpoints[setpoint_index].setpoint_kw;
+            setpoint_index++;
+        }
+        time_t t = start;
+        while (setpoint_index < num_setpoints && setpoints[setpoint_index].time < end) {
+            row.dispatched_kwh += active_kw * difftime(setpoints[setpoint_index].time, t) / 3600.0;
+            t = setpoints[setpoint_index].time;
+            active_kw = setpoints[setpoint_index].setpoint_kw;
+            setpoint_index++;
+        }
+        row.dispatched_kwh += active_kw * difftime(end, t) / 3600.0;
+
+        // Meter samples
+        while (meter_index < num_meter && meter[meter_index].time < start) {
+            meter_index++;
+        }
+        while (meter_index < num_meter && meter[meter_index].time < end) {
+            row.delivered_kwh += meter[meter_index].energy_kwh;
+            meter_index++;
+        }
+
+        // Only delivery up to the award is paid; shortfall beyond the tolerance is penalized
+        row.revenue = fmin(row.delivered_kwh, row.awarded_kwh) * row.clearing_price;
+        double shortfall = row.awarded_kwh * (1.0 - config->delivery_tolerance) - row.delivered_kwh;
+        row.penalty = (shortfall > 0.0) ? shortfall * config->shortfall_penalty : 0.0;
+
+        if (intervals != NULL && a < max_intervals) {
+            intervals[a] = row;
+        }
+
+        if (summary != NULL) {
+            summary->intervals++;
+            summary->awarded_kwh += row.awarded_kwh;
+            summary->delivered_kwh += row.delivered_kwh;
+            summary->revenue += row.revenue;
+            summary->penalty += row.penalty;
+        }
+    }
+
+    if (summary != NULL) {
+        summary->net_revenue = summary->revenue - summary->penalty;
+        summary->effective_price = (summary->delivered_kwh > 0.0) ?
+                                   summary->net_revenue / summary->delivered_kwh : 0.0;
+    }
+
+    return num_awards;
+}
+
+// Append a bid to a CSV journal
+int settlement_append_bid(FILE *journal, const SettlementBid *bid) {
+    if (fprintf(journal, "%ld,%.4f,%.6f\n", (long)bid->start, bid->capacity_kwh, bid->price) < 0) {
+        return -1;
+    }
+    return fflush(journal) == 0 ? 0 : -1;
+}
+
+// Append a dispatch setpoint to a CSV journal
+int settlement_append_setpoint(FILE *journal, const DispatchSetpoint *setpoint) {
+    if (fprintf(journal, "%ld,%.4f\n", (long)setpoint->time, setpoint->setpoint_kw) < 0) {
+        return -1;
+    }
+    return fflush(journal) == 0 ? 0 : -1;
+}
+
+// Load bids from a CSV journal, sorted by start with the last row for each start kept
+// Rows arrive nearly in order (fast DR rebids the current hour after the day-ahead plan), so insertion is cheap
+int settlement_load_bids(FILE *journal, SettlementBid *bids, int max_bids) {
+    int count = 0;
+    long start;
+    double capacity, price;
+
+    while (count < max_bids && fscanf(journal, "%ld,%lf,%lf", &start, &capacity, &price) == 3) {
+        int slot = count;
+        while (slot > 0 && bids[slot - 1].start > (time_t)start) {
+            slot--;
+        }
+        if (slot > 0 && bids[slot - 1].start == (time_t)start) {
+            slot--;
+        } else {
+            memmove(&bids[slot + 1], &bids[slot], (size_t)(count - slot) * sizeof(SettlementBid));
+            count++;
+        }
+        bids[slot].start = (time_t)start;
+        bids[slot].capacity_kwh = capacity;
+        bids[slot].price = price;
+    }
+    return count;
+}
+
+// Load dispatch setpoints from a CSV journal
+int settlement_load_setpoints(FILE *journal, DispatchSetpoint *setpoints, int max_setpoints) {
+    int count = 0;
+    long time_value;
+    double setpoint;
+
+    while (count < max_setpoints && fscanf(journal, "%ld,%lf", &time_value, &setpoint) == 2) {
+        setpoints[count].time = (time_t)time_value;
+        setpoints[count].setpoint_kw = setpoint;
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,88 @@
+#ifndef SETTLEMENT_H
+#define SETTLEMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// Bid as submitted to the utility for one settlement interval
+typedef struct {
+    time_t start;                   // Interval start
+    double capacity_kwh;            // Offered energy (kWh)
+    double price;                   // Offer price ($/kWh)
+} SettlementBid;
+
+// Award cleared by the utility for one settlement interval
+typedef struct {
+    time_t start;                   // Interval start
+    double capacity_kwh;            // Awarded energy (kWh)
+    double clearing_price;          // Clearing price ($/kWh)
+} SettlementAward;
+
+// Discharge setpoint written to register 0x210; holds until the next setpoint
+typedef struct {
+    time_t time;
+    double setpoint_kw;
+} DispatchSetpoint;
+
+// Metered delivery (load reduction or export) over one meter sample
+typedef struct {
+    time_t time;                    // Sample start
+    double energy_kwh;              // Energy delivered during the sample (kWh)
+} MeterSample;
+
+// Settlement program rules
+typedef struct {
+    int interval_seconds;           // Settlement interval length (e.g. 3600)
+    double delivery_tolerance;      // Fraction of the award that may go undelivered without penalty
+    double shortfall_penalty;       // Penalty per kWh delivered short beyond the tolerance ($/kWh)
+} SettlementConfig;
+
+// Reconciled result for one awarded interval
+typedef struct {
+    time_t start;
+    double bid_kwh;                 // Offered energy, zero if no matching bid
+    double bid_price;
+    double awarded_kwh;
+    double clearing_price;
+    double dispatched_kwh;          // Setpoint integrated over the interval
+    double delivered_kwh;           // Metered delivery
+    double revenue;                 // Credited delivery at the clearing price ($)
+    double penalty;                 // Shortfall penalty ($)
+} SettlementInterval;
+
+// Running totals across settled intervals
+typedef struct {
+    int intervals;
+    double awarded_kwh;
+    double delivered_kwh;
+    double revenue;
+    double penalty;
+    double net_revenue;
+    double effective_price;         // Net revenue per delivered kWh ($/kWh)
+} SettlementSummary;
+
+// Default program rules: hourly intervals, 10% tolerance, shortfall charged at $0.50/kWh
+void settlement_default_config(SettlementConfig *config);
+
+// Reconcile time-sorted streams in a single merge-join pass, one output row per award
+// May be called on consecutive chunks split at award boundaries; summary accumulates across calls (zero it first)
+// intervals (optional) receives up to max_intervals rows; returns the number of awards settled
+int settle_intervals(const SettlementConfig *config,
+                     const SettlementBid *bids, int num_bids,
+                     const SettlementAward *awards, int num_awards,
+                     const DispatchSetpoint *setpoints, int num_setpoints,
+                     const MeterSample *meter, int num_meter,
+                     SettlementInterval *intervals, int max_intervals, SettlementSummary *summary);
+
+// Append records to a CSV journal so the gateway keeps what it bid and dispatched; returns 0 on success
+int settlement_append_bid(FILE *journal, const SettlementBid *bid);
+int settlement_append_setpoint(FILE *journal, const DispatchSetpoint *setpoint);
+
+// Load a CSV journal written by the append functions; returns the number of records read
+// Bids come back sorted by start with one per start, the last journaled, as settle_intervals expects
+int settlement_load_bids(FILE *journal, SettlementBid *bids, int max_bids);
+int settlement_load_setpoints(FILE *journal, DispatchSetpoint *setpoints, int max_setpoints);
+
+#endif // SETTLEMENT_H
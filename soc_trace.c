@@ -0,0 +1,127 @@
+#include "soc_trace.h"
+#include <math.h>
+#include <string.h>
+
+static void _keep_point(SocTraceCompressor *compressor, int64_t index, double soc) {
+    compressor->sink(index, soc, compressor->context);
+    compressor->anchor_index = index;
+    compressor->anchor_soc = soc;
+    compressor->kept++;
+}
+
+// Keep the latest sample, preceded by the start of its plateau so a plateau is always entered at its first sample
+static void _keep_last(SocTraceCompressor *compressor) {
+    if (compressor->run_start > compressor->anchor_index && compressor->run_start < compressor->last_index) {
+        _keep_point(compressor, compressor->run_start, compressor->last_soc);
+    }
+    _keep_point(compressor, compressor->last_index, compressor->last_soc);
+}
+
+// Initialize a compressor
+void soc_trace_init(SocTraceCompressor *compressor, double tolerance, SocTraceSink sink, void *context) {
+    memset(compressor, 0, sizeof(*compressor));
+    compressor->tolerance = fmax(tolerance, 0.0);
+    compressor->sink = sink;
+    compressor->context = context;
+}
+
+// Add one sample
+void soc_trace_add(SocTraceCompressor *compressor, int64_t index, double soc) {
+    compressor->samples++;
+
+    if (!compressor->started) {
+        compressor->started = true;
+        _keep_point(compressor, index, soc);
+        compressor->last_index = index;
+        compressor->last_soc = soc;
+        compressor->run_start = index;
+        compressor->direction = 0;
+        compressor->slope_low = -INFINITY;
+        compressor->slope_high = INFINITY;
+        return;
+    }
+
+    bool changed = (soc != compressor->last_soc);
+    int direction = (soc > compressor->last_soc) ? 1 : -1;
+
+    // A reversal is kept exactly, at the first sample of its plateau, as rainflow counting sees it
+    if (changed && compressor->direction != 0 && direction != compressor->direction &&
+        compressor->run_start > compressor->anchor_index) {
+        _keep_point(compressor, compressor->run_start, compressor->last_soc);
+
+        // The rest of the plateau constrains the door from the new anchor
+        int64_t span = compressor->last_index - compressor->run_start;
+        compressor->slope_low = (span > 0) ? -compressor->tolerance / span : -INFINITY;
+        compressor->slope_high = (span > 0) ? compressor->tolerance / span : INFINITY;
+    }
+
+    // Swinging door: the sample extends the current segment if the line to it stays within tolerance of every
+    // sample since the anchor; otherwise the previous sample closes the segment
+    double span = (double)(index - compressor->anchor_index);
+    double slope = (soc - compressor->anchor_soc) / span;
+    if (slope < compressor->slope_low || slope > compressor->slope_high) {
+        _keep_last(compressor);
+        span = (double)(index - compressor->anchor_index);
+        compressor->slope_low = (soc - compressor->tolerance - compressor->anchor_soc) / span;
+        compressor->slope_high = (soc + compressor->tolerance - compressor->anchor_soc) / span;
+    } else {
+        compressor->slope_low = fmax(compressor->slope_low, (soc - compressor->tolerance - compressor->anchor_soc) / span);
+        compressor->slope_high = fmin(compressor->slope_high, (soc + compressor->tolerance - compressor->anchor_soc) / span);
+    }
+
+    if (changed) {
+        compressor->direction = direction;
+        compressor->run_start = index;
+    }
+    compressor->last_index = index;
+    compressor->last_soc = soc;
+}
+
+// Keep the final samples
+void soc_trace_flush(SocTraceCompressor *compressor) {
+    if (compressor->started && compressor->last_index > compressor->anchor_index) {
+        _keep_last(compressor);
+    }
+    compressor->started = false;
+}
+
+// Rebuild samples by linear interpolation between kept points
+void soc_trace_reconstruct(const int64_t *point_index, const double *point_soc, int64_t num_points,
+                           int64_t first_index, int64_t num_samples, double *samples) {
+    if (num_points <= 0) {
+        return;
+    }
+
+    // Samples are in order, so the bracketing segment only moves forward
+    int64_t segment = 0;
+    for (int64_t i = 0; i < num_samples; i++) {
+        int64_t index = first_index + i;
+        while (segment + 1 < num_points && point_index[segment + 1] <= index) {
+            segment++;
+        }
+
+        if (index <= point_index[0]) {
+            samples[i] = point_soc[0];
+        } else if (segment + 1 >= num_points) {
+            samples[i] = point_soc[num_points - 1];
+        } else {
+            double fraction = (double)(index - point_index[segment]) /
+                              (double)(point_index[segment + 1] - point_index[segment]);
+            samples[i] = point_soc[segment] + fraction * (point_soc[segment + 1] - point_soc[segment]);
+        }
+    }
+}
+
+// Load kept points from CSV
+int64_t soc_trace_load(FILE *file, int64_t *point_index, double *point_soc, int64_t max_points) {
+    int64_t count = 0;
+    long long index;
+    double soc;
+
+    while (count < max_points && fscanf(file, "%lld,%lf", &index, &soc) == 2) {
+        point_index[count] = (int64_t)index;
+        point_soc[count] = soc;
+        count++;
+    }
+    return count;
+}
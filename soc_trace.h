@@ -0,0 +1,49 @@
+#ifndef SOC_TRACE_H
+#define SOC_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Receives each kept point of a compressed trace, in order
+typedef void (*SocTraceSink)(int64_t index, double soc, void *context);
+
+// Streaming SOC trace compressor
+// Keeps every SOC reversal at its exact value and sample index, so rainflow counts over the kept points equal those
+// over the raw trace, and otherwise keeps just enough samples (swinging door) that linear interpolation between kept
+// points stays within the tolerance of every raw sample. Constant memory and time per sample.
+typedef struct {
+    double tolerance;               // Maximum reconstruction error (SOC fraction)
+    SocTraceSink sink;
+    void *context;
+
+    bool started;
+    int64_t anchor_index;           // Last kept point
+    double anchor_soc;
+    int64_t last_index;             // Latest sample, not yet kept
+    double last_soc;
+    int64_t run_start;              // First sample of the run of equal values ending at last_index
+    int direction;                  // Direction of the latest change: +1, -1, or 0 before the first
+    double slope_low;               // Door: slopes from the anchor within tolerance of every sample since it
+    double slope_high;
+    int64_t kept;                   // Points passed to the sink
+    int64_t samples;                // Samples added
+} SocTraceCompressor;
+
+// Initialize a compressor; sink receives kept points as they are decided
+void soc_trace_init(SocTraceCompressor *compressor, double tolerance, SocTraceSink sink, void *context);
+
+// Add one sample; indices must increase (e.g. seconds since epoch)
+void soc_trace_add(SocTraceCompressor *compressor, int64_t index, double soc);
+
+// Keep the final samples so the trace can be closed or handed over; the compressor can then be re-initialized
+void soc_trace_flush(SocTraceCompressor *compressor);
+
+// Rebuild num_samples samples starting at first_index by linear interpolation between kept points
+void soc_trace_reconstruct(const int64_t *point_index, const double *point_soc, int64_t num_points,
+                           int64_t first_index, int64_t num_samples, double *samples);
+
+// Load kept points from CSV lines of "index,soc" (as journaled by the gateway); returns the number read
+int64_t soc_trace_load(FILE *file, int64_t *point_index, double *point_soc, int64_t max_points);
+
+#endif // SOC_TRACE_H
@@ -0,0 +1,66 @@
+#include "spsc_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Allocate a queue
+int spsc_queue_init(SpscQueue *queue, uint32_t capacity, size_t message_size) {
+    // A power-of-two size lets the free-running indices wrap with a mask
+    uint32_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    queue->slots = (unsigned char*)malloc((size_t)slots * message_size);
+    if (queue->slots == NULL) {
+        return -1;
+    }
+    queue->capacity = slots;
+    queue->message_size = message_size;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->dropped, 0);
+    return 0;
+}
+
+void spsc_queue_free(SpscQueue *queue) {
+    free(queue->slots);
+    queue->slots = NULL;
+    queue->capacity = 0;
+}
+
+// Copy a message in (producer)
+bool spsc_queue_push(SpscQueue *queue, const void *message) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail >= queue->capacity) {
+        atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(queue->slots + (size_t)(head & (queue->capacity - 1)) * queue->message_size, message, queue->message_size);
+
+    // Release publishes the message before the consumer can see the new head
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Copy the oldest message out (consumer)
+bool spsc_queue_pop(SpscQueue *queue, void *message) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(message, queue->slots + (size_t)(tail & (queue->capacity - 1)) * queue->message_size, queue->message_size);
+
+    // Release hands the slot back only after it has been copied out
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+uint32_t spsc_queue_size(SpscQueue *queue) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,38 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define SPSC_CACHE_LINE_SIZE 64
+
+// Lock-free single-producer single-consumer ring of fixed-size messages
+// One task (or core) pushes and one pops; neither ever blocks or takes a lock, so a stalled consumer can only cause
+// pushes to fail, never delay the producer. The indices sit on separate cache lines so the two cores don't share one.
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE_SIZE) _Atomic uint32_t head; // Next slot to write (producer only)
+    _Alignas(SPSC_CACHE_LINE_SIZE) _Atomic uint32_t tail; // Next slot to read (consumer only)
+    _Alignas(SPSC_CACHE_LINE_SIZE) uint32_t capacity;     // Slots (a power of two)
+    size_t message_size;
+    unsigned char *slots;
+    _Atomic uint32_t dropped;       // Pushes rejected because the ring was full
+} SpscQueue;
+
+// Allocate a queue holding at least capacity messages; returns 0 on success, -1 on allocation failure
+int spsc_queue_init(SpscQueue *queue, uint32_t capacity, size_t message_size);
+
+// Free queue storage
+void spsc_queue_free(SpscQueue *queue);
+
+// Copy a message in (producer); returns false and counts a drop if the queue is full
+bool spsc_queue_push(SpscQueue *queue, const void *message);
+
+// Copy the oldest message out (consumer); returns false if the queue is empty
+bool spsc_queue_pop(SpscQueue *queue, void *message);
+
+// Messages currently queued (approximate while the other side is running)
+uint32_t spsc_queue_size(SpscQueue *queue);
+
+#endif // SPSC_QUEUE_H
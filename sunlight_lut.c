@@ -1,12 +1,26 @@
 #include "sunlight_lut.h"
 #include "demand_response.h" // Include the DemandResponseStrategy header
+#include "cbp_planner.h" // Joint charge/discharge planning
+#include "tariff.h" // Compiled TOU/CPP/NEM rate schedule
+#include "baseline.h" // Customer baseline for CBP measurement and verification
+#include "settlement.h" // Bid and dispatch journals for settlement
+#include "load_forecast.h" // Household load forecast for behind-the-meter bids
+#include "pv_forecast.h" // Weather-adjusted PV production forecast
+#include "inverter.h" // Inverter power, ramp and temperature limits
+#include "soc_trace.h" // Compressed SOC history for degradation analysis
+#include "spsc_queue.h" // Lock-free hand-off of bids between cores
 #include <modbus.h> // Include the Modbus library for RS-485 communication
 #include <curl/curl.h> // For HTTP API calls to the utility's limit order book
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef GATEWAY_LINUX_RUNTIME
 #include <FreeRTOS.h>
 #include <task.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
 
 // LUT arrays to hold sunrise and sunset times
 double sunriseTable[DAYS_IN_YEAR];
@@ -18,11 +32,262 @@ modbus_t *ctx;
 // DemandResponseStrategy instance
 DemandResponseStrategy dr_strategy;
 
-// Price forecast storage
-double price_forecast[24] = {0};
-double grid_demand_forecast[24] = {0};
-int num_competitors = 10; // Default value
+// Customer baseline built from site meter intervals
+CustomerBaseline site_baseline;
+#define METER_INTERVAL_SECONDS 900  // 15-minute meter intervals
 
+// Household load profiles learned from the same meter intervals
+LoadForecaster load_forecaster;
+
+// Inverter limits shared by bid sizing and the 0x210 setpoint writer
+InverterCapability inverter;
+
+// PV forecast from clear-sky irradiance and the local weather file
+PvForecast pv_forecast;
+bool pv_forecast_ready = false;
+
+// Periodic task timing, indexed by GatewayTaskId
+// Budgets cover a blocking Modbus transaction or curl request, and measured jobs only ever raise them; the SOC latch in
+// SpoofSOC has the tightest deadline so it is never held behind bidding or market data fetches. Every release falls
+// on the same one-second grid, so the minute-level tasks wake together with the per-second ones.
+// The RTOS curl budgets follow the request timeouts, so even a single core passes the response-time analysis: the
+// per-second tasks take at most 750 ms of each second, leaving CapacityBidding a 20 s bound and MarketDataUpdate 36 s.
+RtTask taskTiming[NUM_GATEWAY_TASKS] = {
+    [TASK_SPOOF_SOC] = {.name = "SpoofSOC", .period_us = 1000000, .deadline_us = 250000, .budget_us = 50000,
+        .align_us = TASK_WAKE_GRID_US},
+    [TASK_FAST_DR_DISPATCH] = {.name = "FastDRDispatch", .period_us = 1000000, .deadline_us = 1000000, .budget_us = 200000,
+        .align_us = TASK_WAKE_GRID_US},
+    [TASK_CAPACITY_BIDDING] = {.name = "CapacityBidding", .period_us = 60000000, .deadline_us = 60000000,
+        .budget_us = CAPACITY_BIDDING_BUDGET_US, .align_us = TASK_WAKE_GRID_US},
+    [TASK_MARKET_DATA_UPDATE] = {.name = "MarketDataUpdate", .period_us = 60000000, .deadline_us = 60000000,
+        .budget_us = MARKET_DATA_BUDGET_US, .align_us = TASK_WAKE_GRID_US},
+    [TASK_BID_SUBMISSION] = {.name = "BidSubmission", .period_us = 1000000, .deadline_us = 1000000,
+        .budget_us = BID_SUBMISSION_BUDGET_US, .align_us = TASK_WAKE_GRID_US},
+};
+
+// A bid handed from a control or planning task to BidSubmission
+typedef struct {
+    bool day_ahead;                 // Day-ahead CBP bid rather than a fast DR bid
+    int hour;                       // Delivery hour of a day-ahead bid
+    double capacity;                // kWh
+    double price;                   // $/kWh
+} BidMessage;
+
+// One queue per producer keeps each single-producer single-consumer
+SpscQueue fastBidQueue;             // FastDRDispatch -> BidSubmission
+SpscQueue dayAheadBidQueue;         // CapacityBidding -> BidSubmission
+
+// Market data as last fetched, with the tariff to price it against
+// The network core owns the working copy; the control and planning cores each price against their own copy, so no
+// core ever reads data another is writing
+typedef struct {
+    uint32_t sequence;              // Publication number, 0 before the first
+    time_t fetched;                 // When the utility last answered, 0 if it never has
+    double price_forecast[24];
+    double grid_demand_forecast[24];
+    int num_competitors;
+    const CompiledTariff *tariff;   // Compiled rates for the current year (NULL uses built-in day/night rates)
+} MarketSnapshot;
+
+// Cores holding a copy of the market data, each acknowledging the newest snapshot it has moved to
+typedef enum {
+    MARKET_READER_CONTROL,
+    MARKET_READER_PLANNING,
+    NUM_MARKET_READERS
+} MarketReader;
+
+#define MARKET_QUEUE_LENGTH 4       // Hourly snapshots buffered per reader
+
+SpscQueue controlMarketQueue;       // MarketDataUpdate -> FastDRDispatch
+SpscQueue planningMarketQueue;      // MarketDataUpdate -> CapacityBidding
+static _Atomic uint32_t marketSeen[NUM_MARKET_READERS];
+
+// Control-core models the day-ahead planner reads, copied whole at every meter interval
+// Pointers inside are the control core's and are rebound to the copy by the planner
+typedef struct {
+    DemandResponseStrategy strategy;
+    DemandResponseConfig config;    // Without the cycle history, which only the control core touches
+    InverterCapability inverter;
+    CustomerBaseline baseline;
+    LoadForecaster load_forecast;
+    bool has_baseline;
+    bool has_load_forecast;
+} PlanningState;
+
+#define PLANNING_QUEUE_LENGTH 2     // Copies buffered; the planner drains them every minute
+
+SpscQueue planningStateQueue;       // SpoofSOC -> CapacityBidding
+
+// Idle residency, fed by the tickless idle hooks or the Linux event loop
+IdleStats idleStats;
+
+// Stack and heap use per task, indexed by GatewayTaskId, and of the whole heap
+TaskMemory taskMemory[NUM_GATEWAY_TASKS];
+HeapMonitor heapMonitor;
+
+// Timeline per task, indexed by GatewayTaskId, and on RTOS per core, exported to TRACE_PATH
+TraceRing traceRings[NUM_TRACE_RINGS];
+TraceClock traceClock;
+static _Atomic int32_t traceIds;
+
+#ifdef GATEWAY_LINUX_RUNTIME
+// Timeline of the job the event loop is running, or NULL between jobs
+TraceRing *runningTrace;
+
+TraceRing *currentTrace(void) {
+    return runningTrace;
+}
+#else
+// Timeline of the calling task, or NULL outside the task table
+TraceRing *currentTrace(void) {
+    return (TraceRing*)pvTaskGetThreadLocalStoragePointer(NULL, TRACE_TLS_INDEX);
+}
+
+static const char *schedulerTraceNames[TRACE_SCHEDULER_CORES] = {"core 0", "core 1", "core 2", "core 3"};
+
+// Timeline of the core the scheduler is switching on
+static TraceRing *schedulerTrace(void) {
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1)
+    UBaseType_t core = portGET_CORE_ID();
+#else
+    UBaseType_t core = 0;
+#endif
+    return (core < TRACE_SCHEDULER_CORES) ? &traceRings[NUM_GATEWAY_TASKS + core] : NULL;
+}
+
+// Scheduler hooks: map traceTASK_SWITCHED_IN() / traceTASK_SWITCHED_OUT() to these in FreeRTOSConfig.h
+// They record on the switching core's timeline, never the task's: the task being switched out may be inside its own
+// trace_event. Only that core's scheduler writes its timeline, so each ring has one writer at a time
+void gatewayTraceSwitchedIn(void) {
+    TraceRing *task = currentTrace();
+    if (task != NULL) {
+        trace_begin(schedulerTrace(), TRACE_SCHEDULER, task->name, (int32_t)(task - traceRings));
+    }
+}
+
+void gatewayTraceSwitchedOut(void) {
+    TraceRing *task = currentTrace();
+    if (task != NULL) {
+        trace_end(schedulerTrace(), TRACE_SCHEDULER, task->name, (int32_t)(task - traceRings));
+    }
+}
+#endif
+
+// Health and economics metrics, updated lock-free by the jobs and scraped from METRICS_PORT
+typedef struct {
+    MetricGauge soc;
+    MetricGauge battery_temperature;
+    MetricGauge dr_active;
+    MetricGauge equivalent_cycles;
+    MetricCounter fast_bids;
+    MetricCounter day_ahead_bids;
+    MetricCounter dropped_bids;
+    MetricCounter accepted_bids;
+    MetricCounter rejected_bids;
+    MetricCounter failed_bids;
+    MetricCounter modbus_reads;
+    MetricCounter modbus_read_errors;
+    MetricCounter modbus_writes;
+    MetricCounter modbus_write_errors;
+    MetricHistogram bid_latency;
+    MetricHistogram market_data_latency;
+} GatewayMetrics;
+
+static GatewayMetrics metrics;
+static const double httpLatencyBounds[] = {0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0};
+
+static const MetricDescriptor metricTable[] = {
+    {"opencbp_soc_ratio", "Filtered battery state of charge (0 to 1)", NULL, METRIC_GAUGE, &metrics.soc},
+    {"opencbp_battery_temperature_celsius", "Battery temperature", NULL, METRIC_GAUGE, &metrics.battery_temperature},
+    {"opencbp_dr_active", "1 while the VTN has a DR event active", NULL, METRIC_GAUGE, &metrics.dr_active},
+    {"opencbp_battery_cycles", "Equivalent full cycles counted for degradation", NULL, METRIC_GAUGE,
+     &metrics.equivalent_cycles},
+    {"opencbp_bids_total", "Bids queued for submission", "kind=\"fast\"", METRIC_COUNTER, &metrics.fast_bids},
+    {"opencbp_bids_total", "Bids queued for submission", "kind=\"day_ahead\"", METRIC_COUNTER,
+     &metrics.day_ahead_bids},
+    {"opencbp_bids_dropped_total", "Bids dropped because the submission queue was full", NULL, METRIC_COUNTER,
+     &metrics.dropped_bids},
+    {"opencbp_bid_posts_total", "Bid submissions by outcome", "result=\"accepted\"", METRIC_COUNTER,
+     &metrics.accepted_bids},
+    {"opencbp_bid_posts_total", "Bid submissions by outcome", "result=\"rejected\"", METRIC_COUNTER,
+     &metrics.rejected_bids},
+    {"opencbp_bid_posts_total", "Bid submissions by outcome", "result=\"failed\"", METRIC_COUNTER,
+     &metrics.failed_bids},
+    {"opencbp_modbus_transactions_total", "Modbus transactions", "op=\"read\"", METRIC_COUNTER, &metrics.modbus_reads},
+    {"opencbp_modbus_transactions_total", "Modbus transactions", "op=\"write\"", METRIC_COUNTER,
+     &metrics.modbus_writes},
+    {"opencbp_modbus_errors_total", "Failed Modbus transactions", "op=\"read\"", METRIC_COUNTER,
+     &metrics.modbus_read_errors},
+    {"opencbp_modbus_errors_total", "Failed Modbus transactions", "op=\"write\"", METRIC_COUNTER,
+     &metrics.modbus_write_errors},
+    {"opencbp_http_request_duration_seconds", "Utility API request latency", "request=\"bid\"", METRIC_HISTOGRAM,
+     &metrics.bid_latency},
+    {"opencbp_http_request_duration_seconds", "Utility API request latency", "request=\"market_data\"",
+     METRIC_HISTOGRAM, &metrics.market_data_latency},
+};
+
+// Scrapes render into this one buffer, so serving never allocates
+static char metricsBuffer[METRICS_BUFFER_SIZE];
+
+// Answer one scrape on a connected socket; only one caller at a time
+int serveMetrics(int client) {
+    return metrics_serve(client, metricsBuffer, sizeof(metricsBuffer), metricTable,
+                         (int)(sizeof(metricTable) / sizeof(metricTable[0])));
+}
+
+// Record the outcome of a bid POST: any 2xx status means the utility accepted it
+void recordBidPost(bool delivered, long status, uint64_t elapsed_us) {
+    metric_histogram_observe(&metrics.bid_latency, elapsed_us / 1e6);
+    if (!delivered) {
+        metric_counter_add(&metrics.failed_bids, 1);
+    } else if (status >= 200 && status < 300) {
+        metric_counter_add(&metrics.accepted_bids, 1);
+    } else {
+        metric_counter_add(&metrics.rejected_bids, 1);
+    }
+}
+
+void recordMarketDataFetch(uint64_t elapsed_us) {
+    metric_histogram_observe(&metrics.market_data_latency, elapsed_us / 1e6);
+}
+
+// Id pairing the two ends of an async trace span
+int32_t nextTraceId(void) {
+    return atomic_fetch_add_explicit(&traceIds, 1, memory_order_relaxed);
+}
+
+// Modbus transactions, timed on the calling task's timeline; return -1 on failure like libmodbus
+int readRegister(int address, uint16_t *value) {
+    TraceRing *trace = currentTrace();
+    trace_begin(trace, TRACE_MODBUS, "modbus read", address);
+    int result = modbus_read_input_registers(ctx, address, 1, value);
+    trace_end(trace, TRACE_MODBUS, "modbus read", result);
+    metric_counter_add(&metrics.modbus_reads, 1);
+    if (result == -1) {
+        metric_counter_add(&metrics.modbus_read_errors, 1);
+    }
+    return result;
+}
+
+int writeRegister(int address, uint16_t value) {
+    TraceRing *trace = currentTrace();
+    trace_begin(trace, TRACE_MODBUS, "modbus write", address);
+    int result = modbus_write_register(ctx, address, value);
+    trace_end(trace, TRACE_MODBUS, "modbus write", result);
+    metric_counter_add(&metrics.modbus_writes, 1);
+    if (result == -1) {
+        metric_counter_add(&metrics.modbus_write_errors, 1);
+    }
+    return result;
+}
+
+// Market data being fetched, owned by the network core
+static MarketSnapshot marketData = {.num_competitors = 10};
+
+// Compiled tariffs by year parity: the current year's, and last year's until no reader can still hold it
+static CompiledTariff tariffs[2];
+static bool tariffCompiled[2];
+static uint32_t tariffLastSequence[2];  // Newest snapshot carrying each
 
 // Generate the LUT for sunrise and sunset times
 void generateSunlightLUT() {
@@ -31,7 +296,7 @@ void generateSunlightLUT() {
         double declination = -23.44 * cos((2 * M_PI / 365.0) * (day + 10));
 
         // Calculate solar noon (in hours)
-        double solarNoon = 12.0 - (LONGITUDE / 15.0) - TIMEZONE_OFFSET;
+        double solarNoon = 12.0 - (LONGITUDE / 15.0) + TIMEZONE_OFFSET;
 
         // Calculate hour angle (in degrees)
         double hourAngle = acos(-tan(LATITUDE * M_PI / 180.0) * tan(declination * M_PI / 180.0)) * 180.0 / M_PI;
@@ -46,17 +311,35 @@ void generateSunlightLUT() {
 void getSunlightHours(double *sunrise, double *sunset) {
     // Get the current date
     time_t currentTime = time(NULL);
-    struct tm *localTime = localtime(&currentTime);
+    struct tm localTime;
+    localtime_r(&currentTime, &localTime);
 
     // Calculate the day of the year (0-364 for indexing)
-    int dayOfYear = localTime->tm_yday;
+    int dayOfYear = localTime.tm_yday;
 
     // Retrieve values from LUT
     *sunrise = sunriseTable[dayOfYear];
     *sunset = sunsetTable[dayOfYear];
 }
 
-// Function to fetch price forecasts from utility API
+// Estimate hourly PV energy (kWh) for a day from the sunrise/sunset LUT
+void getSolarEnergyProfile(int dayOfYear, double *hourlyEnergy) {
+    double sunrise = sunriseTable[dayOfYear];
+    double sunset = sunsetTable[dayOfYear];
+    double daylight = sunset - sunrise;
+
+    for (int hour = 0; hour < 24; hour++) {
+        // Clear-sky half-sine irradiance sampled at the middle of the hour
+        double t = hour + 0.5;
+        if (t <= sunrise || t >= sunset) {
+            hourlyEnergy[hour] = 0.0;
+        } else {
+            hourlyEnergy[hour] = PV_PEAK_KW * sin(M_PI * (t - sunrise) / daylight);
+        }
+    }
+}
+
+// Function to fetch price forecasts from utility API; runs on the network core, or in initGateway before any task
 size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
     char *data = (char *)contents;
@@ -65,10 +348,11 @@ size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     char *price_start = strstr(data, "\"prices\":[");
     if (price_start) {
         price_start += 10; // Skip "\"prices\":["
+        marketData.fetched = time(NULL);
         
         // Parse prices
         for (int i = 0; i < 24 && price_start != NULL; i++) {
-            price_forecast[i] = strtod(price_start, &price_start);
+            marketData.price_forecast[i] = strtod(price_start, &price_start);
             price_start = strchr(price_start, ',');
             if (price_start) price_start++;
         }
@@ -81,7 +365,7 @@ size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
         
         // Parse demand values
         for (int i = 0; i < 24 && demand_start != NULL; i++) {
-            grid_demand_forecast[i] = strtod(demand_start, &demand_start);
+            marketData.grid_demand_forecast[i] = strtod(demand_start, &demand_start);
             demand_start = strchr(demand_start, ',');
             if (demand_start) demand_start++;
         }
@@ -91,12 +375,257 @@ size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     char *comp_start = strstr(data, "\"competitors\":");
     if (comp_start) {
         comp_start += 14; // Skip "\"competitors\":"
-        num_competitors = (int)strtol(comp_start, NULL, 10);
+        marketData.num_competitors = (int)strtol(comp_start, NULL, 10);
     }
     
     return realsize;
 }
 
+// Journal a submitted bid so settlement can reconcile it later
+void journalBid(time_t intervalStart, double capacity, double price) {
+    FILE *journal = fopen(BID_JOURNAL_PATH, "a");
+    if (journal) {
+        SettlementBid bid = {intervalStart, capacity, price};
+        settlement_append_bid(journal, &bid);
+        fclose(journal);
+    }
+}
+
+// Last setpoint journaled; settlement holds a setpoint until the next row, so repeats are not written
+static double journaledSetpointKw = -1.0;
+
+// Journal a discharge setpoint written to register 0x210 when it changes
+void journalSetpoint(time_t when, double setpointKw) {
+    if (setpointKw == journaledSetpointKw) {
+        return;
+    }
+    journaledSetpointKw = setpointKw;
+    FILE *journal = fopen("/var/log/opencbp_setpoints.csv", "a");
+    if (journal) {
+        DispatchSetpoint setpoint = {when, setpointKw};
+        settlement_append_setpoint(journal, &setpoint);
+        fclose(journal);
+    }
+}
+
+// Energy already bid into each hour of the day starting at dayStart (kWh); the last bid journaled for an hour stands
+// There is no award feed, so every submitted bid counts as committed
+void loadCommittedBids(time_t dayStart, double *commitment) {
+    memset(commitment, 0, 24 * sizeof(double));
+    FILE *journal = fopen(BID_JOURNAL_PATH, "r");
+    if (journal == NULL) {
+        return;
+    }
+    SettlementBid bids[64];
+    int count;
+    while ((count = settlement_load_bids(journal, bids, 64)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (bids[i].start >= dayStart && bids[i].start < dayStart + 24 * 3600) {
+                commitment[(bids[i].start - dayStart) / 3600] = bids[i].capacity_kwh;
+            }
+        }
+    }
+    fclose(journal);
+}
+
+// A kept SOC history point on its way from SpoofSOC to the journal
+typedef struct {
+    int64_t time;
+    double soc;
+} SocJournalPoint;
+
+// Kept points cross from the control core to the network core, which owns the journal file
+SpscQueue socJournalQueue;          // SpoofSOC -> MarketDataUpdate
+
+// Write the queued SOC history points in one file append; runs on the network core
+void flushSocJournal(void) {
+    SocJournalPoint point;
+    if (!spsc_queue_pop(&socJournalQueue, &point)) {
+        return;
+    }
+    FILE *journal = fopen(SOC_TRACE_PATH, "a");
+    do {
+        if (journal) {
+            fprintf(journal, "%lld,%.4f\n", (long long)point.time, point.soc);
+        }
+    } while (spsc_queue_pop(&socJournalQueue, &point));
+    if (journal) {
+        fclose(journal);
+    }
+}
+
+// Queue a kept point of the compressed SOC history for the minute-level journal write
+// SpoofSOC keeps at most one point a second, so a queue of SOC_JOURNAL_BUFFER only fills if the network core stalls
+void journalSocPoint(int64_t when, double soc, void *context) {
+    SocJournalPoint point = {when, soc};
+    if (!spsc_queue_push(&socJournalQueue, &point)) {
+        fprintf(stderr, "SOC journal queue full, dropped point at %lld\n", (long long)when);
+    }
+}
+
+// Run one job of a task, reporting a deadline miss and the first crossing of a memory threshold
+void runGatewayJob(GatewayTaskId id) {
+    RtTask *timing = &taskTiming[id];
+    size_t heapBefore = heapInUse();
+
+#ifdef GATEWAY_LINUX_RUNTIME
+    runningTrace = &traceRings[id];
+#endif
+    rt_job_start(timing, rt_now_us());
+    trace_begin(&traceRings[id], TRACE_TASK, timing->name, 0);
+    taskTable[id].job();
+    bool missed = rt_job_finish(timing, rt_now_us());
+    trace_end(&traceRings[id], TRACE_TASK, timing->name, missed);
+#ifdef GATEWAY_LINUX_RUNTIME
+    runningTrace = NULL;
+#endif
+    if (missed) {
+        fprintf(stderr, "%s missed its deadline: response %u us, deadline %u us\n",
+                timing->name, (unsigned)timing->last_response_us, (unsigned)timing->deadline_us);
+
+        // Keep the timeline leading up to a task's first miss
+        if (timing->deadline_misses == 1) {
+            writeGatewayTrace();
+        }
+    }
+
+    size_t heapAfter = heapInUse();
+    mem_task_heap_job(&taskMemory[id], heapBefore, heapAfter);
+    if (mem_heap_sample(&heapMonitor, heapAfter)) {
+        fprintf(stderr, "Heap in use %zu bytes exceeds %zu after %s\n", heapAfter, heapMonitor.warn_bytes, timing->name);
+    }
+
+#ifndef GATEWAY_LINUX_RUNTIME
+    // The high-water mark scans only the untouched end of the stack, so checking after every job is cheap
+    uint32_t stackFree = (uint32_t)(uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t));
+    if (mem_task_stack_sample(&taskMemory[id], stackFree, STACK_WARN_FREE_FRACTION)) {
+        fprintf(stderr, "%s stack nearly full: %u of %u bytes never used\n", timing->name,
+                (unsigned)stackFree, (unsigned)taskMemory[id].stack_bytes);
+    }
+#endif
+}
+
+// Publish task timing, memory and idle statistics for local tools; the file is replaced atomically
+void writeGatewayStats(void) {
+    char temporary[sizeof(STATS_PATH) + 4];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", STATS_PATH);
+    FILE *stats = fopen(temporary, "w");
+    if (!stats) {
+        return;
+    }
+
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        const RtTask *timing = &taskTiming[i];
+        const TaskMemory *memory = &taskMemory[i];
+        fprintf(stats, "task=%s jobs=%llu deadline_misses=%u wcet_us=%u worst_response_us=%u heap_net=%lld "
+                "heap_job_peak=%u", timing->name, (unsigned long long)timing->jobs, (unsigned)timing->deadline_misses,
+                (unsigned)timing->wcet_us, (unsigned)timing->worst_response_us, (long long)memory->heap_net,
+                (unsigned)memory->heap_job_peak);
+        if (memory->stack_bytes > 0 && memory->stack_min_free != UINT32_MAX) {
+            fprintf(stats, " stack_bytes=%u stack_min_free=%u", (unsigned)memory->stack_bytes,
+                    (unsigned)memory->stack_min_free);
+        }
+        fprintf(stats, "\n");
+    }
+
+    uint64_t now = rt_now_us();
+    fprintf(stats, "heap_in_use=%zu heap_peak=%zu\n", atomic_load_explicit(&heapMonitor.in_use, memory_order_relaxed),
+            atomic_load_explicit(&heapMonitor.peak, memory_order_relaxed));
+    fprintf(stats, "idle_residency=%.4f wakeups_per_s=%.3f\n", idle_stats_residency(&idleStats, now),
+            idle_stats_wakeup_rate(&idleStats, now));
+    fclose(stats);
+    rename(temporary, STATS_PATH);
+}
+
+// Export every task's timeline as Chrome trace JSON; the file is replaced atomically
+void writeGatewayTrace(void) {
+    char temporary[sizeof(TRACE_PATH) + 4];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", TRACE_PATH);
+    FILE *trace = fopen(temporary, "w");
+    if (!trace) {
+        fprintf(stderr, "Failed to open %s\n", temporary);
+        return;
+    }
+    trace_export_chrome(trace, traceRings, NUM_TRACE_RINGS, &traceClock);
+    fclose(trace);
+    rename(temporary, TRACE_PATH);
+}
+
+#ifndef GATEWAY_LINUX_RUNTIME
+// Sleep until the task's next release
+void sleepUntilRelease(RtTask *timing) {
+    // Round up so the task never wakes before its release
+    vTaskDelay(pdMS_TO_TICKS((rt_time_to_release(timing, rt_now_us()) + 999) / 1000));
+}
+
+// Heap in use from the FreeRTOS heap
+size_t heapInUse(void) {
+    return configTOTAL_HEAP_SIZE - xPortGetFreeHeapSize();
+}
+
+// POST to the utility API; blocks, so only network-core tasks call it
+void postUrl(const char *url) {
+    CURL *curl = curl_easy_init();
+    if (curl) {
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)BID_POST_TIMEOUT_MS);
+        TraceRing *trace = currentTrace();
+        int32_t traceId = nextTraceId();
+        uint64_t start = rt_now_us();
+        trace_async_begin(trace, TRACE_HTTP, "POST bid", traceId);
+        CURLcode res = curl_easy_perform(curl);
+        trace_async_end(trace, TRACE_HTTP, "POST bid", traceId);
+
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        recordBidPost(res == CURLE_OK, status, rt_now_us() - start);
+        if (res != CURLE_OK) {
+            fprintf(stderr, "Failed to submit bid: %s\n", curl_easy_strerror(res));
+        }
+        curl_easy_cleanup(curl);
+    }
+}
+
+// Fetch market data, then continue with done
+void requestMarketData(void (*done)(void)) {
+    fetchMarketData();
+    done();
+}
+#endif
+
+// Hand a bid to BidSubmission without blocking on the network
+void queueBid(SpscQueue *queue, const BidMessage *bid) {
+    metric_counter_add(bid->day_ahead ? &metrics.day_ahead_bids : &metrics.fast_bids, 1);
+    if (!spsc_queue_push(queue, bid)) {
+        metric_counter_add(&metrics.dropped_bids, 1);
+        fprintf(stderr, "Bid queue full, dropped bid: capacity %.2f kWh, price $%.4f/kWh\n", bid->capacity, bid->price);
+    }
+}
+
+// Re-run the response-time analysis with the execution times measured so far
+int checkSchedulability(void) {
+#ifdef GATEWAY_LINUX_RUNTIME
+    // Event handlers never preempt each other, so a job can wait behind one run of every other job
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        taskTiming[i].blocking_us = 0;
+        for (int j = 0; j < NUM_GATEWAY_TASKS; j++) {
+            if (j != i) {
+                taskTiming[i].blocking_us += rt_execution_time(&taskTiming[j]);
+            }
+        }
+    }
+#endif
+    int unschedulable = rt_analyze(taskTiming, NUM_GATEWAY_TASKS);
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        if (taskTiming[i].response_bound_us == UINT32_MAX) {
+            fprintf(stderr, "%s can miss its deadline: execution %u us, deadline %u us\n", taskTiming[i].name,
+                    (unsigned)rt_execution_time(&taskTiming[i]), (unsigned)taskTiming[i].deadline_us);
+        }
+    }
+    return unschedulable;
+}
+
 // Fetch market data from utility API
 void fetchMarketData() {
     CURL *curl;
@@ -104,10 +633,17 @@ void fetchMarketData() {
     
     curl = curl_easy_init();
     if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, "https://opencbp.api.example.com/market_data");
+        curl_easy_setopt(curl, CURLOPT_URL, UTILITY_API_URL "/market_data");
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)MARKET_DATA_TIMEOUT_MS);
         
+        TraceRing *trace = currentTrace();
+        int32_t traceId = nextTraceId();
+        uint64_t start = rt_now_us();
+        trace_async_begin(trace, TRACE_HTTP, "GET market data", traceId);
         res = curl_easy_perform(curl);
+        trace_async_end(trace, TRACE_HTTP, "GET market data", traceId);
+        recordMarketDataFetch(rt_now_us() - start);
         if (res != CURLE_OK) {
             fprintf(stderr, "Failed to fetch market data: %s\n", curl_easy_strerror(res));
         }
@@ -116,289 +652,514 @@ void fetchMarketData() {
     }
 }
 
-// RTOS task to handle SOC monitoring and anti-flutter protection
-void SpoofSOC(void *pvParameters) {
-    time_t currentTime;
-    time_t lastSpoofTime = 0;
+// Compiled tariff for a year, compiling it on the first request
+// Last year's slot is reused once every reader has moved past the newest snapshot that carried it; until then, and if
+// compiling fails, the previous tariff (or NULL) stays in use
+static const CompiledTariff *tariffForYear(int year) {
+    int slot = year % 2;
+    const CompiledTariff *previous = tariffCompiled[1 - slot] ? &tariffs[1 - slot] : NULL;
+    if (tariffCompiled[slot] && tariffs[slot].year == year) {
+        return &tariffs[slot];
+    }
+    if (tariffCompiled[slot]) {
+        for (int reader = 0; reader < NUM_MARKET_READERS; reader++) {
+            if (atomic_load_explicit(&marketSeen[reader], memory_order_acquire) <= tariffLastSequence[slot]) {
+                return previous;
+            }
+        }
+        tariff_free(&tariffs[slot]);
+        tariffCompiled[slot] = false;
+    }
+
+    // Compile the rate schedule into 15-minute intervals
+    TariffSchedule schedule;
+    tariff_default_schedule(&schedule);
+    if (tariff_compile(&schedule, year, 15, &tariffs[slot]) != 0) {
+        fprintf(stderr, "Failed to compile the %d tariff, using %s\n", year,
+                previous ? "the previous year's rates" : "built-in day/night rates");
+        return previous;
+    }
+    tariffCompiled[slot] = true;
+    return &tariffs[slot];
+}
+
+// Hand the market data to the control and planning cores, with this year's tariff
+static void publishMarketData(void) {
+    time_t currentTime = time(NULL);
+    struct tm localTime;
+    localtime_r(&currentTime, &localTime);
+    marketData.tariff = tariffForYear(localTime.tm_year + 1900);
+    marketData.sequence++;
+    if (marketData.tariff != NULL) {
+        tariffLastSequence[marketData.tariff - tariffs] = marketData.sequence;
+    }
+
+    // A reader that has fallen this far behind picks up the next hour's snapshot instead
+    bool delivered = spsc_queue_push(&controlMarketQueue, &marketData);
+    delivered = spsc_queue_push(&planningMarketQueue, &marketData) && delivered;
+    if (!delivered) {
+        fprintf(stderr, "Market data queue full, snapshot %u not delivered to every core\n",
+                (unsigned)marketData.sequence);
+    }
+}
+
+// Move a reader to the newest market data queued for it, then acknowledge it so older tariffs can be released
+static void receiveMarketData(SpscQueue *queue, MarketSnapshot *market, MarketReader reader) {
+    bool received = false;
+    while (spsc_queue_pop(queue, market)) {
+        received = true;
+    }
+    if (received) {
+        atomic_store_explicit(&marketSeen[reader], market->sequence, memory_order_release);
+    }
+}
+
+// SpoofSOC state carried between jobs
+static time_t lastSpoofTime = 0;
+static double previousSOC = 0.5; // Initial assumption
+
+// Moving average filter for SOC readings
+#define FILTER_SIZE 5
+static double socReadings[FILTER_SIZE] = {0.5, 0.5, 0.5, 0.5, 0.5};
+static int filterIndex = 0;
+
+// Raw SOC history keeps every reversal for rainflow re-costing at a fraction of the 1 Hz volume
+static SocTraceCompressor socTrace;
+
+// Site energy accumulated over the current meter interval
+static double intervalEnergy = 0.0;
+static time_t intervalStart = 0;
+
+// Copy the models the planner reads for the planning core; runs on the control core, or in initGateway
+void publishPlanningState(void) {
+    static PlanningState state;     // Several KB, so kept off the task stack
+    state.strategy = dr_strategy;
+    state.config = *dr_strategy.config;
+    state.config.cycles = NULL;
+    state.config.cycle_array_size = 0;
+    state.config.cycle_count_index = 0;
+    state.inverter = inverter;
+    state.has_baseline = (dr_strategy.config->baseline != NULL);
+    state.baseline = site_baseline;
+    state.has_load_forecast = (dr_strategy.load_forecast != NULL);
+    state.load_forecast = load_forecaster;
+    if (!spsc_queue_push(&planningStateQueue, &state)) {
+        fprintf(stderr, "Planning state queue full, planner keeps its previous copy\n");
+    }
+}
+
+// SOC monitoring and anti-flutter protection, run every second
+void SpoofSOCJob(void) {
+    time_t currentTime = time(NULL);
     uint16_t actualSOC;
     uint16_t batteryTemp;
-    double previousSOC = 0.5; // Initial assumption
-    
-    // Initialize moving average filter for SOC readings
-    #define FILTER_SIZE 5
-    double socReadings[FILTER_SIZE] = {0.5, 0.5, 0.5, 0.5, 0.5};
-    int filterIndex = 0;
-
-    for (;;) {
-        currentTime = time(NULL);
+    uint16_t siteLoad;
 
-        // Read actual SOC from BMS via Modbus
-        if (modbus_read_input_registers(ctx, 0x208, 1, &actualSOC) == -1) {
-            fprintf(stderr, "Failed to read SOC register: %s\n", modbus_strerror(errno));
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            continue;
-        }
-        
-        // Read battery temperature (in 0.1°C)
-        if (modbus_read_input_registers(ctx, 0x209, 1, &batteryTemp) == -1) {
-            fprintf(stderr, "Failed to read temperature register: %s\n", modbus_strerror(errno));
-            // Use default temperature of 25°C
-            batteryTemp = 250;
+    // Read actual SOC from BMS via Modbus
+    if (readRegister(0x208, &actualSOC) == -1) {
+        fprintf(stderr, "Failed to read SOC register: %s\n", modbus_strerror(errno));
+        return;
+    }
+    
+    // Read battery temperature (in 0.1°C)
+    if (readRegister(0x209, &batteryTemp) == -1) {
+        fprintf(stderr, "Failed to read temperature register: %s\n", modbus_strerror(errno));
+        // Use default temperature of 25°C
+        batteryTemp = 250;
+    }
+    
+    // The pack and inverter share an enclosure, so the battery sensor drives the power derate
+    inverter_set_temperature(&inverter, batteryTemp / 10.0);
+    
+    // Read site load (in W) and integrate it into meter intervals for the baseline
+    if (readRegister(0x20A, &siteLoad) != -1) {
+        time_t currentInterval = currentTime - (currentTime % METER_INTERVAL_SECONDS);
+        if (intervalStart != 0 && currentInterval != intervalStart) {
+            baseline_ingest(&site_baseline, intervalStart, intervalEnergy);
+            load_forecast_update(&load_forecaster, intervalStart, intervalEnergy);
+            intervalEnergy = 0.0;
         }
-        
-        // Apply moving average filter to SOC readings
-        socReadings[filterIndex] = actualSOC / 100.0;
-        filterIndex = (filterIndex + 1) % FILTER_SIZE;
-        
-        double filteredSOC = 0;
-        for (int i = 0; i < FILTER_SIZE; i++) {
-            filteredSOC += socReadings[i];
+        if (currentInterval != intervalStart) {
+            publishPlanningState();
         }
-        filteredSOC /= FILTER_SIZE;
-        
-        // Calculate SOC change for degradation tracking
-        double socChange = fabs(filteredSOC - previousSOC);
+        intervalStart = currentInterval;
+        intervalEnergy += siteLoad / 3600000.0; // W over one second to kWh
+    }
+    
+    soc_trace_add(&socTrace, (int64_t)currentTime, actualSOC / 100.0);
+    
+    // Apply moving average filter to SOC readings
+    socReadings[filterIndex] = actualSOC / 100.0;
+    filterIndex = (filterIndex + 1) % FILTER_SIZE;
+    
+    double filteredSOC = 0;
+    for (int i = 0; i < FILTER_SIZE; i++) {
+        filteredSOC += socReadings[i];
+    }
+    filteredSOC /= FILTER_SIZE;
+    
+    // Calculate SOC change for degradation tracking
+    double socChange = fabs(filteredSOC - previousSOC);
+    
+    // Update SOC in the DR strategy
+    dr_strategy.current_soc = filteredSOC;
+    metric_gauge_set(&metrics.soc, filteredSOC);
+    metric_gauge_set(&metrics.battery_temperature, batteryTemp / 10.0);
+    
+    // Add to degradation tracking if significant change occurred
+    if (socChange > 0.01) { // >1% SOC change
+        // Detect depth of discharge and mean SOC
+        double depth = socChange;
+        double mean_soc = (filteredSOC + previousSOC) / 2.0;
+        double temp_celsius = batteryTemp / 10.0;
         
-        // Update SOC in the DR strategy
-        dr_strategy.current_soc = filteredSOC;
+        // Add to rainflow counting
+        add_rainflow_cycle(&dr_strategy, depth, mean_soc, temp_celsius);
+        metric_gauge_set(&metrics.equivalent_cycles, dr_strategy.config->cycle_count);
         
-        // Add to degradation tracking if significant change occurred
-        if (socChange > 0.01) { // >1% SOC change
-            // Detect depth of discharge and mean SOC
-            double depth = socChange;
-            double mean_soc = (filteredSOC + previousSOC) / 2.0;
-            double temp_celsius = batteryTemp / 10.0;
-            
-            // Add to rainflow counting
-            add_rainflow_cycle(&dr_strategy, depth, mean_soc, temp_celsius);
-            
-            // Update previous SOC
-            previousSOC = filteredSOC;
-        }
+        // Update previous SOC
+        previousSOC = filteredSOC;
+    }
 
-        // Enforce minimum SOC safety latch
-        if (dr_strategy.current_soc < dr_strategy.min_soc) {
-            printf("SOC below minimum threshold (%.1f%%). Disabling DR events.\n", 
-                   dr_strategy.min_soc * 100);
-                   
-            // Disable DR events by writing to register
-            modbus_write_register(ctx, 0x220, 0);
-            
-            // Log event
-            FILE *logFile = fopen("/var/log/opencbp.log", "a");
-            if (logFile) {
-                fprintf(logFile, "[%ld] SOC below minimum threshold. DR events disabled.\n", currentTime);
-                fclose(logFile);
-            }
-            
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            continue;
+    // Enforce minimum SOC safety latch
+    if (dr_strategy.current_soc < dr_strategy.min_soc) {
+        printf("SOC below minimum threshold (%.1f%%). Disabling DR events.\n", 
+               dr_strategy.min_soc * 100);
+               
+        // Disable DR events by writing to register
+        writeRegister(0x220, 0);
+        
+        // Log event
+        FILE *logFile = fopen("/var/log/opencbp.log", "a");
+        if (logFile) {
+            fprintf(logFile, "[%ld] SOC below minimum threshold. DR events disabled.\n", currentTime);
+            fclose(logFile);
         }
+        
+        return;
+    }
 
-        // Enforce anti-flutter timer
-        if (difftime(currentTime, lastSpoofTime) >= SPOOF_INTERVAL_SECONDS) {
-            // Allow DR events by setting lastSpoofTime
-            lastSpoofTime = currentTime;
-            
-            // Log event
-            FILE *logFile = fopen("/var/log/opencbp.log", "a");
-            if (logFile) {
-                fprintf(logFile, "[%ld] Anti-flutter timer reset. DR events enabled.\n", currentTime);
-                fclose(logFile);
-            }
+    // Enforce anti-flutter timer
+    if (difftime(currentTime, lastSpoofTime) >= SPOOF_INTERVAL_SECONDS) {
+        // Allow DR events by setting lastSpoofTime
+        lastSpoofTime = currentTime;
+        
+        // Log event
+        FILE *logFile = fopen("/var/log/opencbp.log", "a");
+        if (logFile) {
+            fprintf(logFile, "[%ld] Anti-flutter timer reset. DR events enabled.\n", currentTime);
+            fclose(logFile);
         }
-
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Run every second
     }
 }
 
-// RTOS task to handle Fast DR Dispatch
-void FastDRDispatch(void *pvParameters) {
-    time_t currentTime;
-    bool isDemandResponseActive = false;
+// Fast DR state carried between jobs; a failed 0x220 read keeps the last known status
+static bool isDemandResponseActive = false;
+static SettlementBid journaledFastBid;
+
+// Control core's copy of the market data
+static MarketSnapshot controlMarket = {.num_competitors = 10};
+
+// Fast DR dispatch, run every second and whenever the VEN signals an event
+void FastDRDispatchJob(void) {
     double current_market_price = 0.0;
     double current_grid_demand = 0.0;
+    time_t currentTime = time(NULL);
+    struct tm localTime;
+    localtime_r(&currentTime, &localTime);
+    int current_hour = localTime.tm_hour;
+    
+    // Price against the newest market data and tariff the network core has handed over
+    receiveMarketData(&controlMarketQueue, &controlMarket, MARKET_READER_CONTROL);
+    dr_strategy.tariff = controlMarket.tariff;
+    
+    // Update current price and demand from forecasts for the current hour
+    current_market_price = controlMarket.price_forecast[current_hour];
+    current_grid_demand = controlMarket.grid_demand_forecast[current_hour];
 
-    for (;;) {
-        currentTime = time(NULL);
-        struct tm *localTime = localtime(&currentTime);
-        int current_hour = localTime->tm_hour;
-        
-        // Update current price and demand from forecasts for the current hour
-        current_market_price = price_forecast[current_hour];
-        current_grid_demand = grid_demand_forecast[current_hour];
-
-        // Check if DR events are active
-        uint16_t dr_status = 0;
-        if (modbus_read_input_registers(ctx, 0x220, 1, &dr_status) == -1) {
-            fprintf(stderr, "Failed to read DR status register: %s\n", modbus_strerror(errno));
-        } else {
-            isDemandResponseActive = (dr_status > 0);
-        }
+    // Check if DR events are active
+    uint16_t dr_status = 0;
+    if (readRegister(0x220, &dr_status) == -1) {
+        fprintf(stderr, "Failed to read DR status register: %s\n", modbus_strerror(errno));
+    } else {
+        isDemandResponseActive = (dr_status > 0);
+    }
+    metric_gauge_set(&metrics.dr_active, isDemandResponseActive);
+    
+    // Event days are excluded from the baseline window
+    if (isDemandResponseActive) {
+        baseline_mark_ineligible_day(&site_baseline, currentTime);
+    }
+    
+    // With DR disabled the inverter stops on its own, so the next dispatch ramps from rest
+    if (!isDemandResponseActive) {
+        inverter_reset_setpoint(&inverter);
+    }
+
+    // Fast DR Dispatch Logic
+    if (isDemandResponseActive) {
+        double bid_capacity, bid_price;
+        trace_begin(currentTrace(), TRACE_BID, "fast DR bid", current_hour);
+        calculate_fast_dr_bid(&dr_strategy, current_market_price, current_grid_demand, 1.0, currentTime,
+                            &bid_capacity, &bid_price);
+        trace_end(currentTrace(), TRACE_BID, "fast DR bid", 0);
+
+        printf("Fast DR Dispatch: Capacity: %.2f kWh, Price: $%.4f/kWh\n", bid_capacity, bid_price);
 
-        // Fast DR Dispatch Logic
-        if (isDemandResponseActive) {
-            double bid_capacity, bid_price;
-            calculate_fast_dr_bid(&dr_strategy, current_market_price, current_grid_demand, 1.0, 
-                                &bid_capacity, &bid_price);
-
-            printf("Fast DR Dispatch: Capacity: %.2f kWh, Price: $%.4f/kWh\n", bid_capacity, bid_price);
-
-            // Check if bid is valid (capacity > 0)
-            if (bid_capacity > 0) {
-                // Adjust discharge rate based on bid capacity
-                uint16_t discharge_rate = (uint16_t)(bid_capacity * 100); // Scale for Modbus register
-                if (modbus_write_register(ctx, 0x210, discharge_rate) == -1) {
-                    fprintf(stderr, "Failed to write discharge rate: %s\n", modbus_strerror(errno));
-                }
-                
-                // Send bid price to API
-                char url[256];
-                snprintf(url, sizeof(url), "https://opencbp.api.example.com/bid?capacity=%.2f&price=%.4f", 
-                        bid_capacity, bid_price);
-                
-                CURL *curl = curl_easy_init();
-                if (curl) {
-                    curl_easy_setopt(curl, CURLOPT_URL, url);
-                    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-                    CURLcode res = curl_easy_perform(curl);
-                    if (res != CURLE_OK) {
-                        fprintf(stderr, "Failed to submit bid: %s\n", curl_easy_strerror(res));
-                    }
-                    curl_easy_cleanup(curl);
-                }
+        // Check if bid is valid (capacity > 0)
+        if (bid_capacity > 0) {
+            // Adjust discharge rate to the bid's average power over its one-hour window,
+            // within the inverter's derated limit and ramp
+            double setpoint_kw = inverter_limit_setpoint(&inverter, bid_capacity, currentTime);
+            uint16_t discharge_rate = (uint16_t)(fmax(setpoint_kw, 0.0) * 100); // Scale for Modbus register
+            if (writeRegister(0x210, discharge_rate) == -1) {
+                fprintf(stderr, "Failed to write discharge rate: %s\n", modbus_strerror(errno));
             } else {
-                printf("Fast DR Dispatch: Not profitable to participate at current price.\n");
+                journalSetpoint(currentTime, discharge_rate / 100.0);
             }
+            
+            // Record the bid against the current hour when it changes; the last row for an hour is the one that stands
+            SettlementBid hourBid = {currentTime - (currentTime % 3600), bid_capacity, bid_price};
+            if (hourBid.start != journaledFastBid.start || hourBid.capacity_kwh != journaledFastBid.capacity_kwh ||
+                hourBid.price != journaledFastBid.price) {
+                journalBid(hourBid.start, hourBid.capacity_kwh, hourBid.price);
+                journaledFastBid = hourBid;
+            }
+            
+            // Send bid price to API from the network task
+            BidMessage bid = {false, current_hour, bid_capacity, bid_price};
+            queueBid(&fastBidQueue, &bid);
+        } else {
+            printf("Fast DR Dispatch: Not profitable to participate at current price.\n");
         }
+    }
+}
 
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Run every second
+// Planning core's copies of the market data and the control core's models
+static MarketSnapshot planningMarket = {.num_competitors = 10};
+static PlanningState planningState;
+
+// Move the planner to the newest copies handed over, pointing its strategy at them
+void receivePlanningInputs(void) {
+    receiveMarketData(&planningMarketQueue, &planningMarket, MARKET_READER_PLANNING);
+    while (spsc_queue_pop(&planningStateQueue, &planningState)) {
     }
+
+    DemandResponseStrategy *strategy = &planningState.strategy;
+    strategy->config = &planningState.config;
+    strategy->config->baseline = planningState.has_baseline ? &planningState.baseline : NULL;
+    strategy->inverter = &planningState.inverter;
+    strategy->load_forecast = planningState.has_load_forecast ? &planningState.load_forecast : NULL;
+    strategy->tariff = planningMarket.tariff;
 }
 
-// RTOS task to handle Capacity Bidding
-void CapacityBidding(void *pvParameters) {
-    time_t currentTime;
-    bool isDemandResponseActive = false;
+// Peak hours, charge plan and day-ahead bids from the planner's copy of the market data and models
+void planDayAhead(void) {
+    time_t currentTime = time(NULL);
+    struct tm localTime;
+    localtime_r(&currentTime, &localTime);
+    time_t dayStart = currentTime - (localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec);
     int expected_peak_hours[24] = {0};
+    DemandResponseStrategy *strategy = &planningState.strategy;
 
-    for (;;) {
-        currentTime = time(NULL);
-        struct tm *localTime = localtime(&currentTime);
-        
-        // Only run capacity bidding once per day at 2 AM
-        if (localTime->tm_hour == 2 && localTime->tm_min == 0) {
-            // Fetch latest market data
-            fetchMarketData();
-            
-            // Identify peak hours (simple heuristic: top 6 hours by price)
-            // In a real system, use more sophisticated forecasting
-            double sorted_prices[24];
-            memcpy(sorted_prices, price_forecast, 24 * sizeof(double));
-            
-            // Sort prices (simple bubble sort for clarity)
-            for (int i = 0; i < 24; i++) {
-                for (int j = 0; j < 23-i; j++) {
-                    if (sorted_prices[j] < sorted_prices[j+1]) {
-                        double temp = sorted_prices[j];
-                        sorted_prices[j] = sorted_prices[j+1];
-                        sorted_prices[j+1] = temp;
-                    }
-                }
-            }
-            
-            // Set threshold for peak hours (price of 6th highest hour)
-            double peak_threshold = sorted_prices[5];
-            
-            // Mark peak hours
-            for (int i = 0; i < 24; i++) {
-                expected_peak_hours[i] = (price_forecast[i] >= peak_threshold) ? 1 : 0;
+    // Identify peak hours (simple heuristic: top 6 hours by price)
+    // In a real system, use more sophisticated forecasting
+    double sorted_prices[24];
+    memcpy(sorted_prices, planningMarket.price_forecast, 24 * sizeof(double));
+    
+    // Sort prices (simple bubble sort for clarity)
+    for (int i = 0; i < 24; i++) {
+        for (int j = 0; j < 23-i; j++) {
+            if (sorted_prices[j] < sorted_prices[j+1]) {
+                double temp = sorted_prices[j];
+                sorted_prices[j] = sorted_prices[j+1];
+                sorted_prices[j+1] = temp;
             }
+        }
+    }
+    
+    // Set threshold for peak hours (price of 6th highest hour)
+    double peak_threshold = sorted_prices[5];
+    
+    // Mark peak hours
+    for (int i = 0; i < 24; i++) {
+        expected_peak_hours[i] = (planningMarket.price_forecast[i] >= peak_threshold) ? 1 : 0;
+    }
+    
+    // Plan solar and off-peak grid charging together with the day-ahead bids
+    double solar_energy[24];
+    double import_prices[24];
+    if (pv_forecast_ready) {
+        // Pick up a newly dropped weather file, then forecast from midnight today
+        pv_forecast_refresh(&pv_forecast, WEATHER_FORECAST_PATH);
+        pv_forecast_hourly(&pv_forecast, dayStart, 24, solar_energy);
+    } else {
+        getSolarEnergyProfile(localTime.tm_yday, solar_energy);
+    }
+    for (int i = 0; i < 24; i++) {
+        import_prices[i] = get_strategy_energy_cost(strategy, dayStart + i * 3600);
+    }
+    
+    // Hours already bid today (fast DR, or an earlier plan before a restart) must still be delivered
+    double committed[24];
+    loadCommittedBids(dayStart, committed);
+    SettlementConfig settlementRules;
+    settlement_default_config(&settlementRules);
+    
+    ChargePlanInputs plan_inputs = {0};
+    plan_inputs.prices = planningMarket.price_forecast;
+    plan_inputs.peak_hours = expected_peak_hours;
+    plan_inputs.solar_energy = solar_energy;
+    plan_inputs.import_prices = import_prices;
+    plan_inputs.dr_commitment = committed;
+    plan_inputs.shortfall_penalty = settlementRules.shortfall_penalty;
+    
+    // Calculate bids
+    double bid_capacities[24];
+    double bid_prices[24];
+    double grid_charge[24] = {0};
+    
+    trace_begin(currentTrace(), TRACE_BID, "day-ahead CBP plan", 0);
+    if (calculate_joint_cbp_strategy(strategy, &plan_inputs, 24, 0, NULL, 24, 
+                                     bid_capacities, bid_prices, grid_charge) != 0) {
+        // Fall back to the discharge-only allocation
+        calculate_cbp_strategy(strategy, planningMarket.price_forecast, expected_peak_hours, 24, 
+                             bid_capacities, bid_prices);
+    }
+    trace_end(currentTrace(), TRACE_BID, "day-ahead CBP plan", 0);
+    
+    // The grid charge plan is advisory: the Modbus map has no charge setpoint, so the battery's own charge
+    // controller decides; the plan only shapes the bids around the charging it expects
+    for (int hour = 0; hour < 24; hour++) {
+        if (grid_charge[hour] > 0) {
+            printf("Hour %d: Planned grid charge: %.2f kWh\n", hour, grid_charge[hour]);
+        }
+    }
+    
+    // Submit bids to the utility
+    printf("Capacity Bidding Program: Submitting day-ahead bids\n");
+    for (int hour = 0; hour < 24; hour++) {
+        if (bid_capacities[hour] > 0) {
+            printf("Hour %d: Capacity: %.2f kWh, Price: $%.4f/kWh\n", 
+                   hour, bid_capacities[hour], bid_prices[hour]);
+                   
+            // Record the bid against its delivery hour
+            journalBid(dayStart + hour * 3600, bid_capacities[hour], bid_prices[hour]);
             
-            // Calculate bids
-            double bid_capacities[24];
-            double bid_prices[24];
-            
-            calculate_cbp_strategy(&dr_strategy, price_forecast, expected_peak_hours, 24, 
-                                 bid_capacities, bid_prices);
-            
-            // Submit bids to the utility
-            printf("Capacity Bidding Program: Submitting day-ahead bids\n");
-            for (int hour = 0; hour < 24; hour++) {
-                if (bid_capacities[hour] > 0) {
-                    printf("Hour %d: Capacity: %.2f kWh, Price: $%.4f/kWh\n", 
-                           hour, bid_capacities[hour], bid_prices[hour]);
-                           
-                    // Submit bid via API
-                    char url[256];
-                    snprintf(url, sizeof(url), 
-                             "https://opencbp.api.example.com/day_ahead_bid?hour=%d&capacity=%.2f&price=%.4f", 
-                             hour, bid_capacities[hour], bid_prices[hour]);
-                    
-                    CURL *curl = curl_easy_init();
-                    if (curl) {
-                        curl_easy_setopt(curl, CURLOPT_URL, url);
-                        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-                        curl_easy_perform(curl);
-                        curl_easy_cleanup(curl);
-                    }
-                }
-            }
+            // Submit bid via API from the network task
+            BidMessage bid = {true, hour, bid_capacities[hour], bid_prices[hour]};
+            queueBid(&dayAheadBidQueue, &bid);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(60000)); // Check every minute
     }
 }
 
+// Start of the last day planned
+static time_t plannedDay = 0;
 
-void MarketDataUpdate(void *pvParameters) {
-    time_t currentTime;
-    time_t lastUpdateTime = 0;
+// Day-ahead capacity bidding, checked every minute and run once per day in the 2 AM hour
+// The plan waits for market data fetched at or after 2 AM, or plans on the last data by 2:30 if that fetch failed
+void CapacityBiddingJob(void) {
+    time_t currentTime = time(NULL);
+    struct tm localTime;
+    localtime_r(&currentTime, &localTime);
+    time_t dayStart = currentTime - (localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec);
+    
+    receivePlanningInputs();
+    
+    // Only run capacity bidding once per day at 2 AM
+    if (localTime.tm_hour == 2 && plannedDay != dayStart &&
+        (planningMarket.fetched >= dayStart + 2 * 3600 || localTime.tm_min >= 30)) {
+        plannedDay = dayStart;
+        planDayAhead();
+    }
+}
+
+
+// Last hourly market data refresh
+static time_t lastMarketUpdate = 0;
+
+// Hand the refreshed data to the other cores, then log its price range
+void logMarketDataUpdate(void) {
+    time_t currentTime = time(NULL);
+    publishMarketData();
+    
+    FILE *logFile = fopen("/var/log/opencbp.log", "a");
+    if (logFile) {
+        // Find min and max price
+        const double *prices = marketData.price_forecast;
+        double min_price = prices[0];
+        double max_price = prices[0];
+        for (int i = 1; i < 24; i++) {
+            if (prices[i] < min_price) min_price = prices[i];
+            if (prices[i] > max_price) max_price = prices[i];
+        }
+        fprintf(logFile, "[%ld] Market data updated. Price range: $%.4f-$%.4f/kWh\n", 
+                currentTime, min_price, max_price);
+        
+        // Report how much of the time the gateway itself let the CPU sleep
+        uint64_t now = rt_now_us();
+        fprintf(logFile, "[%ld] Idle residency %.1f%%, %.2f wakeups/s, longest sleep %llu ms\n", currentTime,
+                idle_stats_residency(&idleStats, now) * 100.0, idle_stats_wakeup_rate(&idleStats, now),
+                (unsigned long long)(idleStats.longest_sleep_us / 1000));
+        fclose(logFile);
+    }
+    
+    // Re-check the response-time bounds against the execution times measured so far
+    checkSchedulability();
+}
+
+// Hourly market data refresh, checked every minute
+// Refreshes fall on the hour, so the 2 AM refresh is the one the day-ahead plan waits for
+void MarketDataUpdateJob(void) {
+    time_t currentTime = time(NULL);
     const int UPDATE_INTERVAL = 3600; // Update hourly
     
-    for (;;) {
-        currentTime = time(NULL);
+    // Non-urgent disk writes ride along with this job's wakeup
+    flushSocJournal();
+    writeGatewayStats();
+    
+    // Update market data every hour
+    if (currentTime / UPDATE_INTERVAL != lastMarketUpdate / UPDATE_INTERVAL) {
+        printf("Updating market data...\n");
         
-        // Update market data every hour
-        if (difftime(currentTime, lastUpdateTime) >= UPDATE_INTERVAL) {
-            printf("Updating market data...\n");
-            
-            // Fetch latest market data
-            fetchMarketData();
-            
-            // Update last fetch time
-            lastUpdateTime = currentTime;
-            
-            // Log successful update
-            FILE *logFile = fopen("/var/log/opencbp.log", "a");
-            if (logFile) {
-                // Find min and max price
-                double min_price = price_forecast[0];
-                double max_price = price_forecast[0];
-                for (int i = 1; i < 24; i++) {
-                    if (price_forecast[i] < min_price) min_price = price_forecast[i];
-                    if (price_forecast[i] > max_price) max_price = price_forecast[i];
-                }
-                fprintf(logFile, "[%ld] Market data updated. Price range: $%.4f-$%.4f/kWh\n", 
-                        currentTime, min_price, max_price);
-                fclose(logFile);
-            }
-        }
+        // Update last fetch time
+        lastMarketUpdate = currentTime;
         
-        vTaskDelay(pdMS_TO_TICKS(60000)); // Check every minute
+        // Fetch latest market data, then log it
+        requestMarketData(logMarketDataUpdate);
     }
 }
 
-// Utility function to calculate expected revenue for a given hour
-double calculateExpectedRevenue(int hour, double capacity) {
+// Post queued bids to the utility API, at most BID_POSTS_PER_JOB per job so the job stays within its budget
+void BidSubmissionJob(void) {
+    BidMessage bid;
+
+    // Fast DR bids first; they are only worth anything within the current hour
+    for (int posted = 0; posted < BID_POSTS_PER_JOB &&
+         (spsc_queue_pop(&fastBidQueue, &bid) || spsc_queue_pop(&dayAheadBidQueue, &bid)); posted++) {
+        char url[256];
+        if (bid.day_ahead) {
+            snprintf(url, sizeof(url),
+                     UTILITY_API_URL "/day_ahead_bid?hour=%d&capacity=%.2f&price=%.4f",
+                     bid.hour, bid.capacity, bid.price);
+        } else {
+            snprintf(url, sizeof(url), UTILITY_API_URL "/bid?capacity=%.2f&price=%.4f",
+                     bid.capacity, bid.price);
+        }
+        postUrl(url);
+    }
+}
+
+// Utility function to calculate expected revenue for a given hour from a core's copy of the market data
+double calculateExpectedRevenue(const MarketSnapshot *market, int hour, double capacity) {
     // Get price forecast for the hour
-    double price = price_forecast[hour];
+    double price = market->price_forecast[hour];
     
     // Calculate expected grid demand
-    double demand = grid_demand_forecast[hour];
+    double demand = market->grid_demand_forecast[hour];
     
     // Calculate probability of acceptance based on competition
-    double acceptance_prob = 1.0 / (1.0 + (num_competitors * 0.1));
+    double acceptance_prob = 1.0 / (1.0 + (market->num_competitors * 0.1));
     
     // Expected revenue = price * capacity * probability of acceptance
     return price * capacity * acceptance_prob;
@@ -432,7 +1193,7 @@ void submitBid(double bidPrice) {
 
     if (curl) {
         char url[256];
-        snprintf(url, sizeof(url), "https://opencbp.api.example.com/api/bid?price=%.2f", bidPrice);
+        snprintf(url, sizeof(url), UTILITY_API_URL "/api/bid?price=%.2f", bidPrice);
 
         curl_easy_setopt(curl, CURLOPT_URL, url);
         curl_easy_setopt(curl, CURLOPT_POST, 1L);
@@ -449,8 +1210,21 @@ void submitBid(double bidPrice) {
     curl_global_cleanup();
 }
 
-// RTOS Initialization
-void initSystem() {
+// Task jobs, stacks and cores, indexed by GatewayTaskId
+// Modbus stays on the control core and every curl request on the network core, which hands market data to the other
+// two by queue; planning gets the rest.
+// Stacks follow gcc -fstack-usage of each job's deepest call chain plus stdio and curl: CapacityBidding needs about
+// 6.5 KB for planDayAhead and the joint planner's DP. Runtime high-water marks are in STATS_PATH.
+const GatewayTask taskTable[NUM_GATEWAY_TASKS] = {
+    [TASK_SPOOF_SOC] = {SpoofSOCJob, GATEWAY_TASK_STACK(4096), CONTROL_CORE_MASK},
+    [TASK_FAST_DR_DISPATCH] = {FastDRDispatchJob, GATEWAY_TASK_STACK(4096), CONTROL_CORE_MASK},
+    [TASK_CAPACITY_BIDDING] = {CapacityBiddingJob, GATEWAY_TASK_STACK(12288), PLANNING_CORE_MASK},
+    [TASK_MARKET_DATA_UPDATE] = {MarketDataUpdateJob, GATEWAY_TASK_STACK(8192), NETWORK_CORE_MASK},
+    [TASK_BID_SUBMISSION] = {BidSubmissionJob, GATEWAY_TASK_STACK(8192), NETWORK_CORE_MASK},
+};
+
+// Gateway state shared by the RTOS and Linux runtimes
+int initGateway(void) {
     // Generate sunlight LUT
     generateSunlightLUT();
 
@@ -458,30 +1232,176 @@ void initSystem() {
     ctx = modbus_new_rtu("/dev/ttyUSB0", 9600, 'N', 8, 1);
     if (ctx == NULL) {
         fprintf(stderr, "Unable to create the libmodbus context\n");
-        return;
+        return -1;
     }
     if (modbus_connect(ctx) == -1) {
         fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
         modbus_free(ctx);
-        return;
+        return -1;
     }
+#ifdef GATEWAY_LINUX_RUNTIME
+    // Transactions run inline on the event loop, so a silent slave may only stall it briefly
+    modbus_set_response_timeout(ctx, 0, MODBUS_RESPONSE_TIMEOUT_MS * 1000);
+#endif
 
     // Initialize DemandResponseStrategy with improved parameters
-    DemandResponseStrategy_init(&dr_strategy, 6.5, 0.95);
+    if (DemandResponseStrategy_init(&dr_strategy, 6.5, 0.95) != 0) {
+        fprintf(stderr, "Unable to allocate the DR strategy\n");
+        modbus_free(ctx);
+        return -1;
+    }
+    
+    // Start the 10-in-10 baseline on 15-minute meter intervals
+    if (baseline_init(&site_baseline, METER_INTERVAL_SECONDS / 60, BASELINE_MAX_WINDOW_DAYS) == 0) {
+        dr_strategy.config->baseline = &site_baseline;
+    }
+    
+    // Precompute clear-sky PV production for the site
+    pv_forecast_ready = (pv_forecast_init(&pv_forecast, PV_PEAK_KW, LATITUDE, LONGITUDE, TIMEZONE_OFFSET) == 0);
+    if (pv_forecast_ready) {
+        pv_forecast_refresh(&pv_forecast, WEATHER_FORECAST_PATH);
+    }
+    
+    // Bids and setpoints respect the inverter's rated power, ramp and temperature derate
+    inverter_init(&inverter, MAX_DISCHARGE_RATE, MAX_CHARGE_RATE);
+    dr_strategy.inverter = &inverter;
+    
+    // Learn household load from the same meter intervals
+    if (load_forecast_init(&load_forecaster, METER_INTERVAL_SECONDS / 60, 0.1) == 0) {
+        dr_strategy.load_forecast = &load_forecaster;
+    }
     
-    // Fetch initial market data
-    fetchMarketData();
-
     // Run initial historical data analysis
     analyzeHistoricalData();
 
-    // Create RTOS tasks
-    xTaskCreate(SpoofSOC, "SpoofSOC", configMINIMAL_STACK_SIZE * 2, NULL, 1, NULL);
-    xTaskCreate(FastDRDispatch, "FastDRDispatch", configMINIMAL_STACK_SIZE * 2, NULL, 1, NULL);
-    xTaskCreate(CapacityBidding, "CapacityBidding", configMINIMAL_STACK_SIZE * 2, NULL, 1, NULL);
+    // Bids and SOC history cross from the control and planning cores to the network core without locks, and market
+    // data and the planner's inputs cross the other way
+    if (spsc_queue_init(&fastBidQueue, BID_QUEUE_LENGTH, sizeof(BidMessage)) != 0 ||
+        spsc_queue_init(&dayAheadBidQueue, BID_QUEUE_LENGTH, sizeof(BidMessage)) != 0 ||
+        spsc_queue_init(&controlMarketQueue, MARKET_QUEUE_LENGTH, sizeof(MarketSnapshot)) != 0 ||
+        spsc_queue_init(&planningMarketQueue, MARKET_QUEUE_LENGTH, sizeof(MarketSnapshot)) != 0 ||
+        spsc_queue_init(&planningStateQueue, PLANNING_QUEUE_LENGTH, sizeof(PlanningState)) != 0 ||
+        spsc_queue_init(&socJournalQueue, SOC_JOURNAL_BUFFER, sizeof(SocJournalPoint)) != 0) {
+        fprintf(stderr, "Unable to allocate inter-core queues\n");
+        return -1;
+    }
+    
+    // Fetch initial market data, compile this year's tariff, and give every core its first copies
+    fetchMarketData();
+    publishMarketData();
+    publishPlanningState();
     
-    // Create a task for market data updates
-    xTaskCreate(MarketDataUpdate, "MarketDataUpdate", configMINIMAL_STACK_SIZE * 2, NULL, 1, NULL);
+    // Journal the SOC history from the first reading
+    soc_trace_init(&socTrace, SOC_TRACE_TOLERANCE, journalSocPoint, NULL);
+    
+    idle_stats_init(&idleStats, rt_now_us());
+    
+    // Stack and heap tracking starts before the first job
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        mem_task_init(&taskMemory[i], (uint32_t)(taskTable[i].stack_depth * GATEWAY_STACK_WORD));
+    }
+    mem_heap_init(&heapMonitor, HEAP_WARN_BYTES);
+
+    metric_histogram_init(&metrics.bid_latency, httpLatencyBounds,
+                          (int)(sizeof(httpLatencyBounds) / sizeof(httpLatencyBounds[0])));
+    metric_histogram_init(&metrics.market_data_latency, httpLatencyBounds,
+                          (int)(sizeof(httpLatencyBounds) / sizeof(httpLatencyBounds[0])));
+
+    trace_clock_init(&traceClock);
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        trace_ring_init(&traceRings[i], taskTiming[i].name);
+    }
+#ifndef GATEWAY_LINUX_RUNTIME
+    for (int i = 0; i < TRACE_SCHEDULER_CORES; i++) {
+        trace_ring_init(&traceRings[NUM_GATEWAY_TASKS + i], schedulerTraceNames[i]);
+    }
+#endif
+    return 0;
+}
+
+#ifndef GATEWAY_LINUX_RUNTIME
+// Tickless idle hooks: FreeRTOSConfig.h maps configPRE_SLEEP_PROCESSING(x) to gatewayPreSleep(x) and
+// configPOST_SLEEP_PROCESSING(x) to gatewayPostSleep(x), with configUSE_TICKLESS_IDLE set to 1
+void gatewayPreSleep(TickType_t expectedIdleTicks) {
+    idle_stats_sleep_begin(&idleStats, rt_now_us());
+}
+
+void gatewayPostSleep(TickType_t expectedIdleTicks) {
+    idle_stats_sleep_end(&idleStats, rt_now_us());
+}
+
+// RTOS task running one task table job on its period
+void PeriodicTask(void *pvParameters) {
+    GatewayTaskId id = (GatewayTaskId)(intptr_t)pvParameters;
+    RtTask *timing = &taskTiming[id];
+
+    vTaskSetThreadLocalStoragePointer(NULL, TRACE_TLS_INDEX, &traceRings[id]);
+    for (;;) {
+        runGatewayJob(id);
+        sleepUntilRelease(timing);
+    }
+}
+
+// Serve metric scrapes below every task table priority, so scrapes only ever use time the jobs leave idle
+void MetricsTask(void *pvParameters) {
+    int listener = metrics_listen(METRICS_PORT);
+    if (listener < 0) {
+        fprintf(stderr, "Unable to listen for metrics on port %d\n", METRICS_PORT);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // A stalled scraper must not hold the task forever
+        struct timeval timeout = {1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serveMetrics(client);
+        close(client);
+    }
+}
+
+// RTOS Initialization
+void initSystem() {
+    if (initGateway() != 0) {
+        return;
+    }
+
+    // On SMP builds each partition is analyzed on its own cores
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+        taskTiming[i].core_mask = taskTable[i].core_mask;
+    }
+#endif
+
+    // Rate-monotonic priorities, checked against the budgets before anything runs; the level above idle is left
+    // to the metrics server
+    rt_assign_priorities(taskTiming, NUM_GATEWAY_TASKS, tskIDLE_PRIORITY + 2);
+    if (checkSchedulability() > 0) {
+        fprintf(stderr, "Task budgets do not meet their deadlines\n");
+    }
+
+    // Create RTOS tasks from the task table
+    for (int i = 0; i < NUM_GATEWAY_TASKS; i++) {
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+        xTaskCreateAffinitySet(PeriodicTask, taskTiming[i].name, taskTable[i].stack_depth, (void*)(intptr_t)i,
+                               taskTiming[i].priority, taskTable[i].core_mask, NULL);
+#else
+        xTaskCreate(PeriodicTask, taskTiming[i].name, taskTable[i].stack_depth, (void*)(intptr_t)i,
+                    taskTiming[i].priority, NULL);
+#endif
+    }
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+    xTaskCreateAffinitySet(MetricsTask, "Metrics", GATEWAY_TASK_STACK(4096), NULL, tskIDLE_PRIORITY + 1,
+                           NETWORK_CORE_MASK, NULL);
+#else
+    xTaskCreate(MetricsTask, "Metrics", GATEWAY_TASK_STACK(4096), NULL, tskIDLE_PRIORITY + 1, NULL);
+#endif
 
     // Start RTOS scheduler
     vTaskStartScheduler();
@@ -500,4 +1420,5 @@ int main() {
 
     }
 
-}
\ No newline at end of file
+}
+#endif
@@ -5,6 +5,13 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "rt_schedule.h" // Rate-monotonic priorities and deadline monitoring
+#include "idle_stats.h" // Sleep residency for power tuning
+#include "mem_stats.h" // Stack and heap high-water marks
+#include "trace.h" // Per-task timelines for Chrome trace export
+#include "metrics.h" // Prometheus metrics
 
 #define DAYS_IN_YEAR 365
 #define LATITUDE 37.7749    // Example: San Francisco, CA
@@ -19,13 +26,139 @@ extern double sunsetTable[DAYS_IN_YEAR];
 #define SPOOF_INTERVAL_SECONDS 3600 // 1-hour anti-flutter timer
 #define MIN_SOC 20                  // 20% SOC safety latch
 #define MAX_DISCHARGE_RATE 100.0    // Maximum discharge rate in kW
+#define MAX_CHARGE_RATE 100.0       // Maximum charge rate in kW
 #define BID_PRICE_FACTOR 0.01       // Base price factor ($/kWh)
+#define PV_PEAK_KW 5.0              // PV array output at solar noon in kW
+#define WEATHER_FORECAST_PATH "/var/lib/opencbp/weather.csv" // Locally dropped weather forecast
+#define BID_JOURNAL_PATH "/var/log/opencbp_bids.csv" // Submitted bids, reloaded as planning commitments
+#define SOC_TRACE_PATH "/var/log/opencbp_soc.csv" // Compressed SOC history
+#define SOC_TRACE_TOLERANCE 0.005   // Maximum SOC reconstruction error of the history
+#define SOC_JOURNAL_BUFFER 64       // History points queued for the network core between journal flushes
+#define TASK_WAKE_GRID_US 1000000   // Task releases are aligned to this grid so wakeups coincide
+#define TIMER_SLACK_NS 50000000     // Linux timer slack, letting the kernel merge nearby expiries
+
+// SMP core partition for the Pi Zero 2 W (FreeRTOS SMP with core affinity); ignored on single-core builds
+#define CONTROL_CORE_MASK (1u << 0)                 // SOC latch and Modbus dispatch
+#define NETWORK_CORE_MASK (1u << 1)                 // Market data and bid submission
+#define PLANNING_CORE_MASK ((1u << 2) | (1u << 3))  // Day-ahead optimization
+#define BID_QUEUE_LENGTH 32                         // Bids buffered between cores
+
+// Utility API time bounds; BidSubmission and MarketDataUpdate budgets are sized from them
+#define BID_POSTS_PER_JOB 2                         // Bids BidSubmission posts per job; the rest wait for the next
+#define BID_POST_TIMEOUT_MS 250                     // Bounds each bid POST
+#define MARKET_DATA_TIMEOUT_MS 3000                 // Bounds each market data fetch
+
+// Utility API; override with -DUTILITY_API_URL=... to point a build at a test server
+#ifndef UTILITY_API_URL
+#define UTILITY_API_URL "https://opencbp.api.example.com"
+#endif
+
+// Linux runtime (build with -DGATEWAY_LINUX_RUNTIME and gateway_linux.c instead of FreeRTOS)
+#ifndef VEN_SOCKET_PATH
+#define VEN_SOCKET_PATH "/run/opencbp/ven.sock"     // Datagrams from the VEN wake fast DR dispatch
+#endif
+#define MODBUS_RESPONSE_TIMEOUT_MS 200              // Bounds each inline Modbus transaction
+
+#ifdef GATEWAY_LINUX_RUNTIME
+#define GATEWAY_TASK_STACK(bytes) 0                 // Jobs run on the event loop's thread
+#define GATEWAY_STACK_WORD 0
+#else
+#define GATEWAY_TASK_STACK(bytes) ((bytes) / sizeof(StackType_t))
+#define GATEWAY_STACK_WORD sizeof(StackType_t)
+#endif
+
+// Budgets of the jobs that talk to the utility API or plan; the RTOS blocks in curl up to its timeouts, while the
+// Linux loop only starts transfers and runs the plan inline
+#ifdef GATEWAY_LINUX_RUNTIME
+#define BID_SUBMISSION_BUDGET_US 20000              // Starting up to BID_POSTS_PER_JOB transfers
+#define MARKET_DATA_BUDGET_US 100000                // Starting the fetch, plus the journal and stats writes
+#define CAPACITY_BIDDING_BUDGET_US 200000           // The plan and its journal and weather file reads
+#else
+#define BID_SUBMISSION_BUDGET_US (BID_POSTS_PER_JOB * BID_POST_TIMEOUT_MS * 1000)
+#define MARKET_DATA_BUDGET_US (MARKET_DATA_TIMEOUT_MS * 1000 + 1000000)
+#define CAPACITY_BIDDING_BUDGET_US 5000000
+#endif
+
+// Memory monitoring
+#define STACK_WARN_FREE_FRACTION 0.2                // Warn once a task's least free stack drops below this share
+#define HEAP_WARN_BYTES (512 * 1024)                // Warn once heap in use exceeds this
+#define STATS_PATH "/run/opencbp/stats"             // Task timing, memory and idle statistics, rewritten each minute
+
+// Tracing
+#define TRACE_PATH "/run/opencbp/trace.json"        // Chrome trace of recent task timelines
+#define TRACE_TLS_INDEX 0                           // FreeRTOS thread-local slot holding each task's TraceRing
+#define TRACE_SCHEDULER_CORES 4                     // RTOS: scheduler timelines, one per core (Pi Zero 2 W)
+
+// Metrics
+#define METRICS_PORT 9101                           // Prometheus scrapes GET /metrics here
+#define METRICS_BUFFER_SIZE 8192                    // Rendered exposition
+#define METRICS_SCRAPE_TIMEOUT_MS 50                // Linux runtime: longest a scrape may stall the event loop
+
+// Gateway tasks, in task table order
+typedef enum {
+    TASK_SPOOF_SOC,
+    TASK_FAST_DR_DISPATCH,
+    TASK_CAPACITY_BIDDING,
+    TASK_MARKET_DATA_UPDATE,
+    TASK_BID_SUBMISSION,
+    NUM_GATEWAY_TASKS
+} GatewayTaskId;
+
+// Timelines: one per task, indexed by GatewayTaskId, then on RTOS one per core written by the scheduler hooks
+#ifdef GATEWAY_LINUX_RUNTIME
+#define NUM_TRACE_RINGS NUM_GATEWAY_TASKS
+#else
+#define NUM_TRACE_RINGS (NUM_GATEWAY_TASKS + TRACE_SCHEDULER_CORES)
+#endif
+
+// One periodic job and where it runs; its timing is taskTiming at the same index
+typedef struct {
+    void (*job)(void);              // One period's work; never loops or sleeps
+    uint16_t stack_depth;           // RTOS stack in words
+    uint32_t core_mask;             // Cores on SMP builds
+} GatewayTask;
+
+extern RtTask taskTiming[NUM_GATEWAY_TASKS];
+extern const GatewayTask taskTable[NUM_GATEWAY_TASKS];
+extern IdleStats idleStats;
+extern TaskMemory taskMemory[NUM_GATEWAY_TASKS];
+extern HeapMonitor heapMonitor;
+extern TraceRing traceRings[NUM_TRACE_RINGS];
+extern TraceClock traceClock;
+#ifdef GATEWAY_LINUX_RUNTIME
+extern TraceRing *runningTrace;
+#endif
 
 // Functions
 void generateSunlightLUT(void);
 void getSunlightHours(double *sunrise, double *sunset);
-void SpoofSOC(void *pvParameters);
-void FastDRDispatch(void *pvParameters);
-void CapacityBidding(void *pvParameters);
+void getSolarEnergyProfile(int dayOfYear, double *hourlyEnergy);
+size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp);
+void fetchMarketData(void);
+void flushSocJournal(void);
+int initGateway(void);
+void runGatewayJob(GatewayTaskId id);
+void writeGatewayStats(void);
+void writeGatewayTrace(void);
+TraceRing *currentTrace(void);
+int32_t nextTraceId(void);
+int serveMetrics(int client);
+void recordBidPost(bool delivered, long status, uint64_t elapsed_us);
+void recordMarketDataFetch(uint64_t elapsed_us);
+int checkSchedulability(void);
+
+// Task jobs
+void SpoofSOCJob(void);
+void FastDRDispatchJob(void);
+void CapacityBiddingJob(void);
+void MarketDataUpdateJob(void);
+void BidSubmissionJob(void);
+
+// Network back end, provided by the runtime: blocking curl on the RTOS, curl multi on Linux
+void postUrl(const char *url);
+void requestMarketData(void (*done)(void));
+
+// Heap in use in bytes, provided by the runtime
+size_t heapInUse(void);
 
 #endif // SUNLIGHT_LUT_H
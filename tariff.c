@@ -0,0 +1,225 @@
+#include "tariff.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MINUTES_PER_DAY 1440
+
+static bool _is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+// Day of week (0 = Sunday) using Sakamoto's method
+static int _day_of_week(int year, int month, int day) {
+    static const int offsets[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+    if (month < 3) {
+        year -= 1;
+    }
+    return (year + year / 4 - year / 100 + year / 400 + offsets[month - 1] + day) % 7;
+}
+
+// Calendar month (1-12) containing a 0-based day of year
+static int _month_of_day(int year, int day_of_year) {
+    static const int month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    for (int month = 0; month < 12; month++) {
+        int days = month_days[month] + ((month == 1 && _is_leap_year(year)) ? 1 : 0);
+        if (day_of_year < days) {
+            return month + 1;
+        }
+        day_of_year -= days;
+    }
+    return 12;
+}
+
+static bool _month_in_season(const TariffSeason *season, int month) {
+    if (season->start_month <= season->end_month) {
+        return month >= season->start_month && month <= season->end_month;
+    }
+    // Season wraps across the new year (e.g. November-April)
+    return month >= season->start_month || month <= season->end_month;
+}
+
+static bool _minute_in_range(int minute, int start_minute, int end_minute) {
+    if (start_minute <= end_minute) {
+        return minute >= start_minute && minute < end_minute;
+    }
+    // Range wraps across midnight
+    return minute >= start_minute || minute < end_minute;
+}
+
+// Fill a schedule equivalent to the built-in day/night rates
+void tariff_default_schedule(TariffSchedule *schedule) {
+    memset(schedule, 0, sizeof(*schedule));
+
+    // Night-time base cost everywhere, daytime 06:00-18:59 on top
+    schedule->default_import_rate = 0.10;
+    schedule->default_export_rate = 0.10;
+
+    schedule->num_periods = 1;
+    schedule->periods[0].season = -1;
+    schedule->periods[0].day_types = TARIFF_ALL_DAYS;
+    schedule->periods[0].start_minute = 6 * 60;
+    schedule->periods[0].end_minute = 19 * 60;
+    schedule->periods[0].import_rate = 0.29;
+    schedule->periods[0].export_rate = 0.29;
+}
+
+// Compile a schedule into flat per-interval arrays for a calendar year
+int tariff_compile(const TariffSchedule *schedule, int year, int interval_minutes, CompiledTariff *tariff) {
+    memset(tariff, 0, sizeof(*tariff));
+    if (interval_minutes <= 0 || MINUTES_PER_DAY % interval_minutes != 0) {
+        return -1;
+    }
+
+    tariff->year = year;
+    tariff->days = _is_leap_year(year) ? 366 : 365;
+    tariff->interval_minutes = interval_minutes;
+    tariff->intervals_per_day = MINUTES_PER_DAY / interval_minutes;
+    tariff->num_intervals = tariff->days * tariff->intervals_per_day;
+    tariff->import_rate = (float*)malloc(tariff->num_intervals * sizeof(float));
+    tariff->export_rate = (float*)malloc(tariff->num_intervals * sizeof(float));
+    if (tariff->import_rate == NULL || tariff->export_rate == NULL) {
+        tariff_free(tariff);
+        return -1;
+    }
+
+    int jan1_weekday = _day_of_week(year, 1, 1);
+
+    for (int day = 0; day < tariff->days; day++) {
+        int month = _month_of_day(year, day);
+
+        // First matching season wins; days outside every season only see all-season periods
+        int season = -1;
+        for (int i = 0; i < schedule->num_seasons; i++) {
+            if (_month_in_season(&schedule->seasons[i], month)) {
+                season = i;
+                break;
+            }
+        }
+
+        // Holidays take precedence over the weekday/weekend split
+        int weekday = (jan1_weekday + day) % 7;
+        int day_type = (weekday == 0 || weekday == 6) ? TARIFF_WEEKEND : TARIFF_WEEKDAY;
+        for (int i = 0; i < schedule->num_holidays; i++) {
+            if (schedule->holidays[i] == day) {
+                day_type = TARIFF_HOLIDAY;
+                break;
+            }
+        }
+
+        float *import_day = &tariff->import_rate[day * tariff->intervals_per_day];
+        float *export_day = &tariff->export_rate[day * tariff->intervals_per_day];
+        for (int i = 0; i < tariff->intervals_per_day; i++) {
+            import_day[i] = (float)schedule->default_import_rate;
+            export_day[i] = (float)schedule->default_export_rate;
+        }
+
+        // Later periods override earlier ones
+        for (int p = 0; p < schedule->num_periods; p++) {
+            const TariffPeriod *period = &schedule->periods[p];
+            if ((period->season >= 0 && period->season != season) || !(period->day_types & day_type)) {
+                continue;
+            }
+            for (int i = 0; i < tariff->intervals_per_day; i++) {
+                if (_minute_in_range(i * interval_minutes, period->start_minute, period->end_minute)) {
+                    import_day[i] = (float)period->import_rate;
+                    export_day[i] = (float)period->export_rate;
+                }
+            }
+        }
+    }
+
+    // CPP overlays go on last so they stack on whatever TOU rate applies
+    for (int e = 0; e < schedule->num_cpp_events; e++) {
+        const CppEvent *event = &schedule->cpp_events[e];
+        tariff_apply_cpp_event(tariff, event->day_of_year, event->start_minute, event->end_minute, event->adder);
+    }
+
+    return 0;
+}
+
+// Release compiled rate arrays
+void tariff_free(CompiledTariff *tariff) {
+    free(tariff->import_rate);
+    free(tariff->export_rate);
+    tariff->import_rate = NULL;
+    tariff->export_rate = NULL;
+    tariff->num_intervals = 0;
+}
+
+// Overlay a CPP event onto an already compiled tariff
+void tariff_apply_cpp_event(CompiledTariff *tariff, int day_of_year, int start_minute, int end_minute, double adder) {
+    if (day_of_year < 0 || day_of_year >= tariff->days) {
+        return;
+    }
+
+    float *import_day = &tariff->import_rate[day_of_year * tariff->intervals_per_day];
+    for (int i = 0; i < tariff->intervals_per_day; i++) {
+        if (_minute_in_range(i * tariff->interval_minutes, start_minute, end_minute)) {
+            import_day[i] += (float)adder;
+        }
+    }
+}
+
+// O(1) interval index for a day of year and minute of day
+int tariff_interval_index(const CompiledTariff *tariff, int day_of_year, int minute_of_day) {
+    if (day_of_year < 0) day_of_year = 0;
+    if (day_of_year >= tariff->days) day_of_year = tariff->days - 1;
+    if (minute_of_day < 0) minute_of_day = 0;
+    if (minute_of_day >= MINUTES_PER_DAY) minute_of_day = MINUTES_PER_DAY - 1;
+
+    return day_of_year * tariff->intervals_per_day + minute_of_day / tariff->interval_minutes;
+}
+
+// O(1) interval index for a wall-clock time
+int tariff_interval_at(const CompiledTariff *tariff, time_t t) {
+    struct tm local;
+    localtime_r(&t, &local);
+    return tariff_interval_index(tariff, local.tm_yday, local.tm_hour * 60 + local.tm_min);
+}
+
+double tariff_import_rate(const CompiledTariff *tariff, int interval) {
+    return tariff->import_rate[interval];
+}
+
+double tariff_export_rate(const CompiledTariff *tariff, int interval) {
+    return tariff->export_rate[interval];
+}
+
+// Copy a contiguous run of rates, truncated at the end of the year
+static int _copy_rates(const CompiledTariff *tariff, const float *source, int first_interval, int count, double *rates) {
+    if (first_interval < 0 || first_interval >= tariff->num_intervals) {
+        return 0;
+    }
+    if (count > tariff->num_intervals - first_interval) {
+        count = tariff->num_intervals - first_interval;
+    }
+    for (int i = 0; i < count; i++) {
+        rates[i] = source[first_interval + i];
+    }
+    return count;
+}
+
+int tariff_import_rates(const CompiledTariff *tariff, int first_interval, int count, double *rates) {
+    return _copy_rates(tariff, tariff->import_rate, first_interval, count, rates);
+}
+
+int tariff_export_rates(const CompiledTariff *tariff, int first_interval, int count, double *rates) {
+    return _copy_rates(tariff, tariff->export_rate, first_interval, count, rates);
+}
+
+// Hourly average import rates for a day
+void tariff_hourly_import_rates(const CompiledTariff *tariff, int day_of_year, double *hourly_rates) {
+    int per_hour = 60 / tariff->interval_minutes;
+    if (per_hour < 1) {
+        per_hour = 1;
+    }
+
+    for (int hour = 0; hour < 24; hour++) {
+        int first = tariff_interval_index(tariff, day_of_year, hour * 60);
+        double sum = 0.0;
+        for (int i = 0; i < per_hour; i++) {
+            sum += tariff->import_rate[first + i];
+        }
+        hourly_rates[hour] = sum / per_hour;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef TARIFF_H
+#define TARIFF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define TARIFF_MAX_SEASONS 4
+#define TARIFF_MAX_PERIODS 32
+#define TARIFF_MAX_HOLIDAYS 16
+#define TARIFF_MAX_CPP_EVENTS 16
+
+// Day types a TOU period applies to (bit mask)
+#define TARIFF_WEEKDAY 0x1
+#define TARIFF_WEEKEND 0x2
+#define TARIFF_HOLIDAY 0x4
+#define TARIFF_ALL_DAYS (TARIFF_WEEKDAY | TARIFF_WEEKEND | TARIFF_HOLIDAY)
+
+// Season as an inclusive month range (1-12); wraps across the new year when start_month > end_month
+typedef struct {
+    int start_month;
+    int end_month;
+} TariffSeason;
+
+// TOU period; later periods override earlier ones where they overlap
+typedef struct {
+    int season;                     // Index into the schedule's seasons, or -1 for all seasons
+    int day_types;                  // Mask of TARIFF_WEEKDAY / TARIFF_WEEKEND / TARIFF_HOLIDAY
+    int start_minute;               // First minute of day covered (inclusive)
+    int end_minute;                 // Last minute of day covered (exclusive)
+    double import_rate;             // Energy import rate ($/kWh)
+    double export_rate;             // NEM export credit ($/kWh)
+} TariffPeriod;
+
+// Critical peak pricing overlay added on top of the TOU import rate
+typedef struct {
+    int day_of_year;                // 0-based day of year
+    int start_minute;
+    int end_minute;
+    double adder;                   // CPP adder ($/kWh)
+} CppEvent;
+
+// Utility rate schedule as published, before compilation
+typedef struct {
+    double default_import_rate;     // Rate for intervals no period covers ($/kWh)
+    double default_export_rate;     // Export credit for intervals no period covers ($/kWh)
+    int num_seasons;
+    TariffSeason seasons[TARIFF_MAX_SEASONS];
+    int num_periods;
+    TariffPeriod periods[TARIFF_MAX_PERIODS];
+    int num_holidays;
+    int holidays[TARIFF_MAX_HOLIDAYS];  // 0-based days of year
+    int num_cpp_events;
+    CppEvent cpp_events[TARIFF_MAX_CPP_EVENTS];
+} TariffSchedule;
+
+// Flat per-interval rate arrays for one year
+// Rates are stored as float to halve the on-device footprint (~280 KB for a year of 15-minute intervals)
+typedef struct CompiledTariff {
+    int year;
+    int days;                       // 365 or 366
+    int interval_minutes;           // Interval length; must divide 1440
+    int intervals_per_day;
+    int num_intervals;
+    float *import_rate;             // Import rate per interval ($/kWh), CPP included
+    float *export_rate;             // Export credit per interval ($/kWh)
+} CompiledTariff;
+
+// Fill a schedule equivalent to the built-in $0.29 day (06:00-18:59) / $0.10 night rates with retail export credit
+void tariff_default_schedule(TariffSchedule *schedule);
+
+// Compile a schedule into flat per-interval arrays for a calendar year; returns 0 on success, -1 on error
+int tariff_compile(const TariffSchedule *schedule, int year, int interval_minutes, CompiledTariff *tariff);
+
+// Release compiled rate arrays
+void tariff_free(CompiledTariff *tariff);
+
+// Overlay a CPP event onto an already compiled tariff, e.g. when an OpenADR CPP event arrives
+void tariff_apply_cpp_event(CompiledTariff *tariff, int day_of_year, int start_minute, int end_minute, double adder);
+
+// O(1) interval index for a day of year and minute of day, clamped to the compiled year
+int tariff_interval_index(const CompiledTariff *tariff, int day_of_year, int minute_of_day);
+
+// O(1) interval index for a wall-clock time (local time)
+int tariff_interval_at(const CompiledTariff *tariff, time_t t);
+
+// O(1) rate lookups by interval index
+double tariff_import_rate(const CompiledTariff *tariff, int interval);
+double tariff_export_rate(const CompiledTariff *tariff, int interval);
+
+// Vectorized lookups: copy count consecutive intervals starting at first_interval; returns the number copied
+int tariff_import_rates(const CompiledTariff *tariff, int first_interval, int count, double *rates);
+int tariff_export_rates(const CompiledTariff *tariff, int first_interval, int count, double *rates);
+
+// Hourly average import rates for a day, as consumed by the CBP planner
+void tariff_hourly_import_rates(const CompiledTariff *tariff, int day_of_year, double *hourly_rates);
+
+#endif // TARIFF_H
@@ -0,0 +1,262 @@
+#include "telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+uint32_t telemetry_partition(uint32_t time) {
+    return time / TELEMETRY_PARTITION_SECONDS;
+}
+
+int telemetry_partition_path(char *path, size_t size, const char *dir, uint32_t partition) {
+    time_t start = (time_t)partition * TELEMETRY_PARTITION_SECONDS;
+    struct tm utc;
+    gmtime_r(&start, &utc);
+    int length = snprintf(path, size, "%s/%04d-%02d-%02d/%02d.tcol", dir, utc.tm_year + 1900, utc.tm_mon + 1,
+                          utc.tm_mday, utc.tm_hour);
+    return (length < 0 || (size_t)length >= size) ? -1 : 0;
+}
+
+void telemetry_block_reset(TelemetryBlock *block, uint32_t partition) {
+    memset(&block->header, 0, sizeof(block->header));
+    block->header.magic = TELEMETRY_BLOCK_MAGIC;
+    block->header.version = TELEMETRY_FRAME_VERSION;
+    block->header.columns = TELEMETRY_COLUMNS;
+    block->header.partition = partition;
+    block->header.min_time = UINT32_MAX;
+}
+
+// Append one report
+bool telemetry_block_append(TelemetryBlock *block, uint32_t gateway, const TelemetryReport *report) {
+    uint32_t row = block->header.rows++;
+    block->gateway[row] = gateway;
+    block->time[row] = report->time;
+    block->soc[row] = report->soc;
+    block->temperature[row] = report->temperature;
+    block->setpoint_kw[row] = report->setpoint_kw;
+    block->delivered_kwh[row] = report->delivered_kwh;
+    block->bid_kwh[row] = report->bid_kwh;
+    block->bid_price[row] = report->bid_price;
+    block->cycle_count[row] = report->cycle_count;
+    if (report->time < block->header.min_time) {
+        block->header.min_time = report->time;
+    }
+    if (report->time > block->header.max_time) {
+        block->header.max_time = report->time;
+    }
+    return block->header.rows == TELEMETRY_BLOCK_ROWS;
+}
+
+// Append a block in one write
+int telemetry_block_write(int fd, const TelemetryBlock *block) {
+    size_t column = block->header.rows * sizeof(uint32_t);
+    struct iovec parts[1 + TELEMETRY_COLUMNS] = {
+        {(void*)&block->header, sizeof(block->header)},
+        {(void*)block->gateway, column},
+        {(void*)block->time, column},
+        {(void*)block->soc, column},
+        {(void*)block->temperature, column},
+        {(void*)block->setpoint_kw, column},
+        {(void*)block->delivered_kwh, column},
+        {(void*)block->bid_kwh, column},
+        {(void*)block->bid_price, column},
+        {(void*)block->cycle_count, column},
+    };
+    size_t total = sizeof(block->header) + TELEMETRY_COLUMNS * column;
+
+    // A short write (disk full) is cut back off, so a partial block never sits in front of later ones
+    off_t end = lseek(fd, 0, SEEK_END);
+    ssize_t written = writev(fd, parts, 1 + TELEMETRY_COLUMNS);
+    if (written != (ssize_t)total) {
+        if (written > 0 && end >= 0) {
+            ftruncate(fd, end);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static int _series_reserve(TelemetrySeries *series, int64_t count) {
+    if (count <= series->capacity) {
+        return 0;
+    }
+    int64_t capacity = (series->capacity > 0) ? series->capacity : 1024;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    double **columns[] = {&series->soc, &series->temperature, &series->setpoint_kw, &series->delivered_kwh,
+                          &series->bid_kwh, &series->bid_price, &series->cycle_count};
+    int64_t *time = (int64_t*)realloc(series->time, (size_t)capacity * sizeof(int64_t));
+    if (time == NULL) {
+        return -1;
+    }
+    series->time = time;
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        double *column = (double*)realloc(*columns[i], (size_t)capacity * sizeof(double));
+        if (column == NULL) {
+            return -1;
+        }
+        *columns[i] = column;
+    }
+    series->capacity = capacity;
+    return 0;
+}
+
+// Insertion sort of the rows from first on; reports arrive in order per connection, so this is nearly linear
+static void _series_sort_from(TelemetrySeries *series, int64_t first) {
+    double *columns[] = {series->soc, series->temperature, series->setpoint_kw, series->delivered_kwh,
+                         series->bid_kwh, series->bid_price, series->cycle_count};
+    enum { NUM_VALUES = sizeof(columns) / sizeof(columns[0]) };
+
+    for (int64_t i = (first > 0) ? first : 1; i < series->count; i++) {
+        if (series->time[i - 1] <= series->time[i]) {
+            continue;
+        }
+        int64_t time = series->time[i];
+        double values[NUM_VALUES];
+        for (int c = 0; c < NUM_VALUES; c++) {
+            values[c] = columns[c][i];
+        }
+        int64_t j = i;
+        for (; j > 0 && series->time[j - 1] > time; j--) {
+            series->time[j] = series->time[j - 1];
+            for (int c = 0; c < NUM_VALUES; c++) {
+                columns[c][j] = columns[c][j - 1];
+            }
+        }
+        series->time[j] = time;
+        for (int c = 0; c < NUM_VALUES; c++) {
+            columns[c][j] = values[c];
+        }
+    }
+}
+
+// Append one gateway's rows from a partition file
+int64_t telemetry_load_series(const char *path, uint32_t gateway, TelemetrySeries *series) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    // Column data of one block; the gateway column is read first and the rest only if the gateway appears
+    uint32_t *data = (uint32_t*)malloc((size_t)TELEMETRY_BLOCK_ROWS * TELEMETRY_COLUMNS * sizeof(uint32_t));
+    if (data == NULL) {
+        fclose(file);
+        return -1;
+    }
+
+    int64_t first = series->count;
+    int64_t result = 0;
+    TelemetryBlockHeader header;
+    while (fread(&header, sizeof(header), 1, file) == 1) {
+        if (header.magic != TELEMETRY_BLOCK_MAGIC || header.columns != TELEMETRY_COLUMNS ||
+            header.rows == 0 || header.rows > TELEMETRY_BLOCK_ROWS) {
+            break;
+        }
+        size_t rows = header.rows;
+        if (fread(data, sizeof(uint32_t), rows, file) != rows) {
+            break;
+        }
+
+        int64_t matches = 0;
+        for (size_t row = 0; row < rows; row++) {
+            matches += (data[row] == gateway);
+        }
+        if (matches == 0) {
+            if (fseek(file, (long)((TELEMETRY_COLUMNS - 1) * rows * sizeof(uint32_t)), SEEK_CUR) != 0) {
+                break;
+            }
+            continue;
+        }
+
+        size_t rest = (TELEMETRY_COLUMNS - 1) * rows;
+        if (fread(data + rows, sizeof(uint32_t), rest, file) != rest) {
+            break;
+        }
+        if (_series_reserve(series, series->count + matches) != 0) {
+            result = -1;
+            break;
+        }
+
+        const uint32_t *time = data + rows;
+        const float *values = (const float*)(data + 2 * rows);
+        for (size_t row = 0; row < rows; row++) {
+            if (data[row] != gateway) {
+                continue;
+            }
+            int64_t i = series->count++;
+            series->time[i] = time[row];
+            series->soc[i] = values[row];
+            series->temperature[i] = values[rows + row];
+            series->setpoint_kw[i] = values[2 * rows + row];
+            series->delivered_kwh[i] = values[3 * rows + row];
+            series->bid_kwh[i] = values[4 * rows + row];
+            series->bid_price[i] = values[5 * rows + row];
+            series->cycle_count[i] = values[6 * rows + row];
+        }
+    }
+
+    free(data);
+    fclose(file);
+    _series_sort_from(series, first);
+    return (result < 0) ? -1 : series->count - first;
+}
+
+void telemetry_series_free(TelemetrySeries *series) {
+    free(series->time);
+    free(series->soc);
+    free(series->temperature);
+    free(series->setpoint_kw);
+    free(series->delivered_kwh);
+    free(series->bid_kwh);
+    free(series->bid_price);
+    free(series->cycle_count);
+    memset(series, 0, sizeof(*series));
+}
+
+// Setpoint changes
+int telemetry_setpoints(const TelemetrySeries *series, DispatchSetpoint *setpoints, int max_setpoints) {
+    int count = 0;
+    for (int64_t i = 0; i < series->count && count < max_setpoints; i++) {
+        if (i == 0 || series->setpoint_kw[i] != series->setpoint_kw[i - 1]) {
+            setpoints[count].time = (time_t)series->time[i];
+            setpoints[count].setpoint_kw = series->setpoint_kw[i];
+            count++;
+        }
+    }
+    return count;
+}
+
+// Meter samples; a report's delivery started at the previous report
+int telemetry_meter(const TelemetrySeries *series, MeterSample *meter, int max_meter) {
+    int count = 0;
+    for (int64_t i = 0; i < series->count && count < max_meter; i++) {
+        meter[count].time = (time_t)series->time[(i > 0) ? i - 1 : 0];
+        meter[count].energy_kwh = series->delivered_kwh[i];
+        count++;
+    }
+    return count;
+}
+
+// One bid per interval, as last reported within it
+int telemetry_bids(const TelemetrySeries *series, int interval_seconds, SettlementBid *bids, int max_bids) {
+    int count = 0;
+    for (int64_t i = 0; i < series->count; i++) {
+        if (series->bid_kwh[i] <= 0.0) {
+            continue;
+        }
+        time_t start = (time_t)(series->time[i] - series->time[i] % interval_seconds);
+        if (count > 0 && bids[count - 1].start == start) {
+            count--;
+        } else if (count == max_bids) {
+            break;
+        }
+        bids[count].start = start;
+        bids[count].capacity_kwh = series->bid_kwh[i];
+        bids[count].price = series->bid_price[i];
+        count++;
+    }
+    return count;
+}
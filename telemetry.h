@@ -0,0 +1,126 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "settlement.h"
+
+// Fleet telemetry: gateways stream fixed-size reports over TCP, and the ingestion server (telemetry_server.c) stores
+// them in columnar blocks appended to one file per hour. Everything is little-endian, as on every supported gateway.
+
+#define TELEMETRY_PORT 9102
+#define TELEMETRY_DEFAULT_DIR "/var/lib/opencbp/telemetry"
+
+// Wire framing: every frame is a TelemetryFrameHeader followed by length bytes of payload
+#define TELEMETRY_FRAME_MAGIC 0x4D54        // "TM"
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_MAX_FRAME 16384           // Largest payload accepted (512 reports); a larger length closes the connection
+
+typedef enum {
+    TELEMETRY_HELLO = 1,                // Payload: uint32_t gateway id; must come first on a connection
+    TELEMETRY_REPORTS = 2               // Payload: any number of TelemetryReport
+} TelemetryFrameType;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;                       // TelemetryFrameType
+    uint32_t length;                    // Payload bytes
+} TelemetryFrameHeader;
+
+// One gateway report, sent every report interval; also the row of the columnar files (plus the gateway id)
+typedef struct {
+    uint32_t time;                      // Sample time (seconds since epoch)
+    float soc;                          // State of charge (0.0 to 1.0)
+    float temperature;                  // Battery temperature (°C)
+    float setpoint_kw;                  // Discharge setpoint in effect (register 0x210)
+    float delivered_kwh;                // Metered delivery since the previous report
+    float bid_kwh;                      // Capacity bid for the current settlement interval, 0 if none
+    float bid_price;                    // Bid price ($/kWh)
+    float cycle_count;                  // Equivalent full cycles to date
+} TelemetryReport;
+
+_Static_assert(sizeof(TelemetryFrameHeader) == 8, "frame header is 8 bytes on the wire");
+_Static_assert(sizeof(TelemetryReport) == 32, "report is 32 bytes on the wire");
+
+// Columnar files: <dir>/<YYYY-MM-DD>/<HH>.tcol per UTC hour of report time, each a run of blocks
+// A block is a TelemetryBlockHeader and then each column for its rows in turn (gateway, time, soc, temperature,
+// setpoint, delivered, bid kWh, bid price, cycles), 4 bytes per value, so a reader loads only the columns it needs
+#define TELEMETRY_BLOCK_MAGIC 0x4C4F4354    // "TCOL"
+#define TELEMETRY_BLOCK_ROWS 16384          // Rows per block at most
+#define TELEMETRY_COLUMNS 9
+#define TELEMETRY_PARTITION_SECONDS 3600
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;                   // TELEMETRY_COLUMNS
+    uint32_t rows;
+    uint32_t partition;                 // Hours since epoch
+    uint32_t min_time;                  // Report time range, so readers can skip the block
+    uint32_t max_time;
+    uint64_t reserved;
+} TelemetryBlockHeader;
+
+// Rows of one partition being batched for a single write
+typedef struct {
+    TelemetryBlockHeader header;
+    uint32_t gateway[TELEMETRY_BLOCK_ROWS];
+    uint32_t time[TELEMETRY_BLOCK_ROWS];
+    float soc[TELEMETRY_BLOCK_ROWS];
+    float temperature[TELEMETRY_BLOCK_ROWS];
+    float setpoint_kw[TELEMETRY_BLOCK_ROWS];
+    float delivered_kwh[TELEMETRY_BLOCK_ROWS];
+    float bid_kwh[TELEMETRY_BLOCK_ROWS];
+    float bid_price[TELEMETRY_BLOCK_ROWS];
+    float cycle_count[TELEMETRY_BLOCK_ROWS];
+} TelemetryBlock;
+
+// One gateway's reports read back from the files, in time order, as parallel arrays
+// time doubles as the sample index for rainflow_count_indexed, whose cycle end indices degradation_fit expects
+typedef struct {
+    int64_t count;
+    int64_t capacity;
+    int64_t *time;
+    double *soc;
+    double *temperature;
+    double *setpoint_kw;
+    double *delivered_kwh;
+    double *bid_kwh;
+    double *bid_price;
+    double *cycle_count;
+} TelemetrySeries;
+
+// Partition (hours since epoch) a report time belongs to
+uint32_t telemetry_partition(uint32_t time);
+
+// Write a partition's file path into path; returns 0, or -1 if it did not fit
+int telemetry_partition_path(char *path, size_t size, const char *dir, uint32_t partition);
+
+// Start an empty block for a partition
+void telemetry_block_reset(TelemetryBlock *block, uint32_t partition);
+
+// Append one report (the block must not be full); returns true once the block is full
+bool telemetry_block_append(TelemetryBlock *block, uint32_t gateway, const TelemetryReport *report);
+
+// Append a block to an open partition file in one write; returns 0 on success, -1 on a write error
+int telemetry_block_write(int fd, const TelemetryBlock *block);
+
+// Append one gateway's rows from a partition file to series, keeping it in time order
+// A missing file adds nothing; a torn block at the end (a crash mid-write) is ignored
+// Returns the number of rows added, or -1 on a read or allocation failure
+int64_t telemetry_load_series(const char *path, uint32_t gateway, TelemetrySeries *series);
+
+// Release series arrays
+void telemetry_series_free(TelemetrySeries *series);
+
+// Settlement inputs from a series; each returns the number of records written
+// A setpoint is emitted whenever it changes, a meter sample per report, and a bid per interval that had one
+int telemetry_setpoints(const TelemetrySeries *series, DispatchSetpoint *setpoints, int max_setpoints);
+int telemetry_meter(const TelemetrySeries *series, MeterSample *meter, int max_meter);
+int telemetry_bids(const TelemetrySeries *series, int interval_seconds, SettlementBid *bids, int max_bids);
+
+#endif // TELEMETRY_H
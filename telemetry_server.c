@@ -0,0 +1,452 @@
+// Fleet telemetry ingestion: gateways stream reports over TCP, batched into hourly columnar files
+//
+// Build from the repository root:
+//   gcc -O2 -Wall -o telemetry_server telemetry_server.c telemetry.c spsc_queue.c metrics.c -lpthread
+//   ./telemetry_server [--port 9102] [--dir /var/lib/opencbp/telemetry]
+//
+// One epoll thread owns every connection and appends each report to an in-memory TelemetryBlock for its hour. Full
+// blocks, and every open block once a second, go over an SpscQueue to a writer thread that appends each with a single
+// writev, so disk stalls never hold up the sockets. Blocks come back on a second queue for reuse; when all of them
+// are in flight the front end waits, and TCP flow control pushes back on the gateways. Ingestion counters are served
+// as Prometheus metrics on INGEST_METRICS_PORT.
+
+#include "telemetry.h"
+#include "spsc_queue.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+
+#define INGEST_MAX_EVENTS 256           // Events taken per epoll_wait
+#define INGEST_BACKLOG 1024
+#define INGEST_OPEN_PARTITIONS 4        // Hours batched at once; late reports for another hour evict the oldest
+#define INGEST_MAX_BLOCKS 64            // Blocks in memory, open or queued for the writer (about 36 MB)
+#define INGEST_OPEN_FILES 4             // Partition files the writer keeps open
+#define INGEST_FLUSH_MS 1000            // Longest a report waits in memory
+#define INGEST_WAIT_US 100              // Front end nap while every block is with the writer
+#define INGEST_METRICS_PORT 9103
+#define INGEST_METRICS_BUFFER_SIZE 4096
+#define INGEST_SCRAPE_TIMEOUT_MS 50
+
+// One gateway connection; a frame is buffered whole before it is parsed
+typedef struct {
+    int fd;
+    uint32_t gateway;
+    bool identified;                // HELLO received
+    size_t used;
+    unsigned char buffer[sizeof(TelemetryFrameHeader) + TELEMETRY_MAX_FRAME];
+} Connection;
+
+// Ingestion health, served to Prometheus
+typedef struct {
+    MetricCounter reports;          // Reports accepted
+    MetricCounter rows_written;     // Reports on disk
+    MetricCounter blocks_written;
+    MetricCounter write_errors;
+    MetricCounter protocol_errors;  // Connections closed for a malformed frame
+    MetricCounter stalls;           // Times the front end waited for the writer
+    MetricGauge connections;
+} IngestMetrics;
+
+static IngestMetrics metrics;
+static const MetricDescriptor metricTable[] = {
+    {"opencbp_ingest_reports_total", "Gateway reports accepted", NULL, METRIC_COUNTER, &metrics.reports},
+    {"opencbp_ingest_rows_written_total", "Reports written to partition files", NULL, METRIC_COUNTER,
+     &metrics.rows_written},
+    {"opencbp_ingest_blocks_written_total", "Columnar blocks written", NULL, METRIC_COUNTER, &metrics.blocks_written},
+    {"opencbp_ingest_write_errors_total", "Blocks lost to write errors", NULL, METRIC_COUNTER, &metrics.write_errors},
+    {"opencbp_ingest_protocol_errors_total", "Connections closed for malformed frames", NULL, METRIC_COUNTER,
+     &metrics.protocol_errors},
+    {"opencbp_ingest_stalls_total", "Times ingestion waited for the writer", NULL, METRIC_COUNTER, &metrics.stalls},
+    {"opencbp_ingest_connections", "Open gateway connections", NULL, METRIC_GAUGE, &metrics.connections},
+};
+static char metricsBuffer[INGEST_METRICS_BUFFER_SIZE];
+
+static const char *dataDir = TELEMETRY_DEFAULT_DIR;
+static SpscQueue fullBlocks;        // Front end -> writer
+static SpscQueue freeBlocks;        // Writer -> front end
+static _Atomic bool writerStopping = false;
+static TelemetryBlock *openBlocks[INGEST_OPEN_PARTITIONS];
+static int openConnections = 0;
+
+// epoll tags for the descriptors that are not connections
+static int listenerTag, timerTag, signalTag, metricsTag;
+
+static void _sleepUs(long us) {
+    struct timespec duration = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&duration, NULL);
+}
+
+// Create every missing directory above path
+static void _makeParents(const char *path) {
+    char prefix[512];
+    for (const char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        size_t length = (size_t)(slash - path);
+        if (length >= sizeof(prefix)) {
+            return;
+        }
+        memcpy(prefix, path, length);
+        prefix[length] = '\0';
+        mkdir(prefix, 0755);
+    }
+}
+
+// Writer: append queued blocks to their partition files and hand them back
+static void *_writer(void *context) {
+    uint32_t partitions[INGEST_OPEN_FILES];
+    int files[INGEST_OPEN_FILES];
+    for (int i = 0; i < INGEST_OPEN_FILES; i++) {
+        files[i] = -1;
+    }
+
+    TelemetryBlock *block;
+    for (;;) {
+        if (!spsc_queue_pop(&fullBlocks, &block)) {
+            if (atomic_load(&writerStopping) && spsc_queue_size(&fullBlocks) == 0) {
+                break;
+            }
+            _sleepUs(1000);
+            continue;
+        }
+
+        // Reuse the partition's file, or replace the oldest partition's
+        uint32_t partition = block->header.partition;
+        int slot = 0;
+        for (int i = 0; i < INGEST_OPEN_FILES; i++) {
+            if (files[i] >= 0 && partitions[i] == partition) {
+                slot = i;
+                break;
+            }
+            if (files[i] < 0 || (files[slot] >= 0 && partitions[i] < partitions[slot])) {
+                slot = i;
+            }
+        }
+        if (files[slot] < 0 || partitions[slot] != partition) {
+            if (files[slot] >= 0) {
+                close(files[slot]);
+            }
+            char path[512];
+            files[slot] = -1;
+            if (telemetry_partition_path(path, sizeof(path), dataDir, partition) == 0) {
+                _makeParents(path);
+                files[slot] = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            }
+            partitions[slot] = partition;
+        }
+
+        if (files[slot] < 0 || telemetry_block_write(files[slot], block) != 0) {
+            if (atomic_load_explicit(&metrics.write_errors.value, memory_order_relaxed) == 0) {
+                fprintf(stderr, "Unable to write telemetry partition %u: %s\n", partition, strerror(errno));
+            }
+            metric_counter_add(&metrics.write_errors, 1);
+        } else {
+            metric_counter_add(&metrics.rows_written, block->header.rows);
+            metric_counter_add(&metrics.blocks_written, 1);
+        }
+        spsc_queue_push(&freeBlocks, &block);
+    }
+
+    for (int i = 0; i < INGEST_OPEN_FILES; i++) {
+        if (files[i] >= 0) {
+            close(files[i]);
+        }
+    }
+    return NULL;
+}
+
+// Hand an open block to the writer
+static void _flushBlock(int slot) {
+    if (openBlocks[slot] != NULL) {
+        spsc_queue_push(&fullBlocks, &openBlocks[slot]);
+        openBlocks[slot] = NULL;
+    }
+}
+
+static void _flushAll(void) {
+    for (int i = 0; i < INGEST_OPEN_PARTITIONS; i++) {
+        _flushBlock(i);
+    }
+}
+
+// Batch one report into its hour's block
+static void _ingest(uint32_t gateway, const TelemetryReport *report) {
+    uint32_t partition = telemetry_partition(report->time);
+    int slot = -1;
+    int oldest = 0;
+    for (int i = 0; i < INGEST_OPEN_PARTITIONS; i++) {
+        if (openBlocks[i] != NULL && openBlocks[i]->header.partition == partition) {
+            slot = i;
+            break;
+        }
+        if (openBlocks[i] == NULL ||
+            (openBlocks[oldest] != NULL && openBlocks[i]->header.partition < openBlocks[oldest]->header.partition)) {
+            oldest = i;
+        }
+    }
+
+    if (slot < 0) {
+        slot = oldest;
+        _flushBlock(slot);
+        TelemetryBlock *block;
+        if (!spsc_queue_pop(&freeBlocks, &block)) {
+            metric_counter_add(&metrics.stalls, 1);
+            while (!spsc_queue_pop(&freeBlocks, &block)) {
+                _sleepUs(INGEST_WAIT_US);
+            }
+        }
+        telemetry_block_reset(block, partition);
+        openBlocks[slot] = block;
+    }
+
+    if (telemetry_block_append(openBlocks[slot], gateway, report)) {
+        _flushBlock(slot);
+    }
+}
+
+static void _closeConnection(int epollFd, Connection *connection) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    free(connection);
+    metric_gauge_set(&metrics.connections, --openConnections);
+}
+
+// Handle every complete frame in the buffer; returns -1 on a protocol error
+static int _parseFrames(Connection *connection) {
+    size_t offset = 0;
+    while (connection->used - offset >= sizeof(TelemetryFrameHeader)) {
+        TelemetryFrameHeader header;
+        memcpy(&header, connection->buffer + offset, sizeof(header));
+        if (header.magic != TELEMETRY_FRAME_MAGIC || header.version != TELEMETRY_FRAME_VERSION ||
+            header.length > TELEMETRY_MAX_FRAME) {
+            return -1;
+        }
+        if (connection->used - offset < sizeof(header) + header.length) {
+            break;
+        }
+
+        const unsigned char *payload = connection->buffer + offset + sizeof(header);
+        if (header.type == TELEMETRY_HELLO && header.length == sizeof(uint32_t)) {
+            memcpy(&connection->gateway, payload, sizeof(uint32_t));
+            connection->identified = true;
+        } else if (header.type == TELEMETRY_REPORTS && connection->identified &&
+                   header.length % sizeof(TelemetryReport) == 0) {
+            uint32_t count = header.length / (uint32_t)sizeof(TelemetryReport);
+            for (uint32_t i = 0; i < count; i++) {
+                TelemetryReport report;
+                memcpy(&report, payload + i * sizeof(TelemetryReport), sizeof(report));
+                _ingest(connection->gateway, &report);
+            }
+            metric_counter_add(&metrics.reports, count);
+        } else {
+            return -1;
+        }
+        offset += sizeof(header) + header.length;
+    }
+
+    memmove(connection->buffer, connection->buffer + offset, connection->used - offset);
+    connection->used -= offset;
+    return 0;
+}
+
+// One read per wakeup, so a busy gateway cannot starve the others
+static void _onConnectionData(int epollFd, Connection *connection) {
+    ssize_t received = recv(connection->fd, connection->buffer + connection->used,
+                            sizeof(connection->buffer) - connection->used, 0);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (received <= 0) {
+        _closeConnection(epollFd, connection);
+        return;
+    }
+    connection->used += (size_t)received;
+    if (_parseFrames(connection) != 0) {
+        metric_counter_add(&metrics.protocol_errors, 1);
+        _closeConnection(epollFd, connection);
+    }
+}
+
+static void _onAccept(int epollFd, int listener) {
+    int client;
+    while ((client = accept(listener, NULL, NULL)) >= 0) {
+        Connection *connection = (Connection*)malloc(sizeof(Connection));
+        if (connection == NULL || fcntl(client, F_SETFL, O_NONBLOCK) != 0) {
+            free(connection);
+            close(client);
+            continue;
+        }
+        connection->fd = client;
+        connection->gateway = 0;
+        connection->identified = false;
+        connection->used = 0;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &event) != 0) {
+            close(client);
+            free(connection);
+            continue;
+        }
+        metric_gauge_set(&metrics.connections, ++openConnections);
+    }
+}
+
+static void _onMetricsClient(int listener) {
+    int client;
+    while ((client = accept(listener, NULL, NULL)) >= 0) {
+        struct timeval timeout = {0, INGEST_SCRAPE_TIMEOUT_MS * 1000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        metrics_serve(client, metricsBuffer, sizeof(metricsBuffer), metricTable,
+                      (int)(sizeof(metricTable) / sizeof(metricTable[0])));
+        close(client);
+    }
+}
+
+// Listen for gateways; returns the non-blocking socket or -1
+static int _listen(uint16_t port) {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, INGEST_BACKLOG) != 0) {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+static int _watch(int epollFd, int fd, void *tag) {
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = tag};
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int main(int argc, char **argv) {
+    uint16_t port = TELEMETRY_PORT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) {
+            port = (uint16_t)atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--dir") == 0) {
+            dataDir = argv[i + 1];
+        }
+    }
+
+    // Every block starts on the free queue
+    if (spsc_queue_init(&fullBlocks, INGEST_MAX_BLOCKS, sizeof(TelemetryBlock*)) != 0 ||
+        spsc_queue_init(&freeBlocks, INGEST_MAX_BLOCKS, sizeof(TelemetryBlock*)) != 0) {
+        fprintf(stderr, "Unable to allocate block queues\n");
+        return 1;
+    }
+    for (int i = 0; i < INGEST_MAX_BLOCKS; i++) {
+        TelemetryBlock *block = (TelemetryBlock*)malloc(sizeof(TelemetryBlock));
+        if (block == NULL || !spsc_queue_push(&freeBlocks, &block)) {
+            fprintf(stderr, "Unable to allocate telemetry blocks\n");
+            return 1;
+        }
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    int listener = _listen(port);
+    if (epollFd < 0 || listener < 0 || _watch(epollFd, listener, &listenerTag) != 0) {
+        fprintf(stderr, "Unable to listen for telemetry on port %d\n", port);
+        return 1;
+    }
+
+    // Open blocks go to disk at least once a second, however slowly they fill
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct itimerspec flush = {{INGEST_FLUSH_MS / 1000, (INGEST_FLUSH_MS % 1000) * 1000000},
+                               {INGEST_FLUSH_MS / 1000, (INGEST_FLUSH_MS % 1000) * 1000000}};
+    if (timerFd < 0 || timerfd_settime(timerFd, 0, &flush, NULL) != 0 || _watch(epollFd, timerFd, &timerTag) != 0) {
+        fprintf(stderr, "Unable to schedule block flushes\n");
+        return 1;
+    }
+
+    int metricsSocket = metrics_listen(INGEST_METRICS_PORT);
+    if (metricsSocket < 0 || fcntl(metricsSocket, F_SETFL, O_NONBLOCK) != 0 ||
+        _watch(epollFd, metricsSocket, &metricsTag) != 0) {
+        fprintf(stderr, "Unable to serve metrics on port %d\n", INGEST_METRICS_PORT);
+    }
+
+    // Stop cleanly on SIGINT / SIGTERM, writing out every open block; a gateway hanging up is not an error
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd >= 0) {
+        _watch(epollFd, signalFd, &signalTag);
+    }
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, _writer, NULL);
+    printf("Ingesting telemetry on port %d into %s\n", port, dataDir);
+    fflush(stdout);
+
+    bool running = true;
+    struct epoll_event events[INGEST_MAX_EVENTS];
+    while (running) {
+        int ready = epoll_wait(epollFd, events, INGEST_MAX_EVENTS, -1);
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &listenerTag) {
+                _onAccept(epollFd, listener);
+            } else if (tag == &timerTag) {
+                uint64_t expirations;
+                if (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+                    _flushAll();
+                }
+            } else if (tag == &metricsTag) {
+                _onMetricsClient(metricsSocket);
+            } else if (tag == &signalTag) {
+                running = false;
+            } else {
+                _onConnectionData(epollFd, (Connection*)tag);
+            }
+        }
+    }
+
+    _flushAll();
+    atomic_store(&writerStopping, true);
+    pthread_join(writer, NULL);
+    printf("Ingested %llu reports, wrote %llu in %llu blocks (%llu write errors)\n",
+           (unsigned long long)atomic_load(&metrics.reports.value),
+           (unsigned long long)atomic_load(&metrics.rows_written.value),
+           (unsigned long long)atomic_load(&metrics.blocks_written.value),
+           (unsigned long long)atomic_load(&metrics.write_errors.value));
+
+    close(listener);
+    close(timerFd);
+    close(epollFd);
+    if (metricsSocket >= 0) {
+        close(metricsSocket);
+    }
+    if (signalFd >= 0) {
+        close(signalFd);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "trace.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char *categoryNames[NUM_TRACE_CATEGORIES] = {"task", "modbus", "http", "bid", "scheduler"};
+
+static uint64_t _monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+uint64_t trace_cycles(void) {
+#if defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#elif defined(__ARM_ARCH) && __ARM_ARCH >= 8 && defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'A'
+    uint64_t value;
+    __asm__ volatile("mrrc p15, 1, %Q0, %R0, c14" : "=r"(value));
+    return value;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return _monotonic_ns();
+#endif
+}
+
+void trace_clock_init(TraceClock *clock) {
+    clock->start_cycles = trace_cycles();
+    clock->start_us = _monotonic_ns() / 1000;
+}
+
+void trace_ring_init(TraceRing *ring, const char *name) {
+    ring->name = name;
+    atomic_init(&ring->head, 0);
+    for (int i = 0; i < TRACE_RING_EVENTS; i++) {
+        atomic_init(&ring->slots[i].sequence, 0);
+    }
+}
+
+// Record an event (the ring's single writer)
+void trace_event(TraceRing *ring, TraceCategory category, uint8_t phase, const char *name, int32_t value) {
+    if (ring == NULL) {
+        return;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceSlot *slot = &ring->slots[head & (TRACE_RING_EVENTS - 1)];
+
+    // Mark the slot as being written before touching the event; on weakly ordered CPUs (ARM) the fence keeps the
+    // event stores from becoming visible ahead of the odd sequence
+    atomic_store_explicit(&slot->sequence, 2 * head + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->event.cycles = trace_cycles();
+    slot->event.name = name;
+    slot->event.value = value;
+    slot->event.phase = phase;
+    slot->event.category = (uint8_t)category;
+    atomic_store_explicit(&slot->sequence, 2 * head + 2, memory_order_release);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_begin(TraceRing *ring, TraceCategory category, const char *name, int32_t value) {
+    trace_event(ring, category, 'B', name, value);
+}
+
+void trace_end(TraceRing *ring, TraceCategory category, const char *name, int32_t value) {
+    trace_event(ring, category, 'E', name, value);
+}
+
+void trace_async_begin(TraceRing *ring, TraceCategory category, const char *name, int32_t id) {
+    trace_event(ring, category, 'b', name, id);
+}
+
+void trace_async_end(TraceRing *ring, TraceCategory category, const char *name, int32_t id) {
+    trace_event(ring, category, 'e', name, id);
+}
+
+// Write Chrome trace-event JSON
+int64_t trace_export_chrome(FILE *file, TraceRing *rings, int num_rings, const TraceClock *clock) {
+    // Calibrate the counter against the monotonic clock over the whole recording
+    uint64_t now_cycles = trace_cycles();
+    uint64_t now_us = _monotonic_ns() / 1000;
+    double cycles_per_us = (now_us > clock->start_us) ?
+                           (double)(now_cycles - clock->start_cycles) / (double)(now_us - clock->start_us) : 1.0;
+    if (cycles_per_us <= 0.0) {
+        cycles_per_us = 1.0;
+    }
+
+    int64_t written = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int r = 0; r < num_rings; r++) {
+        TraceRing *ring = &rings[r];
+        fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                r, ring->name);
+
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t first = (head > TRACE_RING_EVENTS) ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = first; i < head; i++) {
+            // Copy the event only if its slot still holds event i, complete, before and after the copy; otherwise
+            // the writer was in the slot or lapped it meanwhile
+            TraceSlot *slot = &ring->slots[i & (TRACE_RING_EVENTS - 1)];
+            uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            if (sequence != 2 * i + 2) {
+                continue;
+            }
+            TraceEvent event = slot->event;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) {
+                continue;
+            }
+
+            double ts = (double)(event.cycles - clock->start_cycles) / cycles_per_us;
+            const char *category = (event.category < NUM_TRACE_CATEGORIES) ? categoryNames[event.category] : "other";
+            fprintf(file, ",\n{\"ph\":\"%c\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                    event.phase, event.name, category, r, ts);
+            if (event.phase == 'b' || event.phase == 'e') {
+                fprintf(file, ",\"id\":%d", (int)event.value);
+            } else if (event.phase == 'i') {
+                fprintf(file, ",\"s\":\"t\",\"args\":{\"value\":%d}", (int)event.value);
+            } else {
+                fprintf(file, ",\"args\":{\"value\":%d}", (int)event.value);
+            }
+            fprintf(file, "}");
+            written++;
+        }
+        fprintf(file, "%s", (r + 1 < num_rings) ? ",\n" : "");
+    }
+    fprintf(file, "\n]}\n");
+    return written;
+}
@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#define TRACE_RING_EVENTS 1024          // Events kept per timeline (a power of two)
+
+// What an event measures; scheduler events go on per-core timelines so they never break the nesting of the others
+typedef enum {
+    TRACE_TASK,                     // One job of a task
+    TRACE_MODBUS,                   // One Modbus transaction
+    TRACE_HTTP,                     // One curl request, as an async span that may outlive the job starting it
+    TRACE_BID,                      // One bid computation
+    TRACE_SCHEDULER,                // A task on a core, between its switch in and switch out
+    NUM_TRACE_CATEGORIES
+} TraceCategory;
+
+typedef struct {
+    uint64_t cycles;                // trace_cycles() when recorded
+    const char *name;               // Static string
+    int32_t value;                  // Argument: register address, result, request id...
+    uint8_t phase;                  // Chrome phase: 'B'/'E' span, 'b'/'e' async span, 'i' instant
+    uint8_t category;               // TraceCategory
+} TraceEvent;
+
+// One slot of a ring; the sequence says which event it holds, so a reader can tell a torn or lapped copy
+typedef struct {
+    _Atomic uint64_t sequence;      // 2 * (index + 1) once event index is complete, odd while it is being written
+    TraceEvent event;
+} TraceSlot;
+
+// Flight recorder for one timeline (a task, or a core's scheduler)
+// One writer at a time appends without locks or allocation, overwriting the oldest events; an exporter may read
+// concurrently and drops any event whose slot was being written or was overwritten while it was copying.
+typedef struct {
+    const char *name;               // Thread name in the viewer
+    _Atomic uint64_t head;          // Events ever written
+    TraceSlot slots[TRACE_RING_EVENTS];
+} TraceRing;
+
+// Pairs the cycle counter with CLOCK_MONOTONIC so exported timestamps are in microseconds
+typedef struct {
+    uint64_t start_cycles;
+    uint64_t start_us;
+} TraceClock;
+
+// Read the cheapest monotonic counter available: the generic timer on ARMv8 (AArch64 or AArch32), the TSC on x86,
+// or CLOCK_MONOTONIC in nanoseconds elsewhere (the generic timer is optional on ARMv7-A, and the ARM11 cycle counter
+// of the original Pi Zero is 32 bits and wraps every few seconds)
+uint64_t trace_cycles(void);
+
+// Start the timestamp base
+void trace_clock_init(TraceClock *clock);
+
+// Reset a timeline
+void trace_ring_init(TraceRing *ring, const char *name);
+
+// Record an event; a NULL ring records nothing, so code shared with untraced contexts needs no checks
+void trace_event(TraceRing *ring, TraceCategory category, uint8_t phase, const char *name, int32_t value);
+
+// Open and close a span; spans on one timeline must nest
+void trace_begin(TraceRing *ring, TraceCategory category, const char *name, int32_t value);
+void trace_end(TraceRing *ring, TraceCategory category, const char *name, int32_t value);
+
+// Open and close an async span matched by id, e.g. a transfer completing after its job returned
+void trace_async_begin(TraceRing *ring, TraceCategory category, const char *name, int32_t id);
+void trace_async_end(TraceRing *ring, TraceCategory category, const char *name, int32_t id);
+
+// Write the rings as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev), one process with a lane per ring;
+// returns the number of events written
+int64_t trace_export_chrome(FILE *file, TraceRing *rings, int num_rings, const TraceClock *clock);
+
+#endif // TRACE_H